@@ -63,12 +63,14 @@ LOCAL_SRC_FILES := \
         compositor/nativesurface.cpp \
         compositor/renderstate.cpp \
         core/gpudevice.cpp \
+        core/bufferimportcache.cpp \
         core/hwclayer.cpp \
 	core/resourcemanager.cpp \
 	core/framebuffermanager.cpp \
 	core/logicaldisplay.cpp \
 	core/logicaldisplaymanager.cpp \
 	core/mosaicdisplay.cpp \
+        core/presentsequencer.cpp \
         core/overlaylayer.cpp \
         display/displayplanemanager.cpp \
 	display/displayplanestate.cpp \
@@ -77,8 +79,13 @@ LOCAL_SRC_FILES := \
         display/virtualdisplay.cpp \
         utils/fdhandler.cpp \
         utils/hwcevent.cpp \
+        utils/hwcfence.cpp \
+        utils/hwcframepacer.cpp \
         utils/hwcthread.cpp \
+        utils/hwcthreadscheduler.cpp \
+        utils/hwcreactor.cpp \
         utils/hwcutils.cpp \
+        utils/hwcworkerpool.cpp \
         utils/disjoint_layers.cpp
 
 ifeq ($(strip $(ENABLE_HYPER_DMABUF_SHARING)), true)
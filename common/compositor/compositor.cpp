@@ -65,9 +65,15 @@ bool Compositor::Draw(DisplayPlaneStateList &comp_planes,
   std::vector<DrawState> draw_state;
   std::vector<DrawState> media_state;
   std::vector<OverlayBuffer *> draw_buffers;
+  OverlayBuffer *nullbuffer = NULL;
 
   for (auto &layer : layers) {
-    draw_buffers.emplace_back(layer.GetBuffer());
+    // Solid color layers are drawn from their color, not from the buffer
+    // used to scan them out.
+    if (layer.IsSolidColor()) {
+      draw_buffers.emplace_back(nullbuffer);
+    } else
+      draw_buffers.emplace_back(layer.GetBuffer());
   }
 
   for (DisplayPlaneState &plane : comp_planes) {
@@ -180,7 +186,7 @@ bool Compositor::DrawOffscreen(std::vector<OverlayLayer> &layers,
   std::vector<OverlayBuffer *> draw_buffers;
   OverlayBuffer *nullbuffer = NULL;
   for (auto &layer : layers) {
-    if (layer.IsProtected()) {
+    if (layer.IsProtected() || layer.IsSolidColor()) {
       draw_buffers.emplace_back(nullbuffer);
     } else
       draw_buffers.emplace_back(layer.GetBuffer());
@@ -17,9 +17,11 @@
 #include "compositorthread.h"
 
 #include <nativebufferhandler.h>
+#include "bufferimportcache.h"
 #include "displayplanemanager.h"
 #include "framebuffermanager.h"
 #include "gpudevice.h"
+#include "hwcfence.h"
 #include "hwctrace.h"
 #include "hwcutils.h"
 #include "nativegpuresource.h"
@@ -43,6 +45,7 @@ CompositorThread::~CompositorThread() {
 void CompositorThread::Initialize(ResourceManager *resource_manager,
                                   uint32_t gpu_fd) {
   fb_manager_ = GpuDevice::getInstance().GetFrameBufferManager();
+  import_cache_ = GpuDevice::getInstance().GetBufferImportCache();
   tasks_lock_.lock();
   if (!gpu_resource_handler_)
     gpu_resource_handler_.reset(CreateNativeGpuResourceHandler());
@@ -161,9 +164,6 @@ void CompositorThread::HandleReleaseRequest() {
       gpu_resource_handler_->ReleaseGPUResources(purged_gl_resources);
     }
 
-    const NativeBufferHandler *handler =
-        resource_manager_->GetNativeBufferHandler();
-
     for (size_t i = 0; i < purged_size; i++) {
       const ResourceHandle &handle = purged_gl_resources.at(i);
       if (!handle.handle_) {
@@ -173,8 +173,7 @@ void CompositorThread::HandleReleaseRequest() {
       fb_manager_->RemoveFB(handle.handle_->meta_data_.num_planes_,
                             handle.handle_->meta_data_.gem_handles_);
 
-      handler->ReleaseBuffer(handle.handle_);
-      handler->DestroyHandle(handle.handle_);
+      import_cache_->ReleaseImport(handle.handle_);
     }
   }
 
@@ -184,9 +183,6 @@ void CompositorThread::HandleReleaseRequest() {
     EnsureMediaRenderer();
     media_renderer_->DestroyMediaResources(purged_media_resources);
 
-    const NativeBufferHandler *handler =
-        resource_manager_->GetNativeBufferHandler();
-
     for (size_t i = 0; i < purged_size; i++) {
       const MediaResourceHandle &handle = purged_media_resources.at(i);
       if (!handle.handle_) {
@@ -195,8 +191,7 @@ void CompositorThread::HandleReleaseRequest() {
 
       fb_manager_->RemoveFB(handle.handle_->meta_data_.num_planes_,
                             handle.handle_->meta_data_.gem_handles_);
-      handler->ReleaseBuffer(handle.handle_);
-      handler->DestroyHandle(handle.handle_);
+      import_cache_->ReleaseImport(handle.handle_);
     }
   }
 }
@@ -236,12 +231,12 @@ void CompositorThread::Handle3DDrawRequest() {
       }
     }
 
-    const std::vector<int32_t> &fences = draw_state.acquire_fences_;
-    for (int32_t fence : fences) {
-      gl_renderer_->InsertFence(fence);
-    }
-
-    std::vector<int32_t>().swap(draw_state.acquire_fences_);
+    // Wait for all acquire fences of this surface with a single server
+    // side wait. The renderer takes ownership of the merged fence.
+    HWCFence acquire_fence =
+        HWCFence::Merge("iahwc_acquire_fence", draw_state.acquire_fences_);
+    if (acquire_fence.IsValid())
+      gl_renderer_->InsertFence(acquire_fence.Release());
 
     if (!gl_renderer_->Draw(draw_state.states_, draw_state.surface_)) {
       ETRACE(
@@ -37,6 +37,7 @@ class DisplayPlaneManager;
 class ResourceManager;
 class NativeBufferHandler;
 class FrameBufferManager;
+class BufferImportCache;
 
 class CompositorThread : public HWCThread {
  public:
@@ -87,6 +88,7 @@ class CompositorThread : public HWCThread {
   FDHandler fd_chandler_;
   HWCEvent cevent_;
   FrameBufferManager* fb_manager_ = NULL;
+  BufferImportCache* import_cache_ = NULL;
 };
 
 }  // namespace hwcomposer
@@ -88,7 +88,8 @@ bool NativeSurface::Init(ResourceManager *resource_manager, uint32_t format,
     }
   }
 
-  modifier_ = modifier;
+  // Track the modifier actually used by the framebuffer.
+  modifier_ = *modifier_succeeded ? modifier : 0;
   native_handle_ = native_handle;
 
   return true;
@@ -18,9 +18,12 @@
 #include "platformdefines.h"
 
 #include <drm_fourcc.h>
+#include <inttypes.h>
 #include <math.h>
 #include <xf86drm.h>
 
+#include <chrono>
+
 #include "hwctrace.h"
 #include "hwcutils.h"
 #include "nativesurface.h"
@@ -30,7 +33,7 @@
 namespace hwcomposer {
 
 VARenderer::~VARenderer() {
-  DestroyContext();
+  DestroyContexts();
 
   if (va_display_) {
     vaTerminate(va_display_);
@@ -232,6 +235,8 @@ unsigned int VARenderer::GetVAProcFilterScalingMode(uint32_t mode) {
 
 bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
   CTRACE();
+  std::chrono::steady_clock::time_point setup_start =
+      std::chrono::steady_clock::now();
   // TODO: Clear surface ?
   surface->SetClearSurface(NativeSurface::kNone);
   OverlayBuffer* buffer_out = surface->GetLayer()->GetBuffer();
@@ -240,14 +245,14 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
     return false;
   }
   int rt_format = DrmFormatToRTFormat(buffer_out->GetFormat());
-  if (va_context_ == VA_INVALID_ID || render_target_format_ != rt_format) {
-    render_target_format_ = rt_format;
-    if (!CreateContext()) {
-      ETRACE("Create VA context failed\n");
-      return false;
-    }
+  VAContextState* context = GetContext(rt_format);
+  if (!context) {
+    ETRACE("Create VA context failed\n");
+    return false;
   }
 
+  VAContextID va_context = context->context_;
+
   // Get Output Surface.
   OverlayLayer* layer_out = surface->GetLayer();
   HwcRect<int> layer_out_disp_frame = layer_out->GetDisplayFrame();
@@ -275,18 +280,31 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
 
   layer_out->SetProtected(false);
 
-  VAStatus ret = VA_STATUS_SUCCESS;
-  ret = vaBeginPicture(va_display_, va_context_, surface_out);
+  for (auto itr = state.colors_.begin(); itr != state.colors_.end(); itr++) {
+    SetVAProcFilterColorValue(itr->first, itr->second);
+  }
 
   OverlayLayer* layer_in = NULL;
   uint32_t total_layers = state.layers_.size();
-  std::vector<ScopedVABufferID> pipeline_buffers(total_layers, va_display_);
+  std::vector<std::unique_ptr<VAPipelineSlot>>& pipeline_buffers =
+      context->pipeline_buffers_;
+  while (pipeline_buffers.size() < total_layers) {
+    pipeline_buffers.emplace_back(new VAPipelineSlot(va_display_));
+  }
+
+  // Each layer is rendered as soon as its parameters are set up, as
+  // UpdateCaps() may re-create the filter buffers used by earlier layers.
+  std::chrono::steady_clock::time_point processing_start =
+      std::chrono::steady_clock::now();
+  VAStatus ret = vaBeginPicture(va_display_, va_context, surface_out);
+  std::chrono::steady_clock::duration processing_time =
+      std::chrono::steady_clock::now() - processing_start;
 
   for (uint32_t i = 0; i < total_layers; i++) {
     layer_in = state.layers_.at(i);
     if (layer_in->IsSolidColor())
       continue;
-    ScopedVABufferID& pipeline_buffer = pipeline_buffers.at(i);
+    VAPipelineSlot* slot = pipeline_buffers.at(i).get();
     // Get Input Surface.
     OverlayBuffer* buffer_in = layer_in->GetBuffer();
     if (!buffer_in) {
@@ -308,14 +326,14 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
       layer_out->SetProtected(true);
     }
 
-    VARectangle surface_region;
+    VARectangle& surface_region = slot->surface_region_;
     const HwcRect<float>& source_crop = layer_in->GetSourceCrop();
     surface_region.x = static_cast<int>(source_crop.left);
     surface_region.y = static_cast<int>(source_crop.top);
     surface_region.width = layer_in->GetSourceCropWidth();
     surface_region.height = layer_in->GetSourceCropHeight();
 
-    VARectangle output_region;
+    VARectangle& output_region = slot->output_region_;
     HwcRect<int> display_frame = layer_in->GetDisplayFrame();
     display_frame = TranslateRect(display_frame, -xtranslation, -ytranslation);
     output_region.x = display_frame.left;
@@ -343,7 +361,8 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
 #endif
 
 #ifdef VA_WITH_VPP
-    VABlendState bs = {};
+    VABlendState& bs = slot->blend_state_;
+    bs = {};
     bs.flags = VA_BLEND_PREMULTIPLIED_ALPHA;
     pipe_param.blend_state = &bs;
 #endif
@@ -353,21 +372,19 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
     DUMPTRACE("Layer DisplayFrame:(%d,%d,%d,%d)\n", output_region.x,
               output_region.y, output_region.width, output_region.height);
 
-    for (auto itr = state.colors_.begin(); itr != state.colors_.end(); itr++) {
-      SetVAProcFilterColorValue(itr->first, itr->second);
-    }
     SetVAProcFilterDeinterlaceMode(state.deinterlace_, buffer_in);
 
-    if (!UpdateCaps()) {
+    if (!UpdateCaps(context)) {
       ETRACE("Failed to update capabailities. \n");
       return false;
     }
 
     pipe_param.filter_flags = GetVAProcFilterScalingMode(state.scaling_mode_);
-    if (filters_.size()) {
-      pipe_param.filters = filters_.data();
+    if (context->filters_.size()) {
+      pipe_param.filters = context->filters_.data();
     }
-    pipe_param.num_filters = static_cast<unsigned int>(filters_.size());
+    pipe_param.num_filters =
+        static_cast<unsigned int>(context->filters_.size());
 
 #if VA_MAJOR_VERSION >= 1
     // currently rotation is only supported by VA on Android.
@@ -377,17 +394,51 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
     pipe_param.mirror_state = mirror;
 #endif
 
-    if (!pipeline_buffer.CreateBuffer(
-            va_context_, VAProcPipelineParameterBufferType,
-            sizeof(VAProcPipelineParameterBuffer), 1, &pipe_param)) {
-      return false;
+    // Re-use the parameter buffer of the previous frame if we have one,
+    // else allocate it for this slot.
+    ScopedVABufferID& pipeline_buffer = slot->buffer_;
+    if (!pipeline_buffer.UpdateBuffer(&pipe_param,
+                                      sizeof(VAProcPipelineParameterBuffer))) {
+      if (pipeline_buffer.buffer() != VA_INVALID_ID) {
+        vaDestroyBuffer(va_display_, pipeline_buffer.buffer());
+        pipeline_buffer.buffer() = VA_INVALID_ID;
+      }
+
+      if (!pipeline_buffer.CreateBuffer(
+              va_context, VAProcPipelineParameterBufferType,
+              sizeof(VAProcPipelineParameterBuffer), 1, &pipe_param)) {
+        return false;
+      }
     }
 
-    ret |=
-        vaRenderPicture(va_display_, va_context_, &pipeline_buffer.buffer(), 1);
+    processing_start = std::chrono::steady_clock::now();
+    ret |= vaRenderPicture(va_display_, va_context, &pipeline_buffer.buffer(),
+                           1);
+    processing_time += std::chrono::steady_clock::now() - processing_start;
   }
 
-  ret |= vaEndPicture(va_display_, va_context_);
+  processing_start = std::chrono::steady_clock::now();
+  ret |= vaEndPicture(va_display_, va_context);
+
+  std::chrono::steady_clock::time_point processing_end =
+      std::chrono::steady_clock::now();
+  processing_time += processing_end - processing_start;
+  int64_t processing_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(processing_time)
+          .count();
+  int64_t setup_time = std::chrono::duration_cast<std::chrono::microseconds>(
+                           processing_end - setup_start)
+                           .count() -
+                       processing_us;
+  stats_.setup_time_us_ += setup_time;
+  stats_.processing_time_us_ += processing_us;
+  stats_.frames_++;
+  ICOMPOSITORTRACE(
+      "VA frame %" PRIu64 ": setup %" PRId64 " us processing %" PRId64
+      " us (avg %" PRId64 " / %" PRId64 " us) \n",
+      stats_.frames_, setup_time, processing_us,
+      stats_.setup_time_us_ / static_cast<int64_t>(stats_.frames_),
+      stats_.processing_time_us_ / static_cast<int64_t>(stats_.frames_));
 
   surface->ResetDamage();
   return ret == VA_STATUS_SUCCESS ? true : false;
@@ -406,22 +457,22 @@ bool VARenderer::DestroyMediaResources(
   return true;
 }
 
-bool VARenderer::LoadCaps() {
+bool VARenderer::LoadCaps(VAContextID context) {
   VAProcFilterCapColorBalance colorbalancecaps[VAProcColorBalanceCount];
   uint32_t colorbalance_num = VAProcColorBalanceCount;
   uint32_t sharp_num = 1;
   uint32_t deinterlace_num = VAProcDeinterlacingCount;
   memset(colorbalancecaps, 0,
          sizeof(VAProcFilterCapColorBalance) * VAProcColorBalanceCount);
-  if (!QueryVAProcFilterCaps(va_context_, VAProcFilterColorBalance,
+  if (!QueryVAProcFilterCaps(context, VAProcFilterColorBalance,
                              colorbalancecaps, &colorbalance_num)) {
     return false;
   }
-  if (!QueryVAProcFilterCaps(va_context_, VAProcFilterSharpening,
+  if (!QueryVAProcFilterCaps(context, VAProcFilterSharpening,
                              &sharp_caps_.caps_, &sharp_num)) {
     return false;
   }
-  if (!QueryVAProcFilterCaps(va_context_, VAProcFilterDeinterlacing,
+  if (!QueryVAProcFilterCaps(context, VAProcFilterDeinterlacing,
                              &deinterlace_caps_.caps_, &deinterlace_num)) {
     return false;
   }
@@ -432,72 +483,94 @@ bool VARenderer::LoadCaps() {
   return true;
 }
 
-bool VARenderer::CreateContext() {
-  DestroyContext();
+VAContextState* VARenderer::GetContext(int rt_format) {
+  auto itr = contexts_.find(rt_format);
+  if (itr != contexts_.end())
+    return &(itr->second);
 
+  VAContextState& context = contexts_[rt_format];
   VAConfigAttrib config_attrib;
   config_attrib.type = VAConfigAttribRTFormat;
-  config_attrib.value = render_target_format_;
+  config_attrib.value = rt_format;
   VAStatus ret =
       vaCreateConfig(va_display_, VAProfileNone, VAEntrypointVideoProc,
-                     &config_attrib, 1, &va_config_);
+                     &config_attrib, 1, &context.config_);
   if (ret != VA_STATUS_SUCCESS) {
     ETRACE("Create VA Config failed\n");
-    return false;
+    contexts_.erase(rt_format);
+    return NULL;
   }
 
+  if (!CreateContext(&context)) {
+    DestroyContext(&context);
+    contexts_.erase(rt_format);
+    return NULL;
+  }
+
+  return &context;
+}
+
+bool VARenderer::CreateContext(VAContextState* context) {
   // These parameters are not used in vaCreateContext so just set them to dummy
   // values
   int width = 1;
   int height = 1;
-  ret = vaCreateContext(va_display_, va_config_, width, height, 0x00, nullptr,
-                        0, &va_context_);
+  VAStatus ret = vaCreateContext(va_display_, context->config_, width, height,
+                                 0x00, nullptr, 0, &context->context_);
+  if (ret != VA_STATUS_SUCCESS)
+    return false;
 
-  update_caps_ = true;
-  if (ret == VA_STATUS_SUCCESS) {
-    if (!LoadCaps() || !UpdateCaps())
+  // Filter capabilities don't depend on the render target format, query
+  // them only for the first context.
+  if (!caps_loaded_) {
+    if (!LoadCaps(context->context_))
       return false;
+
+    caps_loaded_ = true;
   }
-  return ret == VA_STATUS_SUCCESS ? true : false;
+
+  // Ensure filter buffers are created for this context.
+  context->caps_generation_ = 0;
+  return UpdateCaps(context);
 }
 
-void VARenderer::DestroyContext() {
-  if (va_context_ != VA_INVALID_ID) {
-    vaDestroyContext(va_display_, va_context_);
-    va_context_ = VA_INVALID_ID;
+void VARenderer::DestroyContext(VAContextState* context) {
+  std::vector<std::unique_ptr<VAPipelineSlot>>().swap(
+      context->pipeline_buffers_);
+  std::vector<VABufferID>().swap(context->filters_);
+  context->cb_elements_.reset();
+  context->sharp_.reset();
+  context->deinterlace_.reset();
+
+  if (context->context_ != VA_INVALID_ID) {
+    vaDestroyContext(va_display_, context->context_);
+    context->context_ = VA_INVALID_ID;
   }
-  if (va_config_ != VA_INVALID_ID) {
-    vaDestroyConfig(va_display_, va_config_);
-    va_config_ = VA_INVALID_ID;
+  if (context->config_ != VA_INVALID_ID) {
+    vaDestroyConfig(va_display_, context->config_);
+    context->config_ = VA_INVALID_ID;
   }
-
-  std::vector<VABufferID>().swap(filters_);
-  std::vector<ScopedVABufferID>().swap(cb_elements_);
-  std::vector<ScopedVABufferID>().swap(sharp_);
 }
 
-bool VARenderer::UpdateCaps() {
-  if (!update_caps_) {
-    return true;
+void VARenderer::DestroyContexts() {
+  for (auto& context : contexts_) {
+    DestroyContext(&(context.second));
   }
 
-  update_caps_ = false;
+  contexts_.clear();
+}
 
-  std::vector<ScopedVABufferID> cb_elements(1, va_display_);
-  std::vector<ScopedVABufferID> sharp(1, va_display_);
-  std::vector<ScopedVABufferID> deinterlace(1, va_display_);
+bool VARenderer::UpdateCaps(VAContextState* context) {
+  if (update_caps_) {
+    update_caps_ = false;
+    caps_generation_++;
+  }
 
-  std::vector<VABufferID>().swap(filters_);
-  std::vector<ScopedVABufferID>().swap(cb_elements_);
-  std::vector<ScopedVABufferID>().swap(sharp_);
-  std::vector<ScopedVABufferID>().swap(deinterlace_);
+  if (context->caps_generation_ == caps_generation_) {
+    return true;
+  }
 
-  VAProcFilterParameterBufferColorBalance cbparam[VAProcColorBalanceCount];
-  VAProcFilterParameterBuffer sharpparam;
-  VAProcFilterParameterBufferDeinterlacing deinterlaceparam;
-  memset(cbparam, 0, VAProcColorBalanceCount *
-                         sizeof(VAProcFilterParameterBufferColorBalance));
-  int index = 0;
+  std::vector<VAProcFilterParameterBufferColorBalance> cbparam;
   for (auto itr = colorbalance_caps_.begin(); itr != colorbalance_caps_.end();
        itr++) {
     if (itr->second.use_default_) {
@@ -505,53 +578,93 @@ bool VARenderer::UpdateCaps() {
     }
     if (fabs(itr->second.value_ - itr->second.caps_.range.default_value) >=
         itr->second.caps_.range.step) {
-      cbparam[index].type = VAProcFilterColorBalance;
-      cbparam[index].value = itr->second.value_;
-      cbparam[index].attrib = itr->second.caps_.type;
-      index++;
+      VAProcFilterParameterBufferColorBalance param;
+      memset(&param, 0, sizeof(param));
+      param.type = VAProcFilterColorBalance;
+      param.value = itr->second.value_;
+      param.attrib = itr->second.caps_.type;
+      cbparam.emplace_back(param);
     }
   }
 
-  if (index) {
-    if (!cb_elements[0].CreateBuffer(
-            va_context_, VAProcFilterParameterBufferType,
-            sizeof(VAProcFilterParameterBufferColorBalance), index, cbparam)) {
+  // Only re-create filter buffers whose values have actually changed.
+  size_t cb_size =
+      cbparam.size() * sizeof(VAProcFilterParameterBufferColorBalance);
+  if (cbparam.empty()) {
+    context->cb_elements_.reset();
+  } else if (!context->cb_elements_ ||
+             context->cb_params_.size() != cbparam.size() ||
+             memcmp(context->cb_params_.data(), cbparam.data(), cb_size)) {
+    std::unique_ptr<ScopedVABufferID> cb_elements(
+        new ScopedVABufferID(va_display_));
+    if (!cb_elements->CreateBuffer(
+            context->context_, VAProcFilterParameterBufferType,
+            sizeof(VAProcFilterParameterBufferColorBalance), cbparam.size(),
+            cbparam.data())) {
       ETRACE("Create color fail\n");
       return false;
     }
-    filters_.push_back(cb_elements[0].buffer());
+    context->cb_elements_.swap(cb_elements);
   }
-  cb_elements_.swap(cb_elements);
+  context->cb_params_.swap(cbparam);
 
   if (sharp_caps_.use_default_) {
     sharp_caps_.value_ = sharp_caps_.caps_.range.default_value;
   }
   if (fabs(sharp_caps_.value_ - sharp_caps_.caps_.range.default_value) >=
       sharp_caps_.caps_.range.step) {
-    sharpparam.value = sharp_caps_.value_;
-    sharpparam.type = VAProcFilterSharpening;
-    if (!sharp[0].CreateBuffer(va_context_, VAProcFilterParameterBufferType,
+    if (!context->sharp_ || context->sharp_value_ != sharp_caps_.value_) {
+      VAProcFilterParameterBuffer sharpparam;
+      sharpparam.value = sharp_caps_.value_;
+      sharpparam.type = VAProcFilterSharpening;
+      std::unique_ptr<ScopedVABufferID> sharp(
+          new ScopedVABufferID(va_display_));
+      if (!sharp->CreateBuffer(context->context_,
+                               VAProcFilterParameterBufferType,
                                sizeof(VAProcFilterParameterBuffer), 1,
                                &sharpparam)) {
-      return false;
+        return false;
+      }
+      context->sharp_.swap(sharp);
+      context->sharp_value_ = sharp_caps_.value_;
     }
-    filters_.push_back(sharp[0].buffer());
+  } else {
+    context->sharp_.reset();
   }
-  sharp_.swap(sharp);
 
   if (deinterlace_caps_.mode_ != VAProcDeinterlacingNone) {
-    deinterlaceparam.algorithm = deinterlace_caps_.mode_;
-    deinterlaceparam.type = VAProcFilterDeinterlacing;
-    if (!deinterlace[0].CreateBuffer(
-            va_context_, VAProcFilterParameterBufferType,
-            sizeof(VAProcFilterParameterBufferDeinterlacing), 1,
-            &deinterlaceparam)) {
-      return false;
+    if (!context->deinterlace_ ||
+        context->deinterlace_mode_ != deinterlace_caps_.mode_) {
+      VAProcFilterParameterBufferDeinterlacing deinterlaceparam;
+      memset(&deinterlaceparam, 0, sizeof(deinterlaceparam));
+      deinterlaceparam.algorithm = deinterlace_caps_.mode_;
+      deinterlaceparam.type = VAProcFilterDeinterlacing;
+      std::unique_ptr<ScopedVABufferID> deinterlace(
+          new ScopedVABufferID(va_display_));
+      if (!deinterlace->CreateBuffer(
+              context->context_, VAProcFilterParameterBufferType,
+              sizeof(VAProcFilterParameterBufferDeinterlacing), 1,
+              &deinterlaceparam)) {
+        return false;
+      }
+      context->deinterlace_.swap(deinterlace);
+      context->deinterlace_mode_ = deinterlace_caps_.mode_;
     }
-    filters_.push_back(deinterlace[0].buffer());
+  } else {
+    context->deinterlace_.reset();
   }
-  deinterlace_.swap(deinterlace);
 
+  std::vector<VABufferID>().swap(context->filters_);
+  if (context->cb_elements_)
+    context->filters_.push_back(context->cb_elements_->buffer());
+
+  if (context->sharp_)
+    context->filters_.push_back(context->sharp_->buffer());
+
+  if (context->deinterlace_)
+    context->filters_.push_back(context->deinterlace_->buffer());
+
+  context->caps_generation_ = caps_generation_;
   return true;
 }
 
@@ -17,7 +17,10 @@
 #ifndef COMMON_COMPOSITOR_VA_VARENDERER_H_
 #define COMMON_COMPOSITOR_VA_VARENDERER_H_
 
+#include <string.h>
+
 #include <map>
+#include <memory>
 
 #include "hwcdefs.h"
 #include "overlaybuffer.h"
@@ -48,6 +51,20 @@ class ScopedVABufferID {
     return ret == VA_STATUS_SUCCESS ? true : false;
   }
 
+  // Updates contents of an already created buffer in place. Size needs
+  // to match the one used while creating the buffer.
+  bool UpdateBuffer(const void* data, uint32_t size) {
+    if (buffer_ == VA_INVALID_ID)
+      return false;
+
+    void* mapped = NULL;
+    if (vaMapBuffer(display_, buffer_, &mapped) != VA_STATUS_SUCCESS)
+      return false;
+
+    memcpy(mapped, data, size);
+    return vaUnmapBuffer(display_, buffer_) == VA_STATUS_SUCCESS;
+  }
+
   operator VABufferID() const {
     return buffer_;
   }
@@ -82,6 +99,46 @@ typedef struct _HwcDeinterlaceCap {
   VAProcDeinterlacingType mode_;
 } HwcDeinterlaceCap;
 
+// Pipeline parameter buffer which is recycled across frames. Regions
+// referenced by the parameter buffer live alongside it, so that they
+// stay valid till vaEndPicture is called.
+struct VAPipelineSlot {
+  explicit VAPipelineSlot(VADisplay display) : buffer_(display) {
+  }
+
+  ScopedVABufferID buffer_;
+  VARectangle surface_region_;
+  VARectangle output_region_;
+#ifdef VA_WITH_VPP
+  VABlendState blend_state_;
+#endif
+};
+
+// VA config, context and all buffers created against it for a given
+// render target format.
+struct VAContextState {
+  VAConfigID config_ = VA_INVALID_ID;
+  VAContextID context_ = VA_INVALID_ID;
+  std::vector<VABufferID> filters_;
+  std::unique_ptr<ScopedVABufferID> cb_elements_;
+  std::unique_ptr<ScopedVABufferID> sharp_;
+  std::unique_ptr<ScopedVABufferID> deinterlace_;
+  // Last parameters uploaded to the filter buffers above.
+  std::vector<VAProcFilterParameterBufferColorBalance> cb_params_;
+  float sharp_value_ = 0;
+  VAProcDeinterlacingType deinterlace_mode_ = VAProcDeinterlacingNone;
+  // Filter settings generation the filter buffers were built for.
+  uint32_t caps_generation_ = 0;
+  std::vector<std::unique_ptr<VAPipelineSlot>> pipeline_buffers_;
+};
+
+// Time spent per frame in setting up VA state vs actual processing.
+struct VAFrameStats {
+  int64_t setup_time_us_ = 0;
+  int64_t processing_time_us_ = 0;
+  uint64_t frames_ = 0;
+};
+
 class VARenderer : public Renderer {
  public:
   VARenderer() = default;
@@ -96,6 +153,10 @@ class VARenderer : public Renderer {
 
   bool DestroyMediaResources(std::vector<struct media_import>&) override;
 
+  const VAFrameStats& GetFrameStats() const {
+    return stats_;
+  }
+
  private:
   bool QueryVAProcFilterCaps(VAContextID context, VAProcFilterType type,
                              void* caps, uint32_t* num);
@@ -110,27 +171,28 @@ class VARenderer : public Renderer {
                                      VAProcColorBalanceType vamode);
   bool GetVAProcDeinterlaceFlagFromVideo(const HWCDeinterlaceFlag flag,
                                          OverlayBuffer* buffer);
-  bool CreateContext();
-  void DestroyContext();
-  bool LoadCaps();
-  bool UpdateCaps();
+  VAContextState* GetContext(int rt_format);
+  bool CreateContext(VAContextState* context);
+  void DestroyContext(VAContextState* context);
+  void DestroyContexts();
+  bool LoadCaps(VAContextID context);
+  bool UpdateCaps(VAContextState* context);
 #if VA_MAJOR_VERSION >= 1
   void HWCTransformToVA(uint32_t transform, uint32_t& rotation,
                         uint32_t& mirror);
 #endif
 
   bool update_caps_ = false;
+  bool caps_loaded_ = false;
+  // Incremented every time filter settings change.
+  uint32_t caps_generation_ = 1;
   void* va_display_ = nullptr;
-  std::vector<VABufferID> filters_;
-  std::vector<ScopedVABufferID> cb_elements_;
-  std::vector<ScopedVABufferID> sharp_;
-  std::vector<ScopedVABufferID> deinterlace_;
   std::map<HWCColorControl, HwcColorBalanceCap> colorbalance_caps_;
   HwcFilterCap sharp_caps_;
   HwcDeinterlaceCap deinterlace_caps_;
-  int render_target_format_ = VA_RT_FORMAT_YUV420;
-  VAContextID va_context_ = VA_INVALID_ID;
-  VAConfigID va_config_ = VA_INVALID_ID;
+  // One context per render target format, kept alive till we are destroyed.
+  std::map<int, VAContextState> contexts_;
+  VAFrameStats stats_;
 };
 
 }  // namespace hwcomposer
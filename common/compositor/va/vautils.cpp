@@ -22,41 +22,37 @@
 
 #include <hwctrace.h>
 
+#include "hwcformats.h"
+
 #include "platformdefines.h"
 
 namespace hwcomposer {
 
+static_assert(GetFormatInfo(DRM_FORMAT_NV12)->va_fourcc == VA_FOURCC_NV12 &&
+                  GetFormatInfo(DRM_FORMAT_YVU420)->va_fourcc ==
+                      VA_FOURCC_YV12 &&
+                  GetFormatInfo(DRM_FORMAT_YUYV)->va_fourcc ==
+                      VA_FOURCC_YUY2 &&
+                  GetFormatInfo(DRM_FORMAT_UYVY)->va_fourcc ==
+                      VA_FOURCC_UYVY &&
+                  GetFormatInfo(DRM_FORMAT_P010)->va_fourcc ==
+                      VA_FOURCC_P010 &&
+                  GetFormatInfo(DRM_FORMAT_ABGR8888)->va_fourcc ==
+                      VA_FOURCC_RGBA &&
+                  GetFormatInfo(DRM_FORMAT_XBGR8888)->va_fourcc ==
+                      VA_FOURCC_RGBX &&
+                  GetFormatInfo(DRM_FORMAT_ARGB8888)->va_fourcc ==
+                      VA_FOURCC_ABGR,
+              "Format table doesn't match VA fourccs");
+
 int DrmFormatToVAFormat(int format) {
-  switch (format) {
-    case DRM_FORMAT_NV12:
-      return VA_FOURCC_NV12;
-    case DRM_FORMAT_YVU420:
-      return VA_FOURCC_YV12;
-    case DRM_FORMAT_YUV420:
-      return VA_FOURCC('I', '4', '2', '0');
-    case DRM_FORMAT_YUV422:
-      return VA_FOURCC_YUY2;
-    case DRM_FORMAT_UYVY:
-      return VA_FOURCC_UYVY;
-    case DRM_FORMAT_YUYV:
-      return VA_FOURCC_YUY2;
-    case DRM_FORMAT_P010:
-      return VA_FOURCC_P010;
-    case DRM_FORMAT_ABGR8888:
-      return VA_FOURCC_RGBA;
-    case DRM_FORMAT_XBGR8888:
-      return VA_FOURCC_RGBX;
-    case DRM_FORMAT_ARGB8888:
-      return VA_FOURCC_ABGR;
-    case DRM_FORMAT_YVYU:
-    case DRM_FORMAT_VYUY:
-    case DRM_FORMAT_YUV444:
-    case DRM_FORMAT_AYUV:
-    default:
-      ETRACE("Unable to convert to VAFormat from format %x", format);
-      break;
+  const HwcFormatInfo *info = GetFormatInfo(format);
+  if (!info || !info->va_fourcc) {
+    ETRACE("Unable to convert to VAFormat from format %x", format);
+    return 0;
   }
-  return 0;
+
+  return info->va_fourcc;
 }
 
 int DrmFormatToRTFormat(int format) {
@@ -0,0 +1,77 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "bufferimportcache.h"
+
+#include <nativebufferhandler.h>
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+bool BufferImportCache::AcquireImport(HWCNativeHandle source,
+                                      HWCNativeHandle *target) {
+  BufferImportKey key;
+  bool cacheable = GetNativeBufferImportKey(source, &key);
+
+  ScopedSpinLock lock(lock_);
+  if (cacheable) {
+    auto it = import_map_.find(key);
+    if (it != import_map_.end()) {
+      it->second.import_ref++;
+      *target = it->second.handle;
+      return true;
+    }
+  }
+
+  handler_->CopyHandle(source, target);
+  if (!handler_->ImportBuffer(*target)) {
+    ETRACE("Failed to Import buffer.");
+    return false;
+  }
+
+  if (cacheable) {
+    ImportValue value;
+    value.handle = *target;
+    value.import_ref = 1;
+    import_map_.emplace(std::make_pair(key, value));
+    handle_map_.emplace(std::make_pair(*target, key));
+  }
+
+  return true;
+}
+
+void BufferImportCache::ReleaseImport(HWCNativeHandle handle) {
+  lock_.lock();
+  auto search = handle_map_.find(handle);
+  if (search != handle_map_.end()) {
+    auto it = import_map_.find(search->second);
+    if (it != import_map_.end() && --it->second.import_ref > 0) {
+      lock_.unlock();
+      return;
+    }
+
+    if (it != import_map_.end())
+      import_map_.erase(it);
+    handle_map_.erase(search);
+  }
+
+  lock_.unlock();
+  handler_->ReleaseBuffer(handle);
+  handler_->DestroyHandle(handle);
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,105 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/** \file */
+#ifndef COMMON_CORE_BUFFER_IMPORT_CACHE_H_
+#define COMMON_CORE_BUFFER_IMPORT_CACHE_H_
+
+#include <hwcdefs.h>
+#include <platformdefines.h>
+
+#include <unordered_map>
+
+#include <spinlock.h>
+
+namespace hwcomposer {
+
+class NativeBufferHandler;
+
+typedef struct {
+  HWCNativeHandle handle;
+  uint32_t import_ref;
+} ImportValue;
+
+struct ImportHash {
+  size_t operator()(BufferImportKey const &key) const {
+    size_t seed = static_cast<size_t>(key.ino_);
+    hash_combine_hwc(seed, static_cast<size_t>(key.dev_));
+    hash_combine_hwc(seed, static_cast<size_t>(key.modifier_));
+    hash_combine_hwc(seed, key.offsets_[1]);
+    hash_combine_hwc(seed, key.format_);
+    return seed;
+  }
+};
+
+struct ImportEqual {
+  bool operator()(const BufferImportKey &p1, const BufferImportKey &p2) const {
+    bool equal = (p1.ino_ == p2.ino_) && (p1.dev_ == p2.dev_) &&
+                 (p1.modifier_ == p2.modifier_) &&
+                 (p1.format_ == p2.format_) && (p1.flags_ == p2.flags_) &&
+                 (p1.offsets_[0] == p2.offsets_[0]) &&
+                 (p1.offsets_[1] == p2.offsets_[1]) &&
+                 (p1.offsets_[2] == p2.offsets_[2]) &&
+                 (p1.offsets_[3] == p2.offsets_[3]);
+    return equal;
+  }
+};
+
+/**
+* Device wide cache of imported client buffers.
+*
+* Every display used to import a client buffer on its own, so a buffer shown
+* on N displays cost N dups, N gbm imports and N framebuffer lookups, and
+* releasing one of the imports could close GEM handles still in use by the
+* others. Imports are now keyed by dma-buf identity and refcounted, one
+* reference per DrmBuffer. Each display keeps its own DrmBuffer and drops its
+* reference only once its own release fences allow it, so the shared import
+* stays alive until the last display is done with it.
+*/
+class BufferImportCache {
+ public:
+  BufferImportCache(const NativeBufferHandler *handler) : handler_(handler) {
+  }
+
+  /**
+  * Return an imported copy of source, shared with every other user of the
+  * same dma-buf.
+  *
+  * @param source client handle to import.
+  * @param target set to the shared imported handle. On failure it may still
+  *        point to an uncached copy which must be passed to ReleaseImport.
+  * @return true if target holds a valid import.
+  */
+  bool AcquireImport(HWCNativeHandle source, HWCNativeHandle *target);
+
+  /**
+  * Drop a reference taken by AcquireImport. The handle is released and
+  * destroyed once no display refers to it anymore.
+  *
+  * @param handle handle returned by AcquireImport.
+  */
+  void ReleaseImport(HWCNativeHandle handle);
+
+ private:
+  SpinLock lock_;
+  std::unordered_map<BufferImportKey, ImportValue, ImportHash, ImportEqual>
+      import_map_;
+  std::unordered_map<HWCNativeHandle, BufferImportKey> handle_map_;
+  const NativeBufferHandler *handler_ = NULL;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_CORE_BUFFER_IMPORT_CACHE_H_
@@ -68,6 +68,16 @@ bool GpuDevice::Initialize() {
 
   HandleHWCSettings();
 
+  if (reactor_workers_ > 0) {
+    reactor_.reset(new HWCReactor(reactor_workers_, "HWCReactor"));
+    if (!reactor_->Initialize()) {
+      ETRACE("Failed to initialize reactor, using a thread per component.");
+      reactor_.reset(nullptr);
+    } else {
+      display_manager_->MoveHotPlugMonitorToReactor(reactor_.get());
+    }
+  }
+
   if (reserve_plane_) {
     display_manager_->RemoveUnreservedPlanes();
   }
@@ -93,6 +103,19 @@ FrameBufferManager *GpuDevice::GetFrameBufferManager() {
   return display_manager_->GetFrameBufferManager();
 }
 
+BufferImportCache *GpuDevice::GetBufferImportCache() {
+  return display_manager_->GetBufferImportCache();
+}
+
+bool GpuDevice::BeginCommitBatch(const std::vector<NativeDisplay *> &displays) {
+  return display_manager_->BeginCommitBatch(displays);
+}
+
+bool GpuDevice::FlushCommitBatch(const std::vector<NativeDisplay *> &displays,
+                                 int32_t *retire_fence) {
+  return display_manager_->FlushCommitBatch(displays, retire_fence);
+}
+
 uint32_t GpuDevice::GetFD() const {
   return display_manager_->GetFD();
 }
@@ -585,6 +608,108 @@ void GpuDevice::ParseFloatDisplaySetting(
   }
 }
 
+void GpuDevice::ParseThreadAffinitySetting(
+    std::string &value,
+    std::map<std::string, HWCThreadPolicy> &thread_policies) {
+  std::istringstream i_value(value);
+  std::string thread_str;
+
+  // Got each thread setting, with format "thread-name:cpu-mask"
+  while (std::getline(i_value, thread_str, ';')) {
+    size_t separator = thread_str.find(":");
+    if (separator == std::string::npos || separator == 0)
+      continue;
+
+    std::string mask_str = thread_str.substr(separator + 1);
+    if (mask_str.empty())
+      continue;
+
+    uint64_t mask = strtoull(mask_str.c_str(), NULL, 0);
+    if (mask == 0)
+      continue;
+
+    thread_policies[thread_str.substr(0, separator)].affinity_mask = mask;
+  }
+}
+
+void GpuDevice::ParseThreadNiceSetting(
+    std::string &value,
+    std::map<std::string, HWCThreadPolicy> &thread_policies) {
+  std::istringstream i_value(value);
+  std::string thread_str;
+
+  // Got each thread setting, with format "thread-name:nice"
+  while (std::getline(i_value, thread_str, ';')) {
+    size_t separator = thread_str.find(":");
+    if (separator == std::string::npos || separator == 0)
+      continue;
+
+    std::string nice_str = thread_str.substr(separator + 1);
+    if (nice_str.empty() ||
+        nice_str.find_first_not_of("-0123456789") != std::string::npos)
+      continue;
+
+    HWCThreadPolicy &policy = thread_policies[thread_str.substr(0, separator)];
+    policy.has_nice = true;
+    policy.nice = atoi(nice_str.c_str());
+  }
+}
+
+void GpuDevice::ParseThreadPolicySetting(
+    std::string &value,
+    std::map<std::string, HWCThreadPolicy> &thread_policies) {
+  std::istringstream i_value(value);
+  std::string thread_str;
+
+  // Got each thread setting, with format "thread-name:policy+param+..."
+  while (std::getline(i_value, thread_str, ';')) {
+    size_t separator = thread_str.find(":");
+    if (separator == std::string::npos || separator == 0)
+      continue;
+
+    std::istringstream i_policy(thread_str.substr(separator + 1));
+    std::string policy_str;
+    std::string param_str;
+    std::vector<uint64_t> params;
+    std::getline(i_policy, policy_str, '+');
+    while (std::getline(i_policy, param_str, '+')) {
+      if (param_str.empty() ||
+          param_str.find_first_not_of("0123456789") != std::string::npos)
+        break;
+
+      params.emplace_back(strtoull(param_str.c_str(), NULL, 10));
+    }
+
+    HWCThreadPolicy policy;
+    if (!policy_str.compare("fifo") && params.size() == 1) {
+      policy.policy = HWCThreadPolicy::kFifo;
+      policy.rt_priority = params.at(0);
+    } else if (!policy_str.compare("rr") && params.size() == 1) {
+      policy.policy = HWCThreadPolicy::kRoundRobin;
+      policy.rt_priority = params.at(0);
+    } else if (!policy_str.compare("deadline") && params.size() == 3) {
+      // Parameters are runtime, deadline and period in microseconds.
+      policy.policy = HWCThreadPolicy::kDeadline;
+      policy.runtime_ns = params.at(0) * 1000;
+      policy.deadline_ns = params.at(1) * 1000;
+      policy.period_ns = params.at(2) * 1000;
+    } else if (!policy_str.compare("normal") && params.empty()) {
+      policy.policy = HWCThreadPolicy::kNormal;
+    } else {
+      ETRACE("Invalid thread policy setting: %s", thread_str.c_str());
+      continue;
+    }
+
+    HWCThreadPolicy &thread_policy =
+        thread_policies[thread_str.substr(0, separator)];
+    thread_policy.policy = policy.policy;
+    thread_policy.rt_priority = policy.rt_priority;
+    thread_policy.runtime_ns = policy.runtime_ns;
+    thread_policy.deadline_ns = policy.deadline_ns;
+    thread_policy.period_ns = policy.period_ns;
+  }
+}
+
 void GpuDevice::InitializeDisplayIndex(std::vector<uint32_t> &physical_displays,
                                        std::vector<NativeDisplay *> &displays) {
   std::vector<NativeDisplay *> unordered_displays =
@@ -834,6 +959,7 @@ void GpuDevice::HandleHWCSettings() {
   std::vector<HwcRect<int32_t>> float_displays;
   std::vector<std::vector<uint32_t>> cloned_displays;
   std::vector<std::vector<uint32_t>> mosaic_displays;
+  std::map<std::string, HWCThreadPolicy> thread_policies;
 #ifdef ENABLE_PANORAMA
   bool use_panorama = false;
   std::vector<std::vector<uint32_t>> panorama_displays;
@@ -848,6 +974,15 @@ void GpuDevice::HandleHWCSettings() {
   std::string key_rotate("ROTATION");
   std::string key_float("FLOAT");
   std::string key_plane_reserved("PLANE_RESERVED");
+  std::string key_mosaic_atomic_commit("MOSAIC_ATOMIC_COMMIT");
+  std::string key_mosaic_present_workers("MOSAIC_PRESENT_WORKERS");
+  std::string key_reactor_workers("REACTOR_WORKERS");
+  std::string key_idle_timeout("IDLE_TIMEOUT_MS");
+  std::string key_idle_exit("IDLE_EXIT_MS");
+  std::string key_late_composition("LATE_COMPOSITION");
+  std::string key_thread_affinity("THREAD_AFFINITY");
+  std::string key_thread_nice("THREAD_NICE");
+  std::string key_thread_policy("THREAD_POLICY");
   std::string key_logical_display("LOGICAL_DISPLAY");
   std::string key_mosaic_display("MOSAIC_DISPLAY");
   std::string key_physical_display("PHYSICAL_DISPLAY");
@@ -912,6 +1047,37 @@ void GpuDevice::HandleHWCSettings() {
           if (!value.compare(enable_str)) {
             reserve_plane_ = true;
           }
+          // Got mosaic atomic commit switch
+        } else if (!key.compare(key_mosaic_atomic_commit)) {
+          if (!value.compare(enable_str)) {
+            mosaic_atomic_commit_ = true;
+          }
+          // Got mosaic present worker count
+        } else if (!key.compare(key_mosaic_present_workers)) {
+          mosaic_present_workers_ = atoi(value.c_str());
+          // Got reactor worker count
+        } else if (!key.compare(key_reactor_workers)) {
+          reactor_workers_ = atoi(value.c_str());
+          // Got idle timeout
+        } else if (!key.compare(key_idle_timeout)) {
+          idle_timeout_ms_ = atoi(value.c_str());
+          // Got idle exit time
+        } else if (!key.compare(key_idle_exit)) {
+          idle_exit_ms_ = atoi(value.c_str());
+          // Got late composition switch
+        } else if (!key.compare(key_late_composition)) {
+          if (!value.compare(enable_str)) {
+            late_composition_ = true;
+          }
+          // Got thread cpu affinity config
+        } else if (!key.compare(key_thread_affinity)) {
+          ParseThreadAffinitySetting(value, thread_policies);
+          // Got thread nice config
+        } else if (!key.compare(key_thread_nice)) {
+          ParseThreadNiceSetting(value, thread_policies);
+          // Got thread scheduling policy config
+        } else if (!key.compare(key_thread_policy)) {
+          ParseThreadPolicySetting(value, thread_policies);
           // Got logical display index
         } else if (!key.compare(key_logical_display)) {
           ParseLogicalDisplaySetting(value, logical_displays);
@@ -950,6 +1116,12 @@ void GpuDevice::HandleHWCSettings() {
     }
   };
 
+  // Threads which are already running, i.e. the hotplug monitor, pick up
+  // their settings here; the others apply them once they start.
+  for (auto &thread_policy : thread_policies) {
+    HWCThreadScheduler::SetPolicy(thread_policy.first, thread_policy.second);
+  }
+
   std::vector<NativeDisplay *> displays;
   InitializeDisplayIndex(physical_displays, displays);
 
@@ -298,6 +298,10 @@ void HwcLayer::Validate() {
     }
   }
 
+  ResetConstraints();
+}
+
+void HwcLayer::ResetConstraints() {
   if (left_constraint_.empty() && left_source_constraint_.empty())
     return;
 
@@ -163,6 +163,14 @@ void LogicalDisplay::SetDisableExplicitSync(bool disable_explicit_sync) {
   physical_display_->SetDisableExplicitSync(disable_explicit_sync);
 }
 
+void LogicalDisplay::SetLateComposition(bool enable) {
+  physical_display_->SetLateComposition(enable);
+}
+
+uint64_t LogicalDisplay::GetCompositionDeadline() {
+  return physical_display_->GetCompositionDeadline();
+}
+
 void LogicalDisplay::SetVideoScalingMode(uint32_t mode) {
   physical_display_->SetVideoScalingMode(mode);
 }
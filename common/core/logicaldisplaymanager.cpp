@@ -136,6 +136,7 @@ bool LogicalDisplayManager::Present(std::vector<HwcLayer*>& source_layers,
                                     int32_t* retire_fence,
                                     PixelUploaderCallback* call_back,
                                     bool handle_constraints) {
+  lock_.lock();
   uint32_t total_size = displays_.size();
   if (handle_hoplug_notifications_) {
     uint32_t size = displays_.size();
@@ -160,6 +161,7 @@ bool LogicalDisplayManager::Present(std::vector<HwcLayer*>& source_layers,
     std::vector<HwcLayer*>().swap(cursor_layers_);
     std::vector<HwcLayer*>().swap(layers_);
     queued_displays_ = 0;
+    lock_.unlock();
     ITRACE("logical dpm total_size == 0 \n");
     return true;
   }
@@ -177,23 +179,27 @@ bool LogicalDisplayManager::Present(std::vector<HwcLayer*>& source_layers,
 
     queued_displays_++;
     if (queued_displays_ < total_size) {
+      lock_.unlock();
       return true;
     }
   }
 
-  layers_.insert(layers_.end(), cursor_layers_.begin(), cursor_layers_.end());
+  // These need to stay alive until the next frame, as release fences are
+  // set only once a batched Mosaic commit is flushed.
+  present_layers_.swap(layers_);
+  present_layers_.insert(present_layers_.end(), cursor_layers_.begin(),
+                         cursor_layers_.end());
+  std::vector<HwcLayer*>().swap(cursor_layers_);
+  std::vector<HwcLayer*>().swap(layers_);
+  queued_displays_ = 0;
+  lock_.unlock();
 
-  if (layers_.empty()) {
-    queued_displays_ = 0;
+  if (present_layers_.empty()) {
     return true;
   }
 
-  bool success = physical_display_->Present(layers_, retire_fence, call_back,
-                                            handle_constraints);
-  std::vector<HwcLayer*>().swap(cursor_layers_);
-  std::vector<HwcLayer*>().swap(layers_);
-  queued_displays_ = 0;
-  return success;
+  return physical_display_->Present(present_layers_, retire_fence, call_back,
+                                    handle_constraints);
 }
 
 void LogicalDisplayManager::VSyncCallback(int64_t timestamp) {
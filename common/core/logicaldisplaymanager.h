@@ -21,6 +21,7 @@
 #include <stdlib.h>
 
 #include <nativedisplay.h>
+#include <spinlock.h>
 #include "logicaldisplay.h"
 
 namespace hwcomposer {
@@ -106,9 +107,11 @@ class LogicalDisplayManager {
   std::vector<std::unique_ptr<LogicalDisplay>> displays_;
   std::vector<HwcLayer*> layers_;
   std::vector<HwcLayer*> cursor_layers_;
+  std::vector<HwcLayer*> present_layers_;
   uint32_t queued_displays_ = 0;
   bool hot_plug_registered_ = false;
   bool handle_hoplug_notifications_ = false;
+  SpinLock lock_;
 };
 
 }  // namespace hwcomposer
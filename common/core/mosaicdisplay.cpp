@@ -22,6 +22,7 @@
 
 #include <hwclayer.h>
 
+#include "gpudevice.h"
 #include "hwctrace.h"
 
 #ifdef ENABLE_PANORAMA
@@ -251,54 +252,90 @@ bool MosaicDisplay::Present(std::vector<HwcLayer *> &source_layers,
   size_t total_layers = source_layers.size();
   int32_t fence = -1;
   *retire_fence = -1;
+  // Layers need to outlive a batched commit, as release fences are set
+  // only once the batch is flushed.
+  std::vector<MosaicTile> tiles;
+  // Logical displays only queue their layers, the last one presenting
+  // reads the layers of all of them. Keep these serial.
+  bool parallel = true;
   for (uint32_t i = 0; i < size; i++) {
     NativeDisplay *display = connected_displays_.at(i);
-    int32_t right_constraint = left_constraint + display->Width();
-    std::vector<HwcLayer *> layers;
-    uint32_t dlconstraint = display->GetLogicalIndex() * display->Width();
-    uint32_t drconstraint = dlconstraint + display->Width();
+    if (display->Type() == DisplayType::kLogical)
+      parallel = false;
+
+    MosaicTile tile;
+    tile.display_ = display;
+    tile.left_constraint_ = left_constraint;
+    tile.right_constraint_ = left_constraint + display->Width();
+    tile.dlconstraint_ = display->GetLogicalIndex() * display->Width();
+    tile.drconstraint_ = tile.dlconstraint_ + display->Width();
+    tile.total_displays_ = size - i;
     IMOSAICDISPLAYTRACE("Display index %d \n", i);
-    IMOSAICDISPLAYTRACE("dlconstraint %d \n", dlconstraint);
-    IMOSAICDISPLAYTRACE("drconstraint %d \n", drconstraint);
-    IMOSAICDISPLAYTRACE("right_constraint %d \n", right_constraint);
-    IMOSAICDISPLAYTRACE("left_constraint %d \n", left_constraint);
+    IMOSAICDISPLAYTRACE("dlconstraint %d \n", tile.dlconstraint_);
+    IMOSAICDISPLAYTRACE("drconstraint %d \n", tile.drconstraint_);
+    IMOSAICDISPLAYTRACE("right_constraint %d \n", tile.right_constraint_);
+    IMOSAICDISPLAYTRACE("left_constraint %d \n", tile.left_constraint_);
     for (size_t j = 0; j < total_layers; j++) {
       HwcLayer *layer = source_layers.at(j);
       const HwcRect<int> &frame_Rect = layer->GetDisplayFrame();
-      if ((frame_Rect.right < left_constraint) ||
-          (frame_Rect.left > right_constraint)) {
+      if ((frame_Rect.right < tile.left_constraint_) ||
+          (frame_Rect.left > tile.right_constraint_)) {
         continue;
       }
 
-      layer->SetLeftConstraint(dlconstraint);
-      layer->SetRightConstraint(drconstraint);
-      layer->SetLeftSourceConstraint(left_constraint);
-      layer->SetRightSourceConstraint(right_constraint);
-      layer->SetTotalDisplays(size - i);
-
-      layers.emplace_back(layer);
+      tile.layers_.emplace_back(layer);
     }
 
-    if (layers.empty()) {
+    if (tile.layers_.empty()) {
       continue;
     }
 
-    display->Present(layers, &fence, call_back, true);
-    IMOSAICDISPLAYTRACE("Present called for Display index %d \n", i);
-    if (fence > 0) {
-      if (*retire_fence < 0) {
-        *retire_fence = fence;
-      } else {
-        int ret = sync_accumulate("iahwc_mosaic_fence", retire_fence, fence);
-        if (ret) {
-          ETRACE("Unable to merge fences");
-          *retire_fence = -1;
-        }
-        close(fence);
-      }
+    left_constraint = tile.right_constraint_;
+    tiles.emplace_back(std::move(tile));
+  }
+
+  GpuDevice &device = GpuDevice::getInstance();
+  bool batched = device.IsMosaicAtomicCommitEnabled() &&
+                 device.BeginCommitBatch(connected_displays_);
+  uint32_t total_tiles = tiles.size();
+  bool presented = false;
+  // Layer constraints are queued per display and consumed when the display
+  // reads its layers, so each tile sets them up at the start of its
+  // (ordered) read turn.
+  if (parallel && total_tiles > 1 && InitializePresentPool() &&
+      sequencer_.BeginFrame(total_tiles, [&tiles](uint32_t index) {
+        ApplyTileConstraints(tiles.at(index), true);
+      })) {
+    std::vector<std::function<void()>> tasks;
+    for (uint32_t i = 0; i < total_tiles; i++) {
+      tasks.emplace_back([this, &tiles, call_back, i]() {
+        PresentSequencer::ScopedSlot slot(&sequencer_, i);
+        MosaicTile &tile = tiles.at(i);
+        tile.display_->Present(tile.layers_, &tile.fence_, call_back, true);
+        IMOSAICDISPLAYTRACE("Present called for Display index %d \n", i);
+      });
     }
 
-    left_constraint = right_constraint;
+    present_pool_->Run(tasks);
+    presented = true;
+  }
+
+  for (uint32_t i = 0; i < total_tiles && !presented; i++) {
+    MosaicTile &tile = tiles.at(i);
+    ApplyTileConstraints(tile, false);
+    tile.display_->Present(tile.layers_, &tile.fence_, call_back, true);
+    IMOSAICDISPLAYTRACE("Present called for Display index %d \n", i);
+  }
+
+  // Merge in display order, independent of completion order.
+  for (MosaicTile &tile : tiles) {
+    MergeRetireFence(tile.fence_, retire_fence);
+  }
+
+  if (batched) {
+    fence = -1;
+    device.FlushCommitBatch(connected_displays_, &fence);
+    MergeRetireFence(fence, retire_fence);
   }
 
 #ifdef ENABLE_PANORAMA
@@ -311,6 +348,61 @@ bool MosaicDisplay::Present(std::vector<HwcLayer *> &source_layers,
   return true;
 }
 
+void MosaicDisplay::MergeRetireFence(int32_t fence, int32_t *retire_fence) {
+  if (fence <= 0)
+    return;
+
+  if (*retire_fence < 0) {
+    *retire_fence = fence;
+  } else {
+    int ret = sync_accumulate("iahwc_mosaic_fence", retire_fence, fence);
+    if (ret) {
+      ETRACE("Unable to merge fences");
+      *retire_fence = -1;
+    }
+    close(fence);
+  }
+}
+
+void MosaicDisplay::ApplyTileConstraints(const MosaicTile &tile,
+                                         bool reset) {
+  for (HwcLayer *layer : tile.layers_) {
+    // When presenting in parallel, a previous display might only validate
+    // the layer (clearing its constraints) after our turn.
+    if (reset)
+      layer->ResetConstraints();
+
+    layer->SetLeftConstraint(tile.dlconstraint_);
+    layer->SetRightConstraint(tile.drconstraint_);
+    layer->SetLeftSourceConstraint(tile.left_constraint_);
+    layer->SetRightSourceConstraint(tile.right_constraint_);
+    layer->SetTotalDisplays(tile.total_displays_);
+  }
+}
+
+bool MosaicDisplay::InitializePresentPool() {
+  uint32_t workers = GpuDevice::getInstance().GetMosaicPresentWorkers();
+  if (workers == 0)
+    return false;
+
+  // The presenting thread takes part in the work.
+  uint32_t max_workers = connected_displays_.size() - 1;
+  if (workers > max_workers)
+    workers = max_workers;
+
+  if (present_pool_ && present_pool_->GetMaxWorkers() == workers)
+    return true;
+
+  present_pool_.reset(new HWCWorkerPool(workers, "MosaicPresent"));
+  if (!present_pool_->Initialize()) {
+    ETRACE("Failed to create mosaic present workers, presenting serially.");
+    present_pool_.reset();
+    return false;
+  }
+
+  return true;
+}
+
 bool MosaicDisplay::PresentClone(NativeDisplay * /*display*/) {
   return false;
 }
@@ -496,6 +588,30 @@ void MosaicDisplay::SetDisableExplicitSync(bool disable_explicit_sync) {
   }
 }
 
+void MosaicDisplay::SetLateComposition(bool enable) {
+  uint32_t size = physical_displays_.size();
+  for (uint32_t i = 0; i < size; i++) {
+    physical_displays_.at(i)->SetLateComposition(enable);
+  }
+}
+
+uint64_t MosaicDisplay::GetCompositionDeadline() {
+  // All displays are presented together, so the earliest deadline wins.
+  uint64_t deadline = 0;
+  uint32_t size = physical_displays_.size();
+  for (uint32_t i = 0; i < size; i++) {
+    uint64_t display_deadline =
+        physical_displays_.at(i)->GetCompositionDeadline();
+    if (!display_deadline)
+      return 0;
+
+    if (!deadline || display_deadline < deadline)
+      deadline = display_deadline;
+  }
+
+  return deadline;
+}
+
 void MosaicDisplay::SetVideoScalingMode(uint32_t mode) {
   uint32_t size = physical_displays_.size();
   for (uint32_t i = 0; i < size; i++) {
@@ -21,10 +21,13 @@
 #include <stdlib.h>
 
 #include <memory>
+#include <vector>
 
 #include <nativedisplay.h>
 #include <spinlock.h>
 #include "hwcevent.h"
+#include "hwcworkerpool.h"
+#include "presentsequencer.h"
 
 namespace hwcomposer {
 #ifdef ENABLE_PANORAMA
@@ -73,6 +76,8 @@ class MosaicDisplay : public NativeDisplay {
   void SetContrast(uint32_t red, uint32_t green, uint32_t blue) override;
   void SetBrightness(uint32_t red, uint32_t green, uint32_t blue) override;
   void SetDisableExplicitSync(bool disable_explicit_sync) override;
+  void SetLateComposition(bool enable) override;
+  uint64_t GetCompositionDeadline() override;
   void SetVideoScalingMode(uint32_t mode) override;
   void SetVideoColor(HWCColorControl color, float value) override;
   void GetVideoColor(HWCColorControl color, float *value, float *start,
@@ -130,6 +135,22 @@ class MosaicDisplay : public NativeDisplay {
 #endif
 
  private:
+  // Per frame state of a connected display which has layers to present.
+  struct MosaicTile {
+    NativeDisplay *display_ = NULL;
+    std::vector<HwcLayer *> layers_;
+    uint32_t dlconstraint_ = 0;
+    uint32_t drconstraint_ = 0;
+    int32_t left_constraint_ = 0;
+    int32_t right_constraint_ = 0;
+    uint32_t total_displays_ = 0;
+    int32_t fence_ = -1;
+  };
+
+  void MergeRetireFence(int32_t fence, int32_t *retire_fence);
+  static void ApplyTileConstraints(const MosaicTile &tile, bool reset);
+  bool InitializePresentPool();
+
   std::vector<NativeDisplay *> physical_displays_;
   std::vector<NativeDisplay *> connected_displays_;
   std::shared_ptr<RefreshCallback> refresh_callback_ = NULL;
@@ -166,6 +187,8 @@ class MosaicDisplay : public NativeDisplay {
   HWCEvent event_;
 #endif
   SpinLock lock_;
+  std::unique_ptr<HWCWorkerPool> present_pool_;
+  PresentSequencer sequencer_;
 };
 
 }  // namespace hwcomposer
@@ -281,6 +281,7 @@ void OverlayLayer::InitializeState(HwcLayer* layer,
 #endif
 
   alpha_ = layer->GetAlpha();
+  source_layer_ = layer;
   layer_index_ = layer_index;
   z_order_ = z_order;
   source_crop_width_ = layer->GetSourceCropWidth();
@@ -314,13 +315,31 @@ void OverlayLayer::InitializeState(HwcLayer* layer,
     SetBuffer(layer->GetNativeHandle(), layer->GetAcquireFence(),
               resource_manager, true);
   } else if (Composition_SolidColor == layer->GetLayerCompositionType()) {
-    type_ = kLayerSolidColor;
-    source_crop_width_ = layer->GetDisplayFrameWidth();
-    source_crop_height_ = layer->GetDisplayFrameHeight();
-    source_crop_.left = source_crop_.top = 0;
-    source_crop_.right = source_crop_width_;
-    source_crop_.top = source_crop_height_;
-    imported_buffer_.reset(NULL);
+    HWCNativeHandle handle = 0;
+    if (resource_manager) {
+      handle = resource_manager->GetSolidColorBuffer(
+          solid_color_, blending_ == HWCBlending::kBlendingPremult);
+    }
+
+    if (handle) {
+      // Let the plane scaler stretch a small buffer filled with the color,
+      // so that the layer can be scanned out directly.
+      SetBuffer(handle, -1, resource_manager, true);
+      type_ = kLayerSolidColor;
+      source_crop_width_ = SOLID_COLOR_BUFFER_SIZE;
+      source_crop_height_ = SOLID_COLOR_BUFFER_SIZE;
+      source_crop_.left = source_crop_.top = 0;
+      source_crop_.right = SOLID_COLOR_BUFFER_SIZE;
+      source_crop_.bottom = SOLID_COLOR_BUFFER_SIZE;
+    } else {
+      type_ = kLayerSolidColor;
+      source_crop_width_ = layer->GetDisplayFrameWidth();
+      source_crop_height_ = layer->GetDisplayFrameHeight();
+      source_crop_.left = source_crop_.top = 0;
+      source_crop_.right = source_crop_width_;
+      source_crop_.top = source_crop_height_;
+      imported_buffer_.reset(NULL);
+    }
   } else {
     ETRACE(
         "HWC don't support a layer with no buffer handle except in SolidColor "
@@ -483,6 +502,85 @@ void OverlayLayer::InitializeFromScaledHwcLayer(
                   max_height, max_width, rotation, handle_constraints);
 }
 
+uint32_t OverlayLayer::GetDirtyState(HwcLayer* layer,
+                                     const OverlayLayer& cached_layer,
+                                     uint32_t z_order, uint32_t rotation) {
+  if (!layer->GetNativeHandle() || !cached_layer.GetBuffer() ||
+      (cached_layer.type_ == kLayerSolidColor) ||
+      (Composition_SolidColor == layer->GetLayerCompositionType())) {
+    return kDirtyAll;
+  }
+
+  uint32_t dirty = 0;
+  if (layer->HasLayerContentChanged() ||
+      (cached_layer.GetBuffer()->GetOriginalHandle() !=
+       layer->GetNativeHandle())) {
+    dirty |= kDirtyBuffer;
+  }
+
+  if (!(cached_layer.display_frame_ == layer->GetDisplayFrame()) ||
+      !(cached_layer.source_crop_ == layer->GetSourceCrop()) ||
+      layer->HasVisibleRegionChanged()) {
+    dirty |= kDirtyGeometry;
+  }
+
+  if ((cached_layer.transform_ != layer->GetTransform()) ||
+      (cached_layer.plane_transform_ != rotation)) {
+    dirty |= kDirtyTransform;
+  }
+
+  if ((cached_layer.alpha_ != layer->GetAlpha()) ||
+      (cached_layer.blending_ != layer->GetBlending()) ||
+      (cached_layer.dataspace_ != layer->GetDataSpace())) {
+    dirty |= kDirtyBlending;
+  }
+
+  if (!layer->GetLayerDamage().empty())
+    dirty |= kDirtyDamage;
+
+  if ((cached_layer.z_order_ != z_order) || layer->HasZorderChanged())
+    dirty |= kDirtyZorder;
+
+  return dirty;
+}
+
+void OverlayLayer::InitializeFromPreviousFrame(
+    HwcLayer* layer, ResourceManager* resource_manager,
+    const OverlayLayer& cached_layer, OverlayLayer* previous_layer,
+    uint32_t z_order, uint32_t layer_index, uint32_t max_height,
+    uint32_t max_width) {
+  transform_ = cached_layer.transform_;
+  plane_transform_ = cached_layer.plane_transform_;
+  merged_transform_ = cached_layer.merged_transform_;
+  alpha_ = cached_layer.alpha_;
+  source_layer_ = layer;
+  layer_index_ = layer_index;
+  z_order_ = z_order;
+  source_crop_width_ = cached_layer.source_crop_width_;
+  source_crop_height_ = cached_layer.source_crop_height_;
+  source_crop_ = cached_layer.source_crop_;
+  display_frame_width_ = cached_layer.display_frame_width_;
+  display_frame_height_ = cached_layer.display_frame_height_;
+  display_frame_ = cached_layer.display_frame_;
+  dataspace_ = cached_layer.dataspace_;
+  blending_ = cached_layer.blending_;
+  solid_color_ = layer->GetSolidColor();
+  TransformDamage(layer, max_height, max_width);
+
+  SetBuffer(layer->GetNativeHandle(), layer->GetAcquireFence(),
+            resource_manager, true);
+
+  if (!surface_damage_.empty() && (type_ == kLayerCursor)) {
+    const std::shared_ptr<OverlayBuffer>& buffer = imported_buffer_->buffer_;
+    surface_damage_.right = surface_damage_.left + buffer->GetWidth();
+    surface_damage_.bottom = surface_damage_.top + buffer->GetHeight();
+  }
+
+  if (previous_layer) {
+    ValidatePreviousFrameState(previous_layer, layer);
+  }
+}
+
 void OverlayLayer::ValidatePreviousFrameState(OverlayLayer* rhs,
                                               HwcLayer* layer) {
   OverlayBuffer* buffer = NULL;
@@ -522,6 +620,14 @@ void OverlayLayer::ValidatePreviousFrameState(OverlayLayer* rhs,
         state_ |= kNeedsReValidation;
       }
     }
+
+    if (type_ == kLayerSolidColor) {
+      if (rhs->type_ != kLayerSolidColor) {
+        state_ |= kNeedsReValidation;
+      } else if (solid_color_ != rhs->solid_color_) {
+        content_changed = true;
+      }
+    }
   } else {
     // Ensure the buffer can be supported by display for direct
     // scanout.
@@ -609,6 +715,108 @@ void OverlayLayer::CloneLayer(const OverlayLayer* layer,
   solid_color_ = layer->solid_color_;
 }
 
+void OverlayLayer::InitializeAsStrip(const OverlayLayer& layer,
+                                     uint32_t z_order, uint32_t strip,
+                                     uint32_t strip_count,
+                                     const OverlayLayer* previous_layer) {
+  int32_t fence = layer.GetAcquireFence();
+  int32_t acquire_fence = -1;
+  if (fence > 0) {
+    acquire_fence = dup(fence);
+  }
+
+  if (layer.imported_buffer_.get()) {
+    imported_buffer_.reset(
+        new ImportedBuffer(layer.imported_buffer_->buffer_, acquire_fence));
+  } else if (acquire_fence > 0) {
+    close(acquire_fence);
+  }
+
+  transform_ = layer.transform_;
+  plane_transform_ = layer.plane_transform_;
+  merged_transform_ = layer.merged_transform_;
+  z_order_ = z_order;
+  layer_index_ = layer.layer_index_;
+  source_crop_width_ = layer.source_crop_width_;
+  source_crop_height_ = layer.source_crop_height_;
+  display_frame_width_ = layer.display_frame_width_;
+  display_frame_height_ = layer.display_frame_height_;
+  alpha_ = layer.alpha_;
+  dataspace_ = layer.dataspace_;
+  solid_color_ = layer.solid_color_;
+  source_crop_ = layer.source_crop_;
+  display_frame_ = layer.display_frame_;
+  surface_damage_ = layer.surface_damage_;
+  blending_ = layer.blending_;
+  state_ = layer.state_;
+  source_layer_ = layer.source_layer_;
+  supported_composition_ = layer.supported_composition_;
+  actual_composition_ = layer.actual_composition_;
+  type_ = layer.type_;
+  if (previous_layer) {
+    supported_composition_ = previous_layer->supported_composition_;
+    actual_composition_ = previous_layer->actual_composition_;
+  }
+
+  CropToStrip(strip, strip_count, previous_layer);
+}
+
+// Returns source offset of the left edge of strip |strip|. Strips start
+// on even columns, so that they work for subsampled YUV formats too.
+static float GetStripOffset(float source_width, uint32_t strip,
+                            uint32_t strip_count) {
+  if (strip == 0)
+    return 0;
+
+  if (strip == strip_count)
+    return source_width;
+
+  return floorf(source_width * strip / strip_count / 2) * 2;
+}
+
+void OverlayLayer::CropToStrip(uint32_t strip, uint32_t strip_count,
+                               const OverlayLayer* previous_layer) {
+  float source_width = source_crop_.right - source_crop_.left;
+  float frame_width = display_frame_.right - display_frame_.left;
+  float left = GetStripOffset(source_width, strip, strip_count);
+  float right = GetStripOffset(source_width, strip + 1, strip_count);
+
+  HwcRect<float> source_crop = source_crop_;
+  source_crop.left = source_crop_.left + left;
+  source_crop.right = source_crop_.left + right;
+
+  HwcRect<int> display_frame = display_frame_;
+  display_frame.left =
+      display_frame_.left +
+      static_cast<int>(roundf(left * frame_width / source_width));
+  display_frame.right =
+      display_frame_.left +
+      static_cast<int>(roundf(right * frame_width / source_width));
+
+  SetSourceCrop(source_crop);
+  SetDisplayFrame(display_frame);
+
+  if (AnalyseOverlap(surface_damage_, display_frame_) != kOutside) {
+    surface_damage_.left = std::max(surface_damage_.left, display_frame_.left);
+    surface_damage_.right =
+        std::min(surface_damage_.right, display_frame_.right);
+  } else {
+    surface_damage_.reset();
+  }
+
+  if (!previous_layer || previous_layer->source_layer_ != source_layer_) {
+    // Strip replaced another layer at this z order.
+    state_ |= kLayerContentChanged | kDimensionsChanged | kNeedsReValidation;
+    return;
+  }
+
+  if (!(display_frame_ == previous_layer->display_frame_) ||
+      !(source_crop_ == previous_layer->source_crop_)) {
+    // Layer has been split differently than in the previous frame.
+    state_ |= kDimensionsChanged | kNeedsReValidation;
+  }
+}
+
 void OverlayLayer::Dump() {
   DUMPTRACE("OverlayLayer Information Starts. -------------");
   switch (blending_) {
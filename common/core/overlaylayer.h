@@ -38,6 +38,19 @@ struct OverlayLayer {
     kAll = kGpu | kDisplay
   };
 
+  // Properties of a layer which changed compared to the layer created for
+  // the same client layer in the previous frame.
+  enum DirtyState {
+    kDirtyBuffer = 1 << 0,     // Buffer handle or contents.
+    kDirtyGeometry = 1 << 1,   // Display frame, source crop or visible region.
+    kDirtyTransform = 1 << 2,  // Layer or display transform.
+    kDirtyBlending = 1 << 3,   // Alpha, blending or dataspace.
+    kDirtyDamage = 1 << 4,     // Surface damage is not empty.
+    kDirtyZorder = 1 << 5,
+    kDirtyContent = kDirtyBuffer | kDirtyDamage,
+    kDirtyAll = (1 << 6) - 1
+  };
+
   OverlayLayer() = default;
   void SetAcquireFence(int32_t acquire_fence);
 
@@ -59,6 +72,32 @@ struct OverlayLayer {
                                     const HwcRect<int>& display_frame,
                                     uint32_t max_height, uint32_t max_width,
                                     uint32_t rotation, bool handle_constraints);
+
+  // Returns the DirtyState of layer compared to cached_layer, the layer
+  // created for the same client layer in the previous frame, which is
+  // at z order z_order now. Layers with a solid color or whose geometry
+  // was adjusted for the display, i.e. scaled, constrained or split into
+  // strips, are always fully dirty.
+  static uint32_t GetDirtyState(HwcLayer* layer,
+                                const OverlayLayer& cached_layer,
+                                uint32_t z_order, uint32_t rotation);
+
+  // Initialize OverlayLayer from cached_layer, when only kDirtyContent
+  // properties of layer changed. Geometry and transforms of cached_layer
+  // are kept, only buffer and damage are taken from layer. previous_layer
+  // is the layer at same z order in the previous frame.
+  void InitializeFromPreviousFrame(HwcLayer* layer,
+                                   ResourceManager* resource_manager,
+                                   const OverlayLayer& cached_layer,
+                                   OverlayLayer* previous_layer,
+                                   uint32_t z_order, uint32_t layer_index,
+                                   uint32_t max_height, uint32_t max_width);
+
+  // Client layer this layer was initialized from.
+  const HwcLayer* GetSourceLayer() const {
+    return source_layer_;
+  }
+
   // Get z order of this layer.
   uint32_t GetZorder() const {
     return z_order_;
@@ -80,6 +119,10 @@ struct OverlayLayer {
     return blending_;
   }
 
+  uint32_t GetDataSpace() const {
+    return dataspace_;
+  }
+
   // This represents the transform to
   // be applied to this layer without taking
   // into account any Display transform i.e.
@@ -252,6 +295,19 @@ struct OverlayLayer {
   void CloneLayer(const OverlayLayer* layer, const HwcRect<int>& display_frame,
                   ResourceManager* resource_manager, uint32_t z_order);
 
+  // Initializes this layer as vertical strip |strip| of |layer|, sharing
+  // its buffer. |layer| must not have been cropped to a strip yet.
+  void InitializeAsStrip(const OverlayLayer& layer, uint32_t z_order,
+                         uint32_t strip, uint32_t strip_count,
+                         const OverlayLayer* previous_layer);
+
+  // Crops source, display frame and damage of this layer to vertical
+  // strip |strip| out of |strip_count|, so that a layer too wide for one
+  // plane can be scanned out by several planes. |previous_layer| is the
+  // layer at same z order in the previous frame.
+  void CropToStrip(uint32_t strip, uint32_t strip_count,
+                   const OverlayLayer* previous_layer);
+
   void Dump();
 
  private:
@@ -312,6 +368,9 @@ struct OverlayLayer {
   HwcRect<int> surface_damage_;
   HWCBlending blending_ = HWCBlending::kBlendingNone;
   uint32_t state_ = kLayerContentChanged | kDimensionsChanged;
+  // Client layer this layer was initialized from, only used to match
+  // layers across frames.
+  const HwcLayer* source_layer_ = NULL;
   std::unique_ptr<ImportedBuffer> imported_buffer_;
   LayerComposition supported_composition_ = kAll;
   LayerComposition actual_composition_ = kAll;
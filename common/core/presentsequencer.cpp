@@ -0,0 +1,139 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "presentsequencer.h"
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+thread_local PresentSequencer::Slot PresentSequencer::current_slot_;
+
+PresentSequencer::PresentSequencer() {
+}
+
+PresentSequencer::~PresentSequencer() {
+}
+
+bool PresentSequencer::BeginFrame(uint32_t total,
+                                  std::function<void(uint32_t)> prologue) {
+  while (turns_.size() < total) {
+    std::unique_ptr<HWCEvent> turn(new HWCEvent());
+    if (!turn->Initialize()) {
+      ETRACE("Failed to create present sequencer turn.");
+      return false;
+    }
+
+    turns_.emplace_back(std::move(turn));
+  }
+
+  prologue_ = prologue;
+  total_ = total;
+  if (total_ > 0)
+    turns_.at(0)->Signal();
+
+  return true;
+}
+
+void PresentSequencer::TakeTurn(Slot &slot) {
+  // Wait for our turn before taking the lock, previous displays need it
+  // to finish their reads.
+  if (!slot.turn_taken_) {
+    turns_.at(slot.index_)->Wait();
+    slot.turn_taken_ = true;
+    Lock(slot);
+    if (prologue_)
+      prologue_(slot.index_);
+
+    return;
+  }
+
+  Lock(slot);
+}
+
+void PresentSequencer::Lock(Slot &slot) {
+  if (slot.lock_depth_++ == 0)
+    layer_lock_.lock();
+}
+
+void PresentSequencer::Unlock(Slot &slot) {
+  if (--slot.lock_depth_ == 0)
+    layer_lock_.unlock();
+}
+
+void PresentSequencer::PassTurn(Slot &slot) {
+  if (slot.turn_passed_)
+    return;
+
+  slot.turn_passed_ = true;
+  if (slot.index_ + 1 < total_)
+    turns_.at(slot.index_ + 1)->Signal();
+}
+
+PresentSequencer::ScopedSlot::ScopedSlot(PresentSequencer *sequencer,
+                                         uint32_t index) {
+  Slot &slot = current_slot_;
+  slot.sequencer_ = sequencer;
+  slot.index_ = index;
+  slot.turn_taken_ = false;
+  slot.turn_passed_ = false;
+  slot.lock_depth_ = 0;
+}
+
+PresentSequencer::ScopedSlot::~ScopedSlot() {
+  Slot &slot = current_slot_;
+  PresentSequencer *sequencer = slot.sequencer_;
+  // Displays which never read their layers (i.e. powered off or idle)
+  // still need to take and hand over their turn.
+  if (!slot.turn_taken_) {
+    sequencer->TakeTurn(slot);
+    sequencer->Unlock(slot);
+  }
+
+  sequencer->PassTurn(slot);
+  slot.sequencer_ = NULL;
+}
+
+PresentSequencer::ScopedLayerRead::ScopedLayerRead() {
+  Slot &slot = current_slot_;
+  if (!slot.sequencer_)
+    return;
+
+  slot.sequencer_->TakeTurn(slot);
+}
+
+PresentSequencer::ScopedLayerRead::~ScopedLayerRead() {
+  Slot &slot = current_slot_;
+  if (!slot.sequencer_)
+    return;
+
+  slot.sequencer_->Unlock(slot);
+  slot.sequencer_->PassTurn(slot);
+}
+
+PresentSequencer::ScopedLayerWrite::ScopedLayerWrite() {
+  Slot &slot = current_slot_;
+  if (slot.sequencer_)
+    slot.sequencer_->Lock(slot);
+}
+
+PresentSequencer::ScopedLayerWrite::~ScopedLayerWrite() {
+  Slot &slot = current_slot_;
+  if (slot.sequencer_)
+    slot.sequencer_->Unlock(slot);
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,107 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+/** \file */
+#ifndef COMMON_CORE_PRESENT_SEQUENCER_H_
+#define COMMON_CORE_PRESENT_SEQUENCER_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <spinlock.h>
+
+#include "hwcevent.h"
+
+namespace hwcomposer {
+
+/**
+ * Orders access to HwcLayers shared by displays which are presented in
+ * parallel (i.e. Mosaic). Layer constraints are queued per display and
+ * consumed while the layers are read, so reads must happen one display at
+ * a time and in the same order as a serial present would do them. Writes
+ * (release fences, validation) only need to be exclusive with reads.
+ *
+ * Each presenting thread attaches itself to a slot with ScopedSlot; the
+ * ScopedLayerRead and ScopedLayerWrite helpers are no-ops on threads
+ * which are not attached, so single display presents are not affected.
+ */
+class PresentSequencer {
+ public:
+  PresentSequencer();
+  ~PresentSequencer();
+
+  /**
+   * Prepares read turns for a new frame.
+   *
+   * @param total number of slots presented this frame.
+   * @param prologue called with the slot index at the start of each turn,
+   *        while holding the layer lock.
+   * @return false if the turn events could not be created.
+   */
+  bool BeginFrame(uint32_t total, std::function<void(uint32_t)> prologue);
+
+  class ScopedSlot {
+   public:
+    ScopedSlot(PresentSequencer *sequencer, uint32_t index);
+    ~ScopedSlot();
+
+   private:
+    ScopedSlot(const ScopedSlot &) = delete;
+    ScopedSlot &operator=(const ScopedSlot &) = delete;
+  };
+
+  class ScopedLayerRead {
+   public:
+    ScopedLayerRead();
+    ~ScopedLayerRead();
+  };
+
+  class ScopedLayerWrite {
+   public:
+    ScopedLayerWrite();
+    ~ScopedLayerWrite();
+  };
+
+ private:
+  struct Slot {
+    PresentSequencer *sequencer_ = NULL;
+    uint32_t index_ = 0;
+    bool turn_taken_ = false;
+    bool turn_passed_ = false;
+    uint32_t lock_depth_ = 0;
+  };
+
+  // Waits for the turn of |slot| if it was not taken yet. Returns with
+  // the layer lock held.
+  void TakeTurn(Slot &slot);
+  void PassTurn(Slot &slot);
+  // The layer lock is recursive per slot, writes may happen while a read
+  // section is open on the same thread.
+  void Lock(Slot &slot);
+  void Unlock(Slot &slot);
+
+  static thread_local Slot current_slot_;
+
+  std::vector<std::unique_ptr<HWCEvent>> turns_;
+  std::function<void(uint32_t)> prologue_;
+  uint32_t total_ = 0;
+  SpinLock layer_lock_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_CORE_PRESENT_SEQUENCER_H_
@@ -16,6 +16,10 @@
 
 #include "resourcemanager.h"
 
+#include <drm_fourcc.h>
+
+#include <nativebufferhandler.h>
+
 namespace hwcomposer {
 
 ResourceManager::ResourceManager(NativeBufferHandler* buffer_handler)
@@ -25,6 +29,11 @@ ResourceManager::ResourceManager(NativeBufferHandler* buffer_handler)
 }
 
 ResourceManager::~ResourceManager() {
+  for (auto& solid_color : solid_color_buffers_) {
+    buffer_handler_->ReleaseBuffer(solid_color.second);
+    buffer_handler_->DestroyHandle(solid_color.second);
+  }
+
   if (!cached_buffers_.empty()) {
     ETRACE("ResourceManager destroyed with valid native resources \n");
   }
@@ -49,6 +58,60 @@ void ResourceManager::PurgeBuffer() {
 void ResourceManager::Dump() {
 }
 
+HWCNativeHandle ResourceManager::GetSolidColorBuffer(uint32_t color,
+                                                     bool premultiplied) {
+  uint32_t red = (color >> 24) & 0xff;
+  uint32_t green = (color >> 16) & 0xff;
+  uint32_t blue = (color >> 8) & 0xff;
+  uint32_t alpha = color & 0xff;
+  if (premultiplied) {
+    red = (red * alpha) / 255;
+    green = (green * alpha) / 255;
+    blue = (blue * alpha) / 255;
+  }
+
+  uint32_t pixel = (alpha << 24) | (red << 16) | (green << 8) | blue;
+  auto it = solid_color_buffers_.find(pixel);
+  if (it != solid_color_buffers_.end())
+    return it->second;
+
+  // Buffers are never evicted, as their ids could be re-used by a new
+  // buffer while the old one is still in the OverlayBuffer cache.
+  if (solid_color_buffers_.size() >= SOLID_COLOR_BUFFER_CACHE_LENGTH)
+    return NULL;
+
+  HWCNativeHandle handle = 0;
+  if (!buffer_handler_->CreateBuffer(
+          SOLID_COLOR_BUFFER_SIZE, SOLID_COLOR_BUFFER_SIZE,
+          DRM_FORMAT_ARGB8888, &handle, kLayerNormal, NULL, -1, true)) {
+    ETRACE("Failed to create solid color buffer. \n");
+    return NULL;
+  }
+
+  uint32_t stride = 0;
+  void* map_data = NULL;
+  uint8_t* pixels = static_cast<uint8_t*>(
+      buffer_handler_->Map(handle, 0, 0, SOLID_COLOR_BUFFER_SIZE,
+                           SOLID_COLOR_BUFFER_SIZE, &stride, &map_data, 0));
+  if (!pixels) {
+    ETRACE("Failed to map solid color buffer. \n");
+    buffer_handler_->ReleaseBuffer(handle);
+    buffer_handler_->DestroyHandle(handle);
+    return NULL;
+  }
+
+  for (uint32_t y = 0; y < SOLID_COLOR_BUFFER_SIZE; y++) {
+    uint32_t* row = reinterpret_cast<uint32_t*>(pixels + y * stride);
+    for (uint32_t x = 0; x < SOLID_COLOR_BUFFER_SIZE; x++) {
+      row[x] = pixel;
+    }
+  }
+
+  buffer_handler_->UnMap(handle, map_data);
+  solid_color_buffers_.emplace(pixel, handle);
+  return handle;
+}
+
 std::shared_ptr<OverlayBuffer>& ResourceManager::FindCachedBuffer(
     const uint32_t& native_buffer) {
   BUFFER_MAP& first_map = cached_buffers_[0];
@@ -51,6 +51,9 @@ map.
 
 namespace hwcomposer {
 
+// Width and height of buffers used to scan out solid color layers.
+#define SOLID_COLOR_BUFFER_SIZE 16
+
 struct HwcLayer;
 class OverlayBuffer;
 class NativeBufferHandler;
@@ -83,8 +86,15 @@ class ResourceManager {
     return buffer_handler_;
   }
 
+  // Returns a small buffer filled with |color| (RGBA8888, as set on
+  // HwcLayer), which a plane can scale up to scan out a solid color layer.
+  // Buffers are cached per color and owned by ResourceManager. Returns
+  // NULL in case the buffer couldn't be created or the cache is full.
+  HWCNativeHandle GetSolidColorBuffer(uint32_t color, bool premultiplied);
+
  private:
 #define BUFFER_CACHE_LENGTH 4
+#define SOLID_COLOR_BUFFER_CACHE_LENGTH 8
   typedef std::unordered_map<uint32_t, std::shared_ptr<OverlayBuffer>>
       BUFFER_MAP;
   std::vector<BUFFER_MAP> cached_buffers_;
@@ -103,6 +113,9 @@ class ResourceManager {
   std::vector<ResourceHandle> destroy_gl_resources_;
   // This can be used from any thread.
   std::vector<MediaResourceHandle> destroy_media_resources_;
+  // This should be used in same thread handling
+  // Present in NativeDisplay.
+  std::unordered_map<uint32_t, HWCNativeHandle> solid_color_buffers_;
   NativeBufferHandler* buffer_handler_;
   SpinLock lock_;
 #ifdef RESOURCE_CACHE_TRACING
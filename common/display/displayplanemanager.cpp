@@ -29,6 +29,17 @@
 
 namespace hwcomposer {
 
+static bool IsDownScaled(const OverlayLayer &layer) {
+  if (layer.IsVideoLayer() || layer.IsSolidColor())
+    return false;
+
+  uint64_t source_area = static_cast<uint64_t>(layer.GetSourceCropWidth()) *
+                         layer.GetSourceCropHeight();
+  uint64_t frame_area = static_cast<uint64_t>(layer.GetDisplayFrameWidth()) *
+                        layer.GetDisplayFrameHeight();
+  return source_area > frame_area;
+}
+
 DisplayPlaneManager::DisplayPlaneManager(DisplayPlaneHandler *plane_handler,
                                          ResourceManager *resource_manager)
     : plane_handler_(plane_handler),
@@ -37,6 +48,7 @@ DisplayPlaneManager::DisplayPlaneManager(DisplayPlaneHandler *plane_handler,
       width_(0),
       height_(0),
       total_overlays_(0),
+      max_source_width_(0),
       display_transform_(kIdentity),
       release_surfaces_(false) {
 }
@@ -65,6 +77,15 @@ bool DisplayPlaneManager::Initialize(uint32_t width, uint32_t height) {
   height_ = height;
   bool status = plane_handler_->PopulatePlanes(overlay_planes_);
   ResizeOverlays();
+
+  // Strips may land on any overlay, so the narrowest one decides.
+  max_source_width_ = 0;
+  for (uint32_t i = 0; i < total_overlays_; i++) {
+    uint32_t plane_width = overlay_planes_.at(i)->GetMaxSourceWidth();
+    if (!max_source_width_ || plane_width < max_source_width_)
+      max_source_width_ = plane_width;
+  }
+
   return status;
 }
 
@@ -226,6 +247,12 @@ bool DisplayPlaneManager::ValidateLayers(
         if (fall_back && !prefer_seperate_plane && !composition.empty()) {
           force_separate =
               ForceSeparatePlane(layers, composition.back(), layer);
+          // Likely beyond the limits of the plane scaler. Pre-scale the
+          // layer into an offscreen target of its own, which is scanned out
+          // by this plane and rendered again only when the layer changes,
+          // rather than scaling it with every update of other layers.
+          if (!force_separate && j != overlay_end)
+            force_separate = IsDownScaled(*layer);
         }
 
         if (!fall_back || prefer_seperate_plane || force_separate) {
@@ -589,16 +616,23 @@ void DisplayPlaneManager::ValidateForDisplayTransform(
     if (last_plane.RevalidationType() &
         DisplayPlaneState::ReValidationType::kRotation) {
       uint32_t validation_done = DisplayPlaneState::ReValidationType::kRotation;
-      last_plane.SetRotationType(
-          DisplayPlaneState::RotationType::kDisplayRotation, false);
-      // Ensure Rotation doesn't impact the results.
-      if (FallbacktoGPU(last_plane.GetDisplayPlane(),
-                        last_plane.GetOffScreenTarget()->GetLayer(),
-                        commit_planes)) {
+      DisplayPlaneState::RotationType rotation_type =
+          DisplayPlaneState::RotationType::kGPURotation;
+      if (CanRotateOnDisplay(last_plane)) {
         last_plane.SetRotationType(
-            DisplayPlaneState::RotationType::kGPURotation, false);
+            DisplayPlaneState::RotationType::kDisplayRotation, false);
+        // Ensure Rotation doesn't impact the results.
+        if (!FallbacktoGPU(last_plane.GetDisplayPlane(),
+                           last_plane.GetOffScreenTarget()->GetLayer(),
+                           commit_planes)) {
+          rotation_type = DisplayPlaneState::RotationType::kDisplayRotation;
+        } else {
+          last_plane.SetDisplayRotationFailed();
+        }
       }
 
+      last_plane.SetRotationType(rotation_type, false);
+
       last_plane.RevalidationDone(validation_done);
     }
 
@@ -834,11 +868,75 @@ void DisplayPlaneManager::ValidateFinalLayers(
   }
 }
 
+bool DisplayPlaneManager::ValidateClonedPlanes(
+    std::vector<OverlayLayer> &layers, DisplayPlaneStateList &composition,
+    DisplayPlaneStateList &previous_composition,
+    std::vector<NativeSurface *> &mark_later) {
+  CTRACE();
+  if (layers.empty() || layers.size() > overlay_planes_.size() ||
+      display_transform_ != kIdentity) {
+    return false;
+  }
+
+  std::vector<OverlayPlane> commit_planes;
+  size_t total_layers = layers.size();
+  for (size_t lindex = 0; lindex < total_layers; lindex++) {
+    OverlayLayer *layer = &(layers.at(lindex));
+    DisplayPlane *plane = overlay_planes_.at(lindex).get();
+    // Cursor can only go to cursor plane, which is the last one.
+    if (layer->IsCursorLayer() && cursor_plane_) {
+      plane = cursor_plane_;
+    } else if (plane == cursor_plane_) {
+      return false;
+    }
+
+    if ((layer->IsSolidColor() && !layer->GetBuffer()) ||
+        !plane->ValidateLayer(layer)) {
+      return false;
+    }
+
+    OverlayBuffer *layer_buffer = layer->GetBuffer();
+    if (!layer_buffer || layer_buffer->GetFb() == 0) {
+      return false;
+    }
+
+    commit_planes.emplace_back(OverlayPlane(plane, layer));
+  }
+
+  // Scaling between source and clone resolution is left to the plane
+  // scalers, let the kernel tell us if this configuration is possible.
+  if (!plane_handler_->TestCommit(commit_planes)) {
+    ISURFACETRACE("Zero copy clone rejected by TestCommit. \n");
+    return false;
+  }
+
+  for (DisplayPlaneState &plane : previous_composition) {
+    MarkSurfacesForRecycling(&plane, mark_later, true);
+  }
+
+  for (auto j = overlay_planes_.begin(); j != overlay_planes_.end(); ++j) {
+    j->get()->SetInUse(false);
+  }
+
+  DisplayPlaneStateList().swap(composition);
+  for (const OverlayPlane &commit_plane : commit_planes) {
+    OverlayLayer *layer = const_cast<OverlayLayer *>(commit_plane.layer);
+    composition.emplace_back(commit_plane.plane, layer, this,
+                             layer->GetZorder(), display_transform_);
+    if (layer->IsVideoLayer())
+      composition.back().SetVideoPlane(true);
+
+    layer->SupportedDisplayComposition(OverlayLayer::kAll);
+  }
+
+  return true;
+}
+
 bool DisplayPlaneManager::FallbacktoGPU(
     DisplayPlane *target_plane, OverlayLayer *layer,
     const std::vector<OverlayPlane> &commit_planes) const {
-  // SolidColor can't be scanout directly
-  if (layer->IsSolidColor())
+  // SolidColor can be scanned out only when backed by a color buffer.
+  if (layer->IsSolidColor() && !layer->GetBuffer())
     return true;
   // For Video, we always want to support Display Composition.
   if (layer->IsVideoLayer()) {
@@ -868,6 +966,50 @@ bool DisplayPlaneManager::FallbacktoGPU(
   return false;
 }
 
+bool DisplayPlaneManager::CanRotateOnDisplay(
+    const DisplayPlaneState &plane) const {
+  uint32_t transform = plane.GetPlaneTransform();
+  if (transform == kIdentity)
+    return true;
+
+  // A test commit already failed for this plane and target, it would
+  // fail again. Trying also costs a full redraw of the plane.
+  if (plane.DisplayRotationFailed())
+    return false;
+
+  NativeSurface *surface = plane.GetOffScreenTarget();
+  if (!surface)
+    return false;
+
+  // Anything the plane can't scan out rotated fails test commit, so
+  // don't spend an ioctl on it.
+  DrmPlane *drmplane = (DrmPlane *)(plane.GetDisplayPlane());
+  return drmplane->CanRotate(transform,
+                             surface->GetLayer()->GetBuffer()->GetFormat(),
+                             surface->GetModifier());
+}
+
+uint32_t DisplayPlaneManager::GetStripCount(const OverlayLayer &layer) const {
+  uint32_t source_width = layer.GetSourceCropWidth();
+  if (!max_source_width_ || source_width <= max_source_width_)
+    return 1;
+
+  // Strips are placed side by side, which only works without transforms.
+  if (layer.GetMergedTransform() != kIdentity || layer.IsCursorLayer() ||
+      !layer.GetBuffer()) {
+    return 1;
+  }
+
+  uint32_t strip_count =
+      (source_width + max_source_width_ - 1) / max_source_width_;
+  if (strip_count > overlay_planes_.size() ||
+      layer.GetDisplayFrameWidth() < strip_count) {
+    return 1;
+  }
+
+  return strip_count;
+}
+
 bool DisplayPlaneManager::CheckPlaneFormat(uint32_t format) {
   return overlay_planes_.at(0)->IsSupportedFormat(format);
 }
@@ -1074,11 +1216,12 @@ bool DisplayPlaneManager::ReValidatePlanes(
 
     uint32_t validation_done = DisplayPlaneState::ReValidationType::kScanout;
     if (revalidation_type & DisplayPlaneState::ReValidationType::kScanout) {
-      const std::vector<size_t> &source_layers = last_plane.GetSourceLayers();
+      // Copied as the plane state is detached once modified below.
+      size_t source_layer = last_plane.GetSourceLayers().at(0);
       bool uses_scalar = last_plane.IsUsingPlaneScalar();
       // Store current layer to re-set in case commit fails.
       const OverlayLayer *current_layer = last_plane.GetOverlayLayer();
-      OverlayLayer *layer = &(layers.at(source_layers.at(0)));
+      OverlayLayer *layer = &(layers.at(source_layer));
       last_plane.SetOverlayLayer(layer);
       // Disable GPU Rendering.
       last_plane.DisableGPURendering();
@@ -1117,11 +1260,8 @@ bool DisplayPlaneManager::ReValidatePlanes(
       validation_done |= DisplayPlaneState::ReValidationType::kRotation;
       // Save old rotation type.
       DisplayPlaneState::RotationType old_type = last_plane.GetRotationType();
-      DisplayPlaneState::RotationType new_type = old_type;
-      if (old_type == DisplayPlaneState::RotationType::kGPURotation) {
-        last_plane.SetRotationType(
-            DisplayPlaneState::RotationType::kDisplayRotation, false);
-      } else if (re_validate_commit) {
+      if (old_type == DisplayPlaneState::RotationType::kDisplayRotation &&
+          re_validate_commit) {
         // We should have already done a full commit check above.
         // As their is no state change we can avoid another test
         // commit here.
@@ -1129,17 +1269,29 @@ bool DisplayPlaneManager::ReValidatePlanes(
         continue;
       }
 
-      // Check if we can rotate using Display plane.
+      // Check if we can rotate using Display plane. When we can't, keep
+      // the plane untouched so that its GPU rotated surfaces are reused.
       EnsureOffScreenTarget(last_plane);
-      if (FallbacktoGPU(last_plane.GetDisplayPlane(),
-                        last_plane.GetOffScreenTarget()->GetLayer(),
-                        commit_planes)) {
-        new_type = DisplayPlaneState::RotationType::kGPURotation;
+      DisplayPlaneState::RotationType new_type =
+          DisplayPlaneState::RotationType::kGPURotation;
+      if (CanRotateOnDisplay(last_plane)) {
+        last_plane.SetRotationType(
+            DisplayPlaneState::RotationType::kDisplayRotation, false);
+        if (!FallbacktoGPU(last_plane.GetDisplayPlane(),
+                           last_plane.GetOffScreenTarget()->GetLayer(),
+                           commit_planes)) {
+          new_type = DisplayPlaneState::RotationType::kDisplayRotation;
+        } else {
+          last_plane.SetDisplayRotationFailed();
+        }
       }
 
       if (old_type != new_type) {
         // Set new rotation type. Clear surfaces in case type has changed.
         last_plane.SetRotationType(new_type, true);
+      } else if (last_plane.GetRotationType() != new_type) {
+        // Display rotation failed the test commit, restore GPU rotation.
+        last_plane.SetRotationType(new_type, false);
       }
     }
 
@@ -1284,13 +1436,14 @@ bool DisplayPlaneManager::SquashPlanesAsNeeded(
                     last_plane.GetDisplayFrame().right,
                     last_plane.GetDisplayFrame().bottom);
     }
-    const HwcRect<int> &display_frame = scanout_plane.GetDisplayFrame();
-    const HwcRect<int> &target_frame = last_plane.GetDisplayFrame();
+    // Copied as AddLayer below detaches the plane state.
+    HwcRect<int> display_frame = scanout_plane.GetDisplayFrame();
+    HwcRect<int> target_frame = last_plane.GetDisplayFrame();
     if (!scanout_plane.IsCursorPlane() && !scanout_plane.IsVideoPlane() &&
         (AnalyseOverlap(display_frame, target_frame) != kOutside)) {
       if (!ForceSeparatePlane(layers, last_plane, NULL)) {
         ISURFACETRACE("Squasing planes. \n");
-        const std::vector<size_t> &new_layers = last_plane.GetSourceLayers();
+        std::vector<size_t> new_layers = last_plane.GetSourceLayers();
         for (const size_t &index : new_layers) {
           scanout_plane.AddLayer(&(layers.at(index)));
         }
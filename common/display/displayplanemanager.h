@@ -50,6 +50,15 @@ class DisplayPlaneManager {
                       DisplayPlaneStateList &previous_composition,
                       std::vector<NativeSurface *> &mark_later);
 
+  // Maps every layer directly to its own plane, in order, without any
+  // offscreen composition. Used by cloned displays whose layers are the
+  // already composited planes of the source display. Returns false, leaving
+  // composition untouched, if the planes can't scan out the layers as is.
+  bool ValidateClonedPlanes(std::vector<OverlayLayer> &layers,
+                            DisplayPlaneStateList &composition,
+                            DisplayPlaneStateList &previous_composition,
+                            std::vector<NativeSurface *> &mark_later);
+
   void MarkSurfacesForRecycling(DisplayPlaneState *plane,
                                 std::vector<NativeSurface *> &mark_later,
                                 bool recycle_resources,
@@ -70,6 +79,11 @@ class DisplayPlaneManager {
 
   bool CheckPlaneFormat(uint32_t format);
 
+  // Returns the number of vertical strips |layer| needs to be split into,
+  // so that each of them is narrow enough to be scanned out by a plane.
+  // Returns 1 if layer doesn't need to be, or cannot be, split.
+  uint32_t GetStripCount(const OverlayLayer &layer) const;
+
   void SetOffScreenPlaneTarget(DisplayPlaneState &plane);
 
   void ReleaseFreeOffScreenTargets(bool forced = false);
@@ -129,6 +143,11 @@ class DisplayPlaneManager {
   bool FallbacktoGPU(DisplayPlane *target_plane, OverlayLayer *layer,
                      const std::vector<OverlayPlane> &commit_planes) const;
 
+  // Cheap check done before a test commit, returns false if display
+  // rotation of plane's offscreen target cannot work for the plane's
+  // transform and GPU rotation needs to be used.
+  bool CanRotateOnDisplay(const DisplayPlaneState &plane) const;
+
   void ValidateFinalLayers(std::vector<OverlayPlane> &commit_planes,
                            DisplayPlaneStateList &list,
                            std::vector<OverlayLayer> &layers,
@@ -197,6 +216,9 @@ class DisplayPlaneManager {
   uint32_t width_;
   uint32_t height_;
   uint32_t total_overlays_;
+  // Widest source crop every overlay plane can scan out, wider layers
+  // are split into strips.
+  uint32_t max_source_width_;
   uint32_t display_transform_;
   bool release_surfaces_;
 };
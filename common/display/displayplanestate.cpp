@@ -20,10 +20,11 @@
 #include "hwcutils.h"
 
 #include <math.h>
+#include <algorithm>
 
 namespace hwcomposer {
 
-DisplayPlaneState::DisplayPlanePrivateState::~DisplayPlanePrivateState() {
+DisplayPlaneState::SurfaceOwner::~SurfaceOwner() {
   bool surfaces_deleted = false;
   for (NativeSurface *surface : surfaces_) {
     if (!surface->IsOnScreen()) {
@@ -61,7 +62,8 @@ DisplayPlaneState::DisplayPlaneState(DisplayPlane *plane, OverlayLayer *layer,
     private_data_->rotation_type_ = RotationType::kDisplayRotation;
   }
 
-  private_data_->plane_manager_ = plane_manager;
+  private_data_->surface_owner_ = std::make_shared<SurfaceOwner>();
+  private_data_->surface_owner_->plane_manager_ = plane_manager;
 
   recycled_surface_ = false;
 }
@@ -75,6 +77,17 @@ void DisplayPlaneState::CopyState(DisplayPlaneState &state) {
   // should be determined in DisplayQueue for every frame.
 }
 
+void DisplayPlaneState::DetachState() {
+  if (private_data_.use_count() == 1) {
+    return;
+  }
+
+  private_data_ = std::make_shared<DisplayPlanePrivateState>(*private_data_);
+  private_data_->version_++;
+  ISURFACETRACE("Plane state detached, version: %d \n",
+                private_data_->version_);
+}
+
 const HwcRect<int> &DisplayPlaneState::GetDisplayFrame() const {
   return private_data_->display_frame_;
 }
@@ -84,6 +97,7 @@ const HwcRect<float> &DisplayPlaneState::GetSourceCrop() const {
 }
 
 void DisplayPlaneState::AddLayer(const OverlayLayer *layer) {
+  DetachState();
   const HwcRect<int> &display_frame = layer->GetDisplayFrame();
   HwcRect<int> target_display_frame = private_data_->display_frame_;
   CalculateRect(display_frame, target_display_frame);
@@ -138,6 +152,7 @@ void DisplayPlaneState::AddLayer(const OverlayLayer *layer) {
 
 void DisplayPlaneState::ResetLayers(const std::vector<OverlayLayer> &layers,
                                     size_t remove_index, bool *rects_updated) {
+  DetachState();
   std::vector<size_t> current_layers = private_data_->source_layers_;
   std::vector<size_t>().swap(private_data_->source_layers_);
   std::vector<size_t> &new_layers = private_data_->source_layers_;
@@ -233,6 +248,7 @@ void DisplayPlaneState::ResetLayers(const std::vector<OverlayLayer> &layers,
 
 void DisplayPlaneState::RefreshLayerRects(
     const std::vector<OverlayLayer> &layers) {
+  DetachState();
   const std::vector<size_t> &current_layers = private_data_->source_layers_;
   HwcRect<int> target_display_frame;
   HwcRect<float> target_source_crop;
@@ -284,16 +300,19 @@ void DisplayPlaneState::RefreshLayerRects(
 }
 
 void DisplayPlaneState::ForceGPURendering() {
+  DetachState();
   private_data_->state_ = DisplayPlanePrivateState::State::kRender;
   recycled_surface_ = false;
 }
 
 void DisplayPlaneState::DisableGPURendering() {
+  DetachState();
   private_data_->state_ = DisplayPlanePrivateState::State::kScanout;
   recycled_surface_ = false;
 }
 
 void DisplayPlaneState::SetOverlayLayer(const OverlayLayer *layer) {
+  DetachState();
   private_data_->layer_ = layer;
   bool update_rect = true;
   if ((private_data_->display_frame_ == layer->GetDisplayFrame()) &&
@@ -315,13 +334,16 @@ const OverlayLayer *DisplayPlaneState::GetOverlayLayer() const {
 }
 
 void DisplayPlaneState::SetOffScreenTarget(NativeSurface *target) {
+  DetachState();
   private_data_->layer_ = target->GetLayer();
   uint32_t rotation = private_data_->plane_transform_;
   if (private_data_->rotation_type_ != RotationType::kDisplayRotation)
     rotation = kIdentity;
 
   target->SetTransform(rotation);
+  private_data_->display_rotation_failed_ = false;
   private_data_->surfaces_.emplace(private_data_->surfaces_.begin(), target);
+  private_data_->surface_owner_->surfaces_ = private_data_->surfaces_;
   recycled_surface_ = false;
   surface_swapped_ = true;
   private_data_->refresh_surface_ = true;
@@ -346,6 +368,7 @@ void DisplayPlaneState::SwapSurfaceIfNeeded() {
   if (size == 0)
     return;
 
+  DetachState();
   if (size == 3) {
     std::vector<NativeSurface *> temp;
     temp.reserve(size);
@@ -363,29 +386,35 @@ void DisplayPlaneState::SwapSurfaceIfNeeded() {
 }
 
 void DisplayPlaneState::HandleCommitFailure() {
-  size_t size = private_data_->surfaces_.size();
-  if (size == 0)
-    return;
-
-  if (surface_swapped_) {
-    if (size == 3) {
-      std::vector<NativeSurface *> temp;
-      temp.reserve(size);
-      // Lets make sure we restore the buffer queue.
-      temp.emplace_back(private_data_->surfaces_.at(1));
-      temp.emplace_back(private_data_->surfaces_.at(2));
-      temp.emplace_back(private_data_->surfaces_.at(0));
-      private_data_->surfaces_.swap(temp);
+  ISURFACETRACE("Rolling back plane state to version: %d \n",
+                private_data_->version_);
+  // Surface order and layer are still the ones of the last committed
+  // frame, the failed one worked on its own copy. Surfaces it allocated
+  // for this plane are not part of it anymore.
+  SurfaceOwner *owner = private_data_->surface_owner_.get();
+  const std::vector<NativeSurface *> &surfaces = private_data_->surfaces_;
+  bool surfaces_released = false;
+  for (NativeSurface *surface : owner->surfaces_) {
+    if (std::find(surfaces.begin(), surfaces.end(), surface) ==
+            surfaces.end() &&
+        !surface->IsOnScreen()) {
+      surface->SetSurfaceAge(-1);
+      surfaces_released = true;
     }
-
-    NativeSurface *surface = private_data_->surfaces_.at(0);
-    private_data_->layer_ = surface->GetLayer();
   }
 
+  if (surfaces_released)
+    owner->plane_manager_->ReleasedSurfaces();
+
+  owner->surfaces_ = surfaces;
+  size_t size = surfaces.size();
   for (uint32_t i = 0; i < size; i++) {
     NativeSurface *surface = private_data_->surfaces_.at(i);
     surface->SetSurfaceAge(2 - i);
-    surface->SetClearSurface(NativeSurface::kFullClear);
+    // Front buffer is still on screen, rest might have been rendered
+    // to by the failed frame.
+    if (i > 0)
+      surface->SetClearSurface(NativeSurface::kFullClear);
   }
 }
 
@@ -395,7 +424,9 @@ const std::vector<NativeSurface *> &DisplayPlaneState::GetSurfaces() const {
 
 void DisplayPlaneState::ReleaseSurfaces() {
   if (!private_data_->surfaces_.empty()) {
+    DetachState();
     std::vector<NativeSurface *>().swap(private_data_->surfaces_);
+    private_data_->surface_owner_->surfaces_.clear();
     private_data_->layer_ = NULL;
   }
 
@@ -409,6 +440,8 @@ void DisplayPlaneState::RefreshSurfaces(NativeSurface::ClearType clear_surface,
     return;
   }
 
+  DetachState();
+
   const HwcRect<int> &target_display_frame = private_data_->display_frame_;
   HwcRect<float> scaled_rect;
   CalculateSourceCrop(scaled_rect);
@@ -453,6 +486,10 @@ DisplayPlane *DisplayPlaneState::GetDisplayPlane() const {
 }
 
 void DisplayPlaneState::SetDisplayPlane(DisplayPlane *plane) {
+  DetachState();
+  if (private_data_->plane_ != plane)
+    private_data_->display_rotation_failed_ = false;
+
   private_data_->plane_ = plane;
   plane->SetInUse(true);
 }
@@ -462,12 +499,15 @@ const std::vector<size_t> &DisplayPlaneState::GetSourceLayers() const {
 }
 
 std::vector<CompositionRegion> &DisplayPlaneState::GetCompositionRegion() {
+  DetachState();
   return private_data_->composition_region_;
 }
 
 void DisplayPlaneState::ResetCompositionRegion() {
-  if (!private_data_->composition_region_.empty())
+  if (!private_data_->composition_region_.empty()) {
+    DetachState();
     std::vector<CompositionRegion>().swap(private_data_->composition_region_);
+  }
 
   recycled_surface_ = false;
 }
@@ -486,6 +526,7 @@ bool DisplayPlaneState::IsVideoPlane() const {
 
 void DisplayPlaneState::SetVideoPlane(bool enable_video) {
 #ifndef DISABLE_VA
+  DetachState();
   if (enable_video) {
     private_data_->type_ = DisplayPlanePrivateState::PlaneType::kVideo;
     private_data_->supports_video_ = true;
@@ -497,6 +538,7 @@ void DisplayPlaneState::SetVideoPlane(bool enable_video) {
 
 void DisplayPlaneState::UsePlaneScalar(bool enable, bool force_refresh) {
   if (private_data_->use_plane_scalar_ != enable) {
+    DetachState();
     private_data_->use_plane_scalar_ = enable;
     if (force_refresh) {
       RefreshSurfaces(NativeSurface::kFullClear, true);
@@ -523,6 +565,7 @@ bool DisplayPlaneState::IsUsingPlaneScalar() const {
 
 void DisplayPlaneState::SetApplyEffects(bool apply_effects) {
   if (private_data_->apply_effects_ != apply_effects) {
+    DetachState();
     private_data_->apply_effects_ = apply_effects;
     // Doesn't have any impact on planes which
     // are not meant for video.
@@ -604,9 +647,12 @@ void DisplayPlaneState::ValidateReValidation() {
   if (!private_data_->rect_updated_)
     return;
 
+  DetachState();
   if (private_data_->plane_transform_ != kIdentity &&
       !private_data_->unsupported_display_rotation_) {
     re_validate_layer_ |= ReValidationType::kRotation;
+    // New geometry might be fine for display rotation.
+    private_data_->display_rotation_failed_ = false;
   }
 
   if (private_data_->source_layers_.size() == 1 &&
@@ -762,6 +808,7 @@ bool DisplayPlaneState::CanUseGPUDownScaling() const {
 
 void DisplayPlaneState::SetRotationType(RotationType type, bool refresh) {
   if (private_data_->rotation_type_ != type) {
+    DetachState();
     private_data_->rotation_type_ = type;
     if (refresh) {
       RefreshSurfaces(NativeSurface::kFullClear, true);
@@ -779,6 +826,13 @@ void DisplayPlaneState::SetRotationType(RotationType type, bool refresh) {
   }
 }
 
+void DisplayPlaneState::SetDisplayRotationFailed() {
+  if (!private_data_->display_rotation_failed_) {
+    DetachState();
+    private_data_->display_rotation_failed_ = true;
+  }
+}
+
 DisplayPlaneState::RotationType DisplayPlaneState::GetRotationType() const {
   return private_data_->rotation_type_;
 }
@@ -793,6 +847,7 @@ void DisplayPlaneState::SetDisplayDownScalingFactor(uint32_t factor,
   if (private_data_->down_scaling_factor_ == factor)
     return;
 
+  DetachState();
   private_data_->down_scaling_factor_ = factor;
   NativeSurface::ClearType type = NativeSurface::kNone;
 
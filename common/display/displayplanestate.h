@@ -57,9 +57,24 @@ class DisplayPlaneState {
                     DisplayPlaneManager *plane_manager, uint32_t index,
                     uint32_t plane_transform);
 
-  // Copies plane state from state.
+  // Copies plane state from state. The state is shared until either
+  // of them is modified, at which point the modified one gets its own
+  // copy. This keeps the state of the last committed frame intact while
+  // the next one is being validated.
   void CopyState(DisplayPlaneState &state);
 
+  // Returns true if this plane state was modified after being copied
+  // from state, or was never copied from it.
+  bool HasChangedSince(const DisplayPlaneState &state) const {
+    return private_data_ != state.private_data_;
+  }
+
+  // Number of modifications done to this plane state since it was
+  // created, across all copies.
+  uint32_t GetVersion() const {
+    return private_data_->version_;
+  }
+
   void AddLayer(const OverlayLayer *layer);
 
   // This API should be called only when source_layers being
@@ -204,6 +219,20 @@ class DisplayPlaneState {
   // plane is not rotated.
   RotationType GetRotationType() const;
 
+  // Transform the content of this plane needs to be shown with.
+  uint32_t GetPlaneTransform() const {
+    return private_data_->plane_transform_;
+  }
+
+  // Called when a test commit with display rotation failed for this
+  // plane. Remembered until the plane, its offscreen target or its
+  // geometry changes.
+  void SetDisplayRotationFailed();
+
+  bool DisplayRotationFailed() const {
+    return private_data_->display_rotation_failed_;
+  }
+
   void SetDisplayDownScalingFactor(uint32_t factor, bool clear_surfaces);
 
   uint32_t GetDownScalingFactor() const;
@@ -218,7 +247,10 @@ class DisplayPlaneState {
   // list if not already done.
   void SwapSurfaceIfNeeded();
 
-  // Reset's surface age and surface order as previous frame.
+  // Called on the state of the last committed frame when committing the
+  // next one failed and that frame modified this plane. Releases surfaces
+  // only the failed frame used and resets age of the shared ones, the
+  // state itself was not modified by it.
   void HandleCommitFailure();
 
   // Returns true if OffscreenSurface is recycled.
@@ -237,6 +269,20 @@ class DisplayPlaneState {
  private:
   void CalculateSourceCrop(HwcRect<float> &source_crop) const;
 
+  // Gives this plane state its own copy of private_data_ if it is
+  // shared with another one. Needs to be called before modifying it.
+  void DetachState();
+
+  // Offscreen surfaces are shared by all copies of a plane state and
+  // released once the last of them is destroyed.
+  struct SurfaceOwner {
+    ~SurfaceOwner();
+
+    // Surfaces of the most recently modified copy.
+    std::vector<NativeSurface *> surfaces_;
+    DisplayPlaneManager *plane_manager_ = NULL;
+  };
+
   class DisplayPlanePrivateState {
    public:
     enum class PlaneType : int32_t {
@@ -251,8 +297,6 @@ class DisplayPlaneState {
                  // layer before scanning out.
     };
 
-    ~DisplayPlanePrivateState();
-
     State state_ = State::kScanout;
     DisplayPlane *plane_ = NULL;
     const OverlayLayer *layer_ = NULL;
@@ -285,6 +329,9 @@ class DisplayPlaneState {
 
     // Display cannot support the required rotation.
     bool unsupported_display_rotation_ = false;
+    // Test commit with display rotation failed for the current plane,
+    // offscreen target and geometry.
+    bool display_rotation_failed_ = false;
     uint32_t down_scaling_factor_ = 1;
     // Any offscreen surfaces used by this
     // plane.
@@ -292,7 +339,8 @@ class DisplayPlaneState {
     PlaneType type_ = PlaneType::kNormal;
     uint32_t plane_transform_ = kIdentity;
     RotationType rotation_type_ = RotationType::kDisplayRotation;
-    DisplayPlaneManager *plane_manager_ = NULL;
+    uint32_t version_ = 0;
+    std::shared_ptr<SurfaceOwner> surface_owner_;
   };
 
   bool recycled_surface_ = true;
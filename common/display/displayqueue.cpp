@@ -20,13 +20,18 @@
 #include <hwclayer.h>
 #include <math.h>
 #include <sys/time.h>
+#include <algorithm>
+#include <unordered_map>
 #include <vector>
 
 #include "displayplanemanager.h"
+#include "gpudevice.h"
+#include "hwcfence.h"
 #include "hwctrace.h"
 #include "hwcutils.h"
 #include "nativesurface.h"
 #include "overlaylayer.h"
+#include "presentsequencer.h"
 #include "vblankeventhandler.h"
 
 #include "physicaldisplay.h"
@@ -103,15 +108,28 @@ bool DisplayQueue::SetPowerMode(uint32_t power_mode) {
       vblank_handler_->SetPowerMode(kDozeSuspend);
       state_ |= kPoweredOn;
       break;
-    case kOn:
+    case kOn: {
+      GpuDevice &device = GpuDevice::getInstance();
       state_ |= kPoweredOn | kConfigurationChanged | kNeedsColorCorrection |
                 kCanvasColorChanged;
       vblank_handler_->SetPowerMode(kOn);
+      idle_tracker_.idle_lock_.lock();
+      idle_tracker_.idle_timeout_ns_ =
+          static_cast<uint64_t>(device.GetIdleTimeout()) * 1000000;
+      idle_tracker_.idle_exit_ns_ =
+          static_cast<uint64_t>(device.GetIdleExitTime()) * 1000000;
+      idle_tracker_.last_frame_ns_ = 0;
+      idle_tracker_.idle_lock_.unlock();
+      deadline_tracker_.deadline_lock_.lock();
+      if (!deadline_tracker_.configured_)
+        deadline_tracker_.enabled_ = device.IsLateCompositionEnabled();
+      deadline_tracker_.deadline_lock_.unlock();
       power_mode_lock_.lock();
       state_ &= ~kIgnoreIdleRefresh;
       compositor_.Init(resource_manager_.get(), gpu_fd_);
       power_mode_lock_.unlock();
       break;
+    }
     default:
       break;
   }
@@ -215,7 +233,9 @@ void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
           last_plane.ResetLayers(layers, threshold, &needs_plane_validation);
         }
 
-        source_layers_size = source_layers.size();
+        // ResetLayers detaches the plane state, so source_layers still
+        // refers to the list of the previous frame.
+        source_layers_size = last_plane.GetSourceLayers().size();
         ISURFACETRACE(
             "Layers removed. Total old Layers: %d Total new Layers: %d "
             "Threshold: "
@@ -420,7 +440,7 @@ void DisplayQueue::GetCachedLayers(const std::vector<OverlayLayer>& layers,
       const OverlayLayer* layer =
           &(layers.at(last_plane.GetSourceLayers().front()));
 
-      if (layer->IsSolidColor()) {
+      if (layer->IsSolidColor() && !layer->GetBuffer()) {
         *force_full_validation = true;
         *can_ignore_commit = false;
         return;
@@ -530,12 +550,29 @@ void DisplayQueue::InitializeOverlayLayers(
   size_t previous_size = in_flight_layers_.size();
   uint32_t z_order = 0;
 
+  // Layers of the previous frame by client layer, so that the state of
+  // layers whose contents changed only can be carried over. Strips share
+  // their client layer, the first one is kept.
+  std::unordered_map<const HwcLayer*, const OverlayLayer*> cached_layers;
+  bool reuse_layers =
+      !validate_layers && !handle_constraints &&
+      (scaling_tracker_.scaling_state_ != ScalingTracker::kNeedsScaling);
+  if (reuse_layers) {
+    for (const OverlayLayer& in_flight_layer : in_flight_layers_) {
+      cached_layers.emplace(in_flight_layer.GetSourceLayer(),
+                            &in_flight_layer);
+    }
+  }
+
   for (size_t layer_index = 0; layer_index < size; layer_index++) {
     HwcLayer* layer = source_layers.at(layer_index);
     layer->SetReleaseFence(-1);
     if (!layer->IsVisible())
       continue;
 
+    if (static_cast<int>(layer_index) == solid_background_index_)
+      continue;
+
     // Discard protected video for tear down
     if (state_ & kVideoDiscardProtected) {
       if (layer->GetNativeHandle() != NULL &&
@@ -552,7 +589,26 @@ void DisplayQueue::InitializeOverlayLayers(
       add_index = z_order;
     }
 
-    if (scaling_tracker_.scaling_state_ == ScalingTracker::kNeedsScaling) {
+    const OverlayLayer* cached_layer = NULL;
+    uint32_t dirty = OverlayLayer::kDirtyAll;
+    if (reuse_layers) {
+      auto cached = cached_layers.find(layer);
+      if (cached != cached_layers.end()) {
+        cached_layer = cached->second;
+        dirty = OverlayLayer::GetDirtyState(layer, *cached_layer, z_order,
+                                            plane_transform_);
+      }
+    }
+
+    if (!(dirty & ~OverlayLayer::kDirtyContent)) {
+      // Only the contents changed, geometry and transforms computed for
+      // the previous frame still hold.
+      overlay_layer->InitializeFromPreviousFrame(
+          layer, resource_manager_.get(), *cached_layer, previous_layer,
+          z_order, layer_index, display_plane_manager_->GetHeight(),
+          display_plane_manager_->GetWidth());
+    } else if (scaling_tracker_.scaling_state_ ==
+               ScalingTracker::kNeedsScaling) {
       HwcRect<int> display_frame = layer->GetDisplayFrame();
       display_frame.left =
           display_frame.left +
@@ -584,6 +640,34 @@ void DisplayQueue::InitializeOverlayLayers(
       continue;
     }
 
+    // Layers too wide for a plane are split into strips at consecutive
+    // z orders, which plane validation treats like any other layer.
+    uint32_t strip_count =
+        display_plane_manager_->GetStripCount(*overlay_layer);
+    if (strip_count > 1) {
+      size_t first_strip = layers.size() - 1;
+      for (uint32_t strip = 1; strip < strip_count; strip++) {
+        uint32_t strip_z_order = z_order + strip;
+        OverlayLayer* previous_strip = NULL;
+        if (previous_size > strip_z_order) {
+          previous_strip = &(in_flight_layers_.at(strip_z_order));
+        } else if (add_index == -1) {
+          add_index = strip_z_order;
+        }
+
+        layers.emplace_back();
+        OverlayLayer& strip_layer = layers.back();
+        strip_layer.InitializeAsStrip(layers.at(first_strip), strip_z_order,
+                                      strip, strip_count, previous_strip);
+        if (strip_layer.NeedsRevalidation())
+          re_validate_commit = true;
+      }
+
+      overlay_layer = &(layers.at(first_strip));
+      overlay_layer->CropToStrip(0, strip_count, previous_layer);
+      z_order += strip_count - 1;
+    }
+
     if (overlay_layer->IsVideoLayer()) {
       has_video_layer = true;
     }
@@ -641,6 +725,248 @@ void DisplayQueue::InitializeOverlayLayers(
   }
 }
 
+int DisplayQueue::GetSolidBackgroundLayer(
+    std::vector<HwcLayer*>& source_layers) {
+  if (clone_mode_ || display_->HasClones() ||
+      !display_->SupportsPipeCanvasColor() || plane_transform_ != kIdentity ||
+      scaling_tracker_.scaling_state_ == ScalingTracker::kNeedsScaling) {
+    return -1;
+  }
+
+  int width = display_plane_manager_->GetWidth();
+  int height = display_plane_manager_->GetHeight();
+  size_t size = source_layers.size();
+  for (size_t layer_index = 0; layer_index < size; layer_index++) {
+    HwcLayer* layer = source_layers.at(layer_index);
+    if (!layer->IsVisible())
+      continue;
+
+    if ((Composition_SolidColor != layer->GetLayerCompositionType()) ||
+        layer->GetNativeHandle() || (layer->GetAlpha() != 0xff) ||
+        ((layer->GetSolidColor() & 0xff) != 0xff)) {
+      return -1;
+    }
+
+    const HwcRect<int>& frame = layer->GetDisplayFrame();
+    if ((frame.left > 0) || (frame.top > 0) || (frame.right < width) ||
+        (frame.bottom < height)) {
+      return -1;
+    }
+
+    // Keep at least one layer on the planes.
+    for (size_t next = layer_index + 1; next < size; next++) {
+      if (source_layers.at(next)->IsVisible())
+        return layer_index;
+    }
+
+    return -1;
+  }
+
+  return -1;
+}
+
+bool DisplayQueue::IsRedundantFrame(std::vector<HwcLayer*>& source_layers) {
+  if (clone_mode_ || IsIgnoreUpdates() ||
+      (state_ & (kConfigurationChanged | kNeedsColorCorrection |
+                 kCanvasColorChanged | kVideoDiscardProtected))) {
+    return false;
+  }
+
+  video_lock_.lock();
+  bool video_effects = video_effect_changed_;
+  video_lock_.unlock();
+  if (video_effects)
+    return false;
+
+  if (GetSolidBackgroundLayer(source_layers) != solid_background_index_)
+    return false;
+
+  size_t size = source_layers.size();
+  size_t previous_size = in_flight_layers_.size();
+  size_t z_order = 0;
+  for (size_t layer_index = 0; layer_index < size; layer_index++) {
+    HwcLayer* layer = source_layers.at(layer_index);
+    if (!layer->IsVisible())
+      continue;
+
+    if (static_cast<int>(layer_index) == solid_background_index_) {
+      if (layer->GetSolidColor() != solid_background_color_)
+        return false;
+
+      continue;
+    }
+
+    if (z_order >= previous_size)
+      return false;
+
+    // Transform changes are tracked as attribute changes, alpha and
+    // blending only as rendering damage so compare them directly.
+    OverlayLayer& previous_layer = in_flight_layers_.at(z_order++);
+    if ((previous_layer.GetLayerIndex() != layer_index) ||
+        layer->HasZorderChanged() || layer->HasSourceRectChanged() ||
+        layer->HasDisplayRectChanged() || layer->HasLayerAttributesChanged() ||
+        layer->HasVisibleRegionChanged() || layer->HasLayerContentChanged() ||
+        (previous_layer.GetAlpha() != layer->GetAlpha()) ||
+        (previous_layer.GetBlending() != layer->GetBlending()) ||
+        (previous_layer.GetDataSpace() != layer->GetDataSpace())) {
+      return false;
+    }
+
+    if (Composition_SolidColor == layer->GetLayerCompositionType()) {
+      if (layer->GetSolidColor() != previous_layer.GetSolidColor())
+        return false;
+    } else {
+      OverlayBuffer* buffer = previous_layer.GetBuffer();
+      if (!buffer || (buffer->GetOriginalHandle() != layer->GetNativeHandle()))
+        return false;
+    }
+  }
+
+  return z_order == previous_size;
+}
+
+bool DisplayQueue::UpdateCursorPlane(std::vector<HwcLayer*>& source_layers,
+                                     int32_t* retire_fence) {
+  if (clone_mode_ || display_->HasClones() || IsIgnoreUpdates() ||
+      (plane_transform_ != kIdentity) ||
+      (scaling_tracker_.scaling_state_ == ScalingTracker::kNeedsScaling) ||
+      (state_ & (kConfigurationChanged | kNeedsColorCorrection |
+                 kCanvasColorChanged | kVideoDiscardProtected))) {
+    return false;
+  }
+
+  video_lock_.lock();
+  bool video_effects = video_effect_changed_ || requested_video_effect_;
+  video_lock_.unlock();
+  if (video_effects)
+    return false;
+
+  if (GetSolidBackgroundLayer(source_layers) != solid_background_index_)
+    return false;
+
+  // Every other layer needs to be exactly as it was committed last frame.
+  size_t size = source_layers.size();
+  size_t previous_size = in_flight_layers_.size();
+  size_t z_order = 0;
+  int cursor_index = -1;
+  for (size_t layer_index = 0; layer_index < size; layer_index++) {
+    HwcLayer* layer = source_layers.at(layer_index);
+    if (!layer->IsVisible())
+      continue;
+
+    if (static_cast<int>(layer_index) == solid_background_index_) {
+      if (layer->GetSolidColor() != solid_background_color_)
+        return false;
+
+      continue;
+    }
+
+    if (z_order >= previous_size)
+      return false;
+
+    OverlayLayer& previous_layer = in_flight_layers_.at(z_order);
+    if ((previous_layer.GetLayerIndex() != layer_index) ||
+        (previous_layer.IsCursorLayer() != layer->IsCursorLayer()) ||
+        layer->HasZorderChanged() || layer->HasSourceRectChanged() ||
+        layer->HasLayerAttributesChanged() ||
+        layer->HasVisibleRegionChanged()) {
+      return false;
+    }
+
+    if (layer->IsCursorLayer()) {
+      if (cursor_index != -1)
+        return false;
+
+      cursor_index = z_order++;
+      continue;
+    }
+
+    z_order++;
+    if (layer->HasDisplayRectChanged() || layer->HasLayerContentChanged())
+      return false;
+
+    if (Composition_SolidColor == layer->GetLayerCompositionType()) {
+      if (layer->GetSolidColor() != previous_layer.GetSolidColor())
+        return false;
+    } else {
+      OverlayBuffer* buffer = previous_layer.GetBuffer();
+      if (!buffer || (buffer->GetOriginalHandle() != layer->GetNativeHandle()))
+        return false;
+    }
+  }
+
+  if ((cursor_index == -1) || (z_order != previous_size))
+    return false;
+
+  // The cursor needs to be on a plane of its own.
+  OverlayLayer& previous_cursor = in_flight_layers_.at(cursor_index);
+  const DisplayPlaneState* cursor_plane = NULL;
+  for (const DisplayPlaneState& plane : previous_plane_state_) {
+    if (plane.GetOverlayLayer() == &previous_cursor) {
+      cursor_plane = &plane;
+      break;
+    }
+  }
+
+  if (!cursor_plane || !cursor_plane->Scanout() ||
+      cursor_plane->IsSurfaceRecycled() ||
+      (cursor_plane->GetSourceLayers().size() != 1)) {
+    return false;
+  }
+
+  HwcLayer* layer = source_layers.at(previous_cursor.GetLayerIndex());
+  OverlayLayer cursor;
+  cursor.InitializeFromHwcLayer(
+      layer, resource_manager_.get(), &previous_cursor, cursor_index,
+      previous_cursor.GetLayerIndex(), display_plane_manager_->GetHeight(),
+      display_plane_manager_->GetWidth(), plane_transform_, false);
+
+  // Format, and anything that needs the plane to be validated again (the
+  // cursor being resized or clipped at a screen edge), goes through a
+  // regular commit.
+  OverlayBuffer* buffer = cursor.GetBuffer();
+  OverlayBuffer* previous_buffer = previous_cursor.GetBuffer();
+  if (!cursor.IsVisible() || cursor.NeedsRevalidation() || !buffer ||
+      !previous_buffer || (buffer->GetWidth() != previous_buffer->GetWidth()) ||
+      (buffer->GetHeight() != previous_buffer->GetHeight()) ||
+      (buffer->GetFormat() != previous_buffer->GetFormat()) ||
+      (cursor.GetDisplayFrameWidth() !=
+       previous_cursor.GetDisplayFrameWidth()) ||
+      (cursor.GetDisplayFrameHeight() !=
+       previous_cursor.GetDisplayFrameHeight()) ||
+      !(cursor.GetSourceCrop() == previous_cursor.GetSourceCrop())) {
+    layer->SetAcquireFence(cursor.ReleaseAcquireFence());
+    return false;
+  }
+
+  // Plane state points to the in flight layer, so swap the new cursor in
+  // place and restore the old one if the commit can't be done right now.
+  OverlayLayer old_cursor(std::move(previous_cursor));
+  previous_cursor = std::move(cursor);
+  int32_t fence = 0;
+  if (!display_->CommitCursor(*cursor_plane, state_ & kDisableExplictSync,
+                              &fence)) {
+    layer->SetAcquireFence(previous_cursor.ReleaseAcquireFence());
+    previous_cursor = std::move(old_cursor);
+    return false;
+  }
+
+  // Wait for this commit instead of the previous one in next frame, as
+  // it completes only after it.
+  if (kms_fence_ > 0)
+    close(kms_fence_);
+
+  kms_fence_ = 0;
+  if (fence > 0) {
+    *retire_fence = dup(fence);
+    kms_fence_ = fence;
+
+    SetReleaseFenceToLayers(fence, source_layers);
+  }
+
+  return true;
+}
+
 bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
                                int32_t* retire_fence, bool* ignore_clone_update,
                                PixelUploaderCallback* call_back,
@@ -651,6 +977,14 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   if (tracker.IgnoreUpdate()) {
     return true;
   }
+
+  // Frames composed at their deadline teach us the composition budget.
+  uint64_t composition_start = 0;
+  deadline_tracker_.deadline_lock_.lock();
+  if (deadline_tracker_.target_vblank_ns_)
+    composition_start = GetMonotonicTimeNs();
+  deadline_tracker_.deadline_lock_.unlock();
+
   source_layers_ = &source_layers;
 
   size_t previous_size = in_flight_layers_.size();
@@ -669,9 +1003,59 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   bool re_validate_commit = false;
   needs_clone_validation_ = false;
 
-  InitializeOverlayLayers(source_layers, handle_constraints, validate_layers,
-                          layers, remove_index, add_index, has_video_layer,
-                          has_cursor_layer, re_validate_commit, idle_frame);
+  {
+    // Layers might be shared with other displays being presented in
+    // parallel (i.e. Mosaic).
+    PresentSequencer::ScopedLayerRead layer_read;
+    if (!validate_layers && !handle_constraints && !idle_frame &&
+        !tracker.RevalidateLayers() && IsRedundantFrame(source_layers)) {
+      // Nothing to compose or commit, last flip stays on screen.
+      for (HwcLayer* layer : source_layers) {
+        layer->SetReleaseFence(-1);
+      }
+
+      if (kms_fence_ > 0)
+        *retire_fence = dup(kms_fence_);
+
+      if (!mark_not_inuse_.empty()) {
+        size_t size = mark_not_inuse_.size();
+        for (uint32_t i = 0; i < size; i++) {
+          mark_not_inuse_.at(i)->SetSurfaceAge(-1);
+        }
+
+        std::vector<NativeSurface*>().swap(mark_not_inuse_);
+        tracker.ForceSurfaceRelease();
+      }
+
+      *ignore_clone_update = true;
+      tracker.FrameSkipped();
+      return true;
+    }
+
+    if (!validate_layers && !handle_constraints && !idle_frame &&
+        !tracker.RevalidateLayers() &&
+        UpdateCursorPlane(source_layers, retire_fence)) {
+      tracker.FrameHasCursor();
+      return true;
+    }
+
+    int background_index = GetSolidBackgroundLayer(source_layers);
+    uint32_t background_color = 0;
+    if (background_index != -1)
+      background_color = source_layers.at(background_index)->GetSolidColor();
+
+    if ((background_index != solid_background_index_) ||
+        (background_color != solid_background_color_)) {
+      solid_background_index_ = background_index;
+      solid_background_color_ = background_color;
+      state_ |= kCanvasColorChanged;
+      validate_layers = true;
+    }
+
+    InitializeOverlayLayers(source_layers, handle_constraints, validate_layers,
+                            layers, remove_index, add_index, has_video_layer,
+                            has_cursor_layer, re_validate_commit, idle_frame);
+  }
   if (has_cursor_layer)
     tracker.FrameHasCursor();
 
@@ -894,8 +1278,15 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
   }
 
   if (state_ & kCanvasColorChanged) {
-    display_->SetPipeCanvasColor(canvas_.bpc, canvas_.red, canvas_.green,
-                                 canvas_.blue, canvas_.alpha);
+    if (solid_background_index_ != -1) {
+      uint32_t color = solid_background_color_;
+      display_->SetPipeCanvasColor(8, (color >> 24) & 0xff,
+                                   (color >> 16) & 0xff, (color >> 8) & 0xff,
+                                   color & 0xff);
+    } else {
+      display_->SetPipeCanvasColor(canvas_.bpc, canvas_.red, canvas_.green,
+                                   canvas_.blue, canvas_.alpha);
+    }
     state_ &= ~kCanvasColorChanged;
   }
 
@@ -917,6 +1308,9 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
     return false;
   }
 
+  if (composition_start)
+    UpdateCompositionBudget(composition_start);
+
   // Mark any surfaces as not in use. These surfaces
   // where not marked earlier as they where onscreen.
   // Doing it here also ensures that if this surface
@@ -936,6 +1330,8 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
 
   // Swap current and previous composition results.
   previous_plane_state_.swap(current_composition_planes);
+  if (!IsIgnoreUpdates() && display_->IsCommitBatched())
+    HoldStateForBatchedCommit(layers, current_composition_planes);
 
   // Set Age for all offscreen surfaces.
   UpdateOnScreenSurfaces();
@@ -1055,13 +1451,29 @@ void DisplayQueue::PresentClonedCommit(DisplayQueue* queue) {
   bool render_layers = false;
   bool validate_layers = last_commit_failed_update_ ||
                          queue->needs_clone_validation_ ||
+                         (state_ & kConfigurationChanged) ||
                          previous_plane_state_.empty() || (add_index == 0);
   if (previous_plane_state_.size() != source_planes.size())
     validate_layers = true;
 
   DisplayPlaneStateList current_composition_planes;
+  // Try to scan out the planes source display has already composited, so
+  // that content is composited only once for all pipes. The accepted
+  // mapping stays in previous_plane_state_ and goes through the cached
+  // path below, it's only tested again when the source composition or our
+  // mode changes.
+  bool zero_copy = false;
+  if (validate_layers) {
+    state_ &= ~kConfigurationChanged;
+    zero_copy = display_plane_manager_->ValidateClonedPlanes(
+        layers, current_composition_planes, previous_plane_state_,
+        surfaces_not_inuse_);
+    if (zero_copy)
+      validate_layers = false;
+  }
+
   // Validate Overlays and Layers usage.
-  if (!validate_layers) {
+  if (!zero_copy && !validate_layers) {
     bool can_ignore_commit = false;
     // Before forcing layer validation, check if content has changed
     // if not continue showing the current buffer.
@@ -1192,6 +1604,8 @@ void DisplayQueue::PresentClonedCommit(DisplayQueue* queue) {
 
   in_flight_layers_.swap(layers);
   current_composition_planes.swap(previous_plane_state_);
+  if (display_->IsCommitBatched())
+    HoldStateForBatchedCommit(layers, current_composition_planes);
 
   // Set Age for all offscreen surfaces.
   UpdateOnScreenSurfaces();
@@ -1223,6 +1637,52 @@ void DisplayQueue::PresentClonedCommit(DisplayQueue* queue) {
   }
 }
 
+void DisplayQueue::HoldStateForBatchedCommit(
+    std::vector<OverlayLayer>& layers, DisplayPlaneStateList& planes) {
+  batched_layers_.swap(layers);
+  batched_plane_state_.swap(planes);
+  batched_commit_pending_ = true;
+}
+
+void DisplayQueue::HandleBatchedCommit(int32_t fence, bool committed) {
+  if (!committed && batched_commit_pending_) {
+    // The frame never reached the hardware, go back to what is on screen
+    // so that the next frame isn't diffed against it.
+    previous_plane_state_.swap(batched_plane_state_);
+    in_flight_layers_.swap(batched_layers_);
+    HandleCommitFailure(batched_plane_state_);
+
+    // Surfaces of the restored planes may have been queued for release
+    // when the failed frame was validated.
+    for (DisplayPlaneState& plane : previous_plane_state_) {
+      for (NativeSurface* surface : plane.GetSurfaces()) {
+        mark_not_inuse_.erase(std::remove(mark_not_inuse_.begin(),
+                                          mark_not_inuse_.end(), surface),
+                              mark_not_inuse_.end());
+        surfaces_not_inuse_.erase(
+            std::remove(surfaces_not_inuse_.begin(),
+                        surfaces_not_inuse_.end(), surface),
+            surfaces_not_inuse_.end());
+      }
+    }
+  }
+
+  batched_commit_pending_ = false;
+  DisplayPlaneStateList().swap(batched_plane_state_);
+  std::vector<OverlayLayer>().swap(batched_layers_);
+  if (!committed) {
+    // Force full validation next frame.
+    last_commit_failed_update_ = true;
+    return;
+  }
+
+  if (fence > 0) {
+    kms_fence_ = fence;
+    if (source_layers_)
+      SetReleaseFenceToLayers(fence, *source_layers_);
+  }
+}
+
 void DisplayQueue::SetCloneMode(bool cloned) {
   if (clone_mode_ == cloned)
     return;
@@ -1256,9 +1716,9 @@ void DisplayQueue::ResetPlanes(drmModeAtomicReqPtr pset) {
 }
 
 void DisplayQueue::IgnoreUpdates() {
-  idle_tracker_.idle_frames_ = 0;
+  idle_tracker_.idle_requested_ = false;
   idle_tracker_.state_ = FrameStateTracker::kIgnoreUpdates;
-  idle_tracker_.revalidate_frames_counter_ = 0;
+  idle_tracker_.tracking_start_ns_ = 0;
 }
 
 bool DisplayQueue::IsIgnoreUpdates() {
@@ -1267,8 +1727,21 @@ bool DisplayQueue::IsIgnoreUpdates() {
 
 void DisplayQueue::HandleCommitFailure(
     DisplayPlaneStateList& current_composition_planes) {
+  // Planes the failed frame didn't modify still share their state, and
+  // with it their surfaces, with the last committed frame. Only the
+  // modified ones need to be rolled back.
+  std::vector<bool> unchanged(previous_plane_state_.size(), false);
   for (DisplayPlaneState& plane : current_composition_planes) {
-    if (plane.GetSurfaces().empty()) {
+    bool modified = true;
+    for (size_t i = 0; i < previous_plane_state_.size(); i++) {
+      if (!plane.HasChangedSince(previous_plane_state_.at(i))) {
+        unchanged.at(i) = true;
+        modified = false;
+        break;
+      }
+    }
+
+    if (!modified || plane.GetSurfaces().empty()) {
       continue;
     }
 
@@ -1277,9 +1750,11 @@ void DisplayQueue::HandleCommitFailure(
   }
 
   // Let's mark all previous planes as in use.
-  for (DisplayPlaneState& previous_plane : previous_plane_state_) {
+  for (size_t i = 0; i < previous_plane_state_.size(); i++) {
+    DisplayPlaneState& previous_plane = previous_plane_state_.at(i);
     previous_plane.GetDisplayPlane()->SetInUse(true);
-    previous_plane.HandleCommitFailure();
+    if (!unchanged.at(i))
+      previous_plane.HandleCommitFailure();
   }
 }
 
@@ -1348,6 +1823,7 @@ void DisplayQueue::UpdateOnScreenSurfaces() {
 
 void DisplayQueue::SetReleaseFenceToLayers(
     int32_t fence, std::vector<HwcLayer*>& source_layers) {
+  PresentSequencer::ScopedLayerWrite layer_write;
   for (const DisplayPlaneState& plane : previous_plane_state_) {
     if (plane.IsSurfaceRecycled())
       continue;
@@ -1458,6 +1934,16 @@ void DisplayQueue::SetDisableExplicitSync(bool disable_explicit_sync) {
   }
 }
 
+void DisplayQueue::SetLateComposition(bool enable) {
+  ScopedSpinLock lock(deadline_tracker_.deadline_lock_);
+  deadline_tracker_.configured_ = true;
+  if (deadline_tracker_.enabled_ == enable)
+    return;
+
+  deadline_tracker_.Reset();
+  deadline_tracker_.enabled_ = enable;
+}
+
 void DisplayQueue::SetVideoScalingMode(uint32_t mode) {
   video_lock_.lock();
   requested_video_effect_ = true;
@@ -1546,18 +2032,24 @@ void DisplayQueue::HandleIdleCase() {
     return;
   }
 
-  if (idle_tracker_.idle_frames_ > kidleframes) {
+  if (idle_tracker_.idle_requested_ || idle_tracker_.idle_timeout_ns_ == 0) {
     idle_tracker_.idle_lock_.unlock();
     return;
   }
 
-  if (idle_tracker_.idle_frames_ < kidleframes) {
-    idle_tracker_.idle_frames_++;
+  uint64_t now = GetMonotonicTimeNs();
+  if (idle_tracker_.last_frame_ns_ == 0) {
+    idle_tracker_.last_frame_ns_ = now;
     idle_tracker_.idle_lock_.unlock();
     return;
   }
 
-  idle_tracker_.idle_frames_++;
+  if (now - idle_tracker_.last_frame_ns_ < idle_tracker_.IdleTimeout()) {
+    idle_tracker_.idle_lock_.unlock();
+    return;
+  }
+
+  idle_tracker_.idle_requested_ = true;
   power_mode_lock_.lock();
   if (!(state_ & kIgnoreIdleRefresh) && refresh_callback_ &&
       (state_ & kPoweredOn)) {
@@ -1596,6 +2088,10 @@ void DisplayQueue::ForceIgnoreUpdates(bool force) {
 void DisplayQueue::DisplayConfigurationChanged() {
   // Mark it as needs modeset, so that in next queue update we do a modeset
   state_ |= kConfigurationChanged;
+  // Refresh rate might have changed.
+  deadline_tracker_.deadline_lock_.lock();
+  deadline_tracker_.period_ns_ = 0;
+  deadline_tracker_.deadline_lock_.unlock();
 }
 
 void DisplayQueue::UpdateScalingRatio(uint32_t primary_width,
@@ -1632,12 +2128,128 @@ void DisplayQueue::ResetQueue() {
   }
 
   idle_tracker_.state_ = 0;
-  idle_tracker_.idle_frames_ = 0;
+  idle_tracker_.idle_requested_ = false;
+  idle_tracker_.last_frame_ns_ = 0;
+  idle_tracker_.tracking_start_ns_ = 0;
+  idle_tracker_.cadence_ns_ = 0;
+  idle_tracker_.steady_intervals_ = 0;
   if (ignore_updates) {
     idle_tracker_.state_ |= FrameStateTracker::kIgnoreUpdates;
   }
   compositor_.Reset();
   clone_rendered_ = false;
+  deadline_tracker_.deadline_lock_.lock();
+  bool late_composition = deadline_tracker_.enabled_;
+  deadline_tracker_.Reset();
+  deadline_tracker_.enabled_ = late_composition;
+  deadline_tracker_.deadline_lock_.unlock();
+}
+
+uint64_t DisplayQueue::GetCompositionDeadline() {
+  DeadlineTracker& tracker = deadline_tracker_;
+  tracker.deadline_lock_.lock();
+  bool enabled = tracker.enabled_;
+  uint64_t period = tracker.period_ns_;
+  tracker.deadline_lock_.unlock();
+  if (!enabled || clone_mode_)
+    return 0;
+
+  if (!period) {
+    uint32_t config = 0;
+    int32_t refresh_rate = 0;
+    if (!display_->GetActiveConfig(&config) ||
+        !display_->GetDisplayAttribute(
+            config, HWCDisplayAttribute::kRefreshRate, &refresh_rate) ||
+        refresh_rate <= 0) {
+      return 0;
+    }
+
+    period = 1000000000ULL / refresh_rate;
+  }
+
+  // The retire fence of the last commit signals when it flipped, which
+  // gives us the vblank phase. Fence stays owned by kms_fence_.
+  uint64_t flip = 0;
+  bool flip_pending = false;
+  if (kms_fence_ > 0) {
+    HWCFence fence(kms_fence_);
+    flip = fence.GetSignalTime();
+    flip_pending = fence.GetStatus() == HWCFence::kActive;
+    fence.Release();
+  }
+
+  tracker.deadline_lock_.lock();
+  uint64_t deadline = 0;
+  if (tracker.enabled_) {
+    if (!tracker.period_ns_)
+      tracker.period_ns_ = period;
+
+    deadline = ScheduleCompositionLocked(tracker.period_ns_, flip,
+                                         flip_pending);
+  }
+  tracker.deadline_lock_.unlock();
+
+  return deadline;
+}
+
+uint64_t DisplayQueue::ScheduleCompositionLocked(uint64_t period,
+                                                 uint64_t flip,
+                                                 bool flip_pending) {
+  DeadlineTracker& tracker = deadline_tracker_;
+  if (flip) {
+    if (tracker.target_vblank_ns_ &&
+        flip > tracker.target_vblank_ns_ + period / 2) {
+      // Composition or GPU work took longer than budgeted.
+      tracker.missed_deadlines_++;
+      tracker.margin_ns_ += period / 8;
+      if (tracker.missed_deadlines_ >= DeadlineTracker::kMaxMissedDeadlines) {
+        ITRACE("Missed %d composition deadlines, composing early.",
+               tracker.missed_deadlines_);
+        tracker.fallback_frames_ = DeadlineTracker::kFallbackFrames;
+        tracker.missed_deadlines_ = 0;
+        tracker.margin_ns_ = 0;
+      }
+    } else if (tracker.target_vblank_ns_) {
+      tracker.missed_deadlines_ = 0;
+      tracker.margin_ns_ -= tracker.margin_ns_ / 16;
+    }
+
+    tracker.last_flip_ns_ = flip;
+    tracker.target_vblank_ns_ = 0;
+  }
+
+  if (tracker.fallback_frames_) {
+    tracker.fallback_frames_--;
+    tracker.target_vblank_ns_ = 0;
+    return 0;
+  }
+
+  uint64_t now = GetMonotonicTimeNs();
+  if (!tracker.last_flip_ns_ || now < tracker.last_flip_ns_)
+    return 0;
+
+  uint64_t vblank = tracker.last_flip_ns_ +
+                    ((now - tracker.last_flip_ns_) / period + 1) * period;
+  // Last frame takes the next vblank, we can only make the one after.
+  if (flip_pending)
+    vblank += period;
+
+  uint64_t budget = tracker.Budget();
+  if (budget >= period) {
+    tracker.target_vblank_ns_ = 0;
+    return 0;
+  }
+
+  tracker.target_vblank_ns_ = vblank;
+  return vblank - budget;
+}
+
+void DisplayQueue::UpdateCompositionBudget(uint64_t start_ns) {
+  uint64_t now = GetMonotonicTimeNs();
+  if (now > start_ns) {
+    ScopedSpinLock lock(deadline_tracker_.deadline_lock_);
+    deadline_tracker_.AddFrame(now - start_ns);
+  }
 }
 
 }  // namespace hwcomposer
@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <memory>
 #include <queue>
 #include <vector>
@@ -29,6 +30,7 @@
 #include "compositor.h"
 #include "displayplanemanager.h"
 #include "hwcthread.h"
+#include "hwcutils.h"
 #include "platformdefines.h"
 #include "resourcemanager.h"
 #include "vblankeventhandler.h"
@@ -54,7 +56,6 @@ class DisplayPlaneHandler;
 struct HwcLayer;
 class NativeBufferHandler;
 
-static uint32_t kidleframes = 250;
 class DisplayQueue {
  public:
   DisplayQueue(uint32_t gpu_fd, bool disable_explictsync,
@@ -74,6 +75,8 @@ class DisplayQueue {
   void SetContrast(uint32_t red, uint32_t green, uint32_t blue);
   void SetBrightness(uint32_t red, uint32_t green, uint32_t blue);
   void SetDisableExplicitSync(bool disable_explicit_sync);
+  void SetLateComposition(bool enable);
+  uint64_t GetCompositionDeadline();
   void SetVideoScalingMode(uint32_t mode);
   void SetVideoColor(HWCColorControl color, float value);
   void GetVideoColor(HWCColorControl color, float* value, float* start,
@@ -114,6 +117,10 @@ class DisplayQueue {
 
   void PresentClonedCommit(DisplayQueue* queue);
 
+  // Called once the commit of the last QueueUpdate, which was deferred to a
+  // multi CRTC commit, has been applied. Takes ownership of fence.
+  void HandleBatchedCommit(int32_t fence, bool committed);
+
   const DisplayPlaneStateList& GetCurrentCompositionPlanes() const {
     return previous_plane_state_;
   }
@@ -191,11 +198,49 @@ class DisplayQueue {
       kForceIgnoreUpdates = 1 << 6  // Ignore all commits/updates.
     };
 
-    uint32_t idle_frames_ = 0;
+    // Number of consecutive intervals close to cadence_ns_ after which
+    // content is considered periodic.
+    static const uint32_t kSteadyIntervals = 4;
+
+    // Tracks the interval between updates, so that steady low rate content
+    // (i.e. a slideshow) doesn't keep entering and leaving idle mode.
+    void UpdateCadence(uint64_t interval) {
+      if (interval == 0)
+        return;
+
+      uint64_t tolerance = cadence_ns_ / 4;
+      if (cadence_ns_ != 0 && interval + tolerance >= cadence_ns_ &&
+          interval <= cadence_ns_ + tolerance) {
+        if (steady_intervals_ < kSteadyIntervals)
+          steady_intervals_++;
+
+        cadence_ns_ = (cadence_ns_ * 3 + interval) / 4;
+      } else {
+        cadence_ns_ = interval;
+        steady_intervals_ = 0;
+      }
+    }
+
+    uint64_t IdleTimeout() const {
+      if (steady_intervals_ >= kSteadyIntervals &&
+          cadence_ns_ * 2 > idle_timeout_ns_)
+        return cadence_ns_ * 2;
+
+      return idle_timeout_ns_;
+    }
+
+    bool idle_requested_ = false;
     bool has_cursor_layer_ = false;
     SpinLock idle_lock_;
     int state_ = kPrepareComposition;
-    uint32_t revalidate_frames_counter_ = 0;
+    // Time of the last update and of the first update of the current run
+    // of updates while kTrackingFrames is set.
+    uint64_t last_frame_ns_ = 0;
+    uint64_t tracking_start_ns_ = 0;
+    uint64_t cadence_ns_ = 0;
+    uint32_t steady_intervals_ = 0;
+    uint64_t idle_timeout_ns_ = 0;
+    uint64_t idle_exit_ns_ = 0;
     size_t total_planes_ = 1;
   };
 
@@ -243,7 +288,7 @@ class DisplayQueue {
         tracker_.state_ = 0;
       }
 
-      tracker_.revalidate_frames_counter_ = 0;
+      tracker_.tracking_start_ns_ = 0;
     }
 
     bool IgnoreUpdate() const {
@@ -258,28 +303,54 @@ class DisplayQueue {
       forced_ = true;
     }
 
+    // Frame didn't change anything on screen. It doesn't count as an
+    // update, so that idle detection keeps running.
+    void FrameSkipped() {
+      skipped_ = true;
+    }
+
     ~ScopedIdleStateTracker() {
+      uint64_t now = GetMonotonicTimeNs();
       tracker_.idle_lock_.lock();
-      // Reset idle frame count. We want that idle frames
-      // are continuous to detect idle mode scenario.
-      tracker_.idle_frames_ = 0;
+      if (skipped_) {
+        tracker_.state_ &= ~FrameStateTracker::kPrepareComposition;
+        tracker_.idle_lock_.unlock();
+        queue_->display_plane_manager_->ReleaseFreeOffScreenTargets(forced_);
+        if (resource_manager_->PreparePurgedResources())
+          compositor_.FreeResources();
+
+        return;
+      }
+
+      // Restart the idle timer. We want that idle time
+      // is continuous to detect idle mode scenario.
+      tracker_.idle_requested_ = false;
+      uint64_t interval =
+          tracker_.last_frame_ns_ ? now - tracker_.last_frame_ns_ : 0;
+      tracker_.last_frame_ns_ = now;
+      tracker_.UpdateCadence(interval);
 
       tracker_.state_ &= ~FrameStateTracker::kPrepareComposition;
       if (tracker_.state_ & FrameStateTracker::kRenderIdleDisplay) {
         tracker_.state_ &= ~FrameStateTracker::kRenderIdleDisplay;
         tracker_.state_ |= FrameStateTracker::kTrackingFrames;
-        tracker_.revalidate_frames_counter_ = 0;
+        tracker_.tracking_start_ns_ = 0;
       } else if (tracker_.state_ & FrameStateTracker::kTrackingFrames) {
-        if (tracker_.revalidate_frames_counter_ > 3) {
+        // Only move layers back to overlays once updates keep coming
+        // without a gap for idle_exit_ns_. Occasional updates stay on a
+        // single plane rather than flapping in and out of idle mode.
+        if (tracker_.tracking_start_ns_ == 0 ||
+            interval > tracker_.idle_exit_ns_) {
+          tracker_.tracking_start_ns_ = now;
+        } else if (now - tracker_.tracking_start_ns_ >=
+                   tracker_.idle_exit_ns_) {
           tracker_.state_ &= ~FrameStateTracker::kTrackingFrames;
           tracker_.state_ |= FrameStateTracker::kRevalidateLayers;
-          tracker_.revalidate_frames_counter_ = 0;
-        } else {
-          tracker_.revalidate_frames_counter_++;
+          tracker_.tracking_start_ns_ = 0;
         }
       } else if (tracker_.state_ & FrameStateTracker::kRevalidateLayers) {
         tracker_.state_ &= ~FrameStateTracker::kRevalidateLayers;
-        tracker_.revalidate_frames_counter_ = 0;
+        tracker_.tracking_start_ns_ = 0;
       }
 
       tracker_.total_planes_ = queue_->previous_plane_state_.size();
@@ -294,12 +365,73 @@ class DisplayQueue {
 
    private:
     bool forced_ = false;
+    bool skipped_ = false;
     struct FrameStateTracker& tracker_;
     Compositor& compositor_;
     ResourceManager* resource_manager_;
     DisplayQueue* queue_;
   };
 
+  // Tracks when frames flip and how long they take to compose and commit,
+  // so that composition can start as late as possible in late composition
+  // mode.
+  struct DeadlineTracker {
+    // Number of recent frames the composition budget is learned from.
+    static const uint32_t kBudgetFrames = 8;
+    // Consecutive missed deadlines after which frames are composed right
+    // away again for kFallbackFrames.
+    static const uint32_t kMaxMissedDeadlines = 3;
+    static const uint32_t kFallbackFrames = 120;
+
+    // Time needed from the start of composition until the commit is
+    // queued, with margin for GPU work which completes after it.
+    uint64_t Budget() const {
+      if (total_frames_ == 0)
+        return period_ns_ / 2;
+
+      uint64_t budget = 0;
+      uint32_t frames =
+          total_frames_ < kBudgetFrames ? total_frames_ : kBudgetFrames;
+      for (uint32_t i = 0; i < frames; i++)
+        budget = std::max(budget, work_ns_[i]);
+
+      return budget + margin_ns_;
+    }
+
+    void AddFrame(uint64_t work_ns) {
+      work_ns_[total_frames_ % kBudgetFrames] = work_ns;
+      total_frames_++;
+    }
+
+    void Reset() {
+      period_ns_ = 0;
+      last_flip_ns_ = 0;
+      target_vblank_ns_ = 0;
+      total_frames_ = 0;
+      margin_ns_ = 0;
+      missed_deadlines_ = 0;
+      fallback_frames_ = 0;
+    }
+
+    bool enabled_ = false;
+    uint64_t period_ns_ = 0;
+    // Last flip seen through a signaled retire fence.
+    uint64_t last_flip_ns_ = 0;
+    // Vblank the last scheduled frame was composed for, 0 if none.
+    uint64_t target_vblank_ns_ = 0;
+    uint64_t work_ns_[kBudgetFrames] = {};
+    uint32_t total_frames_ = 0;
+    uint64_t margin_ns_ = 0;
+    uint32_t missed_deadlines_ = 0;
+    uint32_t fallback_frames_ = 0;
+    // Set once SetLateComposition was called, the setting from
+    // hwc_display.ini no longer applies then.
+    bool configured_ = false;
+    // Protects the tracker, which is changed by SetLateComposition and
+    // display configuration changes while frames are composed.
+    SpinLock deadline_lock_;
+  };
+
   // State trackers for cloned display.
   struct ScopedCloneStateTracker {
     ScopedCloneStateTracker(Compositor& compositor,
@@ -341,17 +473,48 @@ class DisplayQueue {
   void SetReleaseFenceToLayers(int32_t fence,
                                std::vector<HwcLayer*>& source_layers);
 
+  // Returns index of the bottom most layer in source_layers if it is an
+  // opaque solid color covering the whole display, which can be shown
+  // through the pipe canvas instead of a plane. Returns -1 otherwise.
+  int GetSolidBackgroundLayer(std::vector<HwcLayer*>& source_layers);
+
+  // Handles a frame where only the cursor layer has moved or changed its
+  // buffer by updating the cursor plane alone, without validating the
+  // other layers. Returns false if the frame needs a regular commit.
+  bool UpdateCursorPlane(std::vector<HwcLayer*>& source_layers,
+                         int32_t* retire_fence);
+
+  // Returns true if every layer still has the buffer, geometry, transform
+  // and alpha it was committed with last frame and no damage, i.e.
+  // presenting source_layers would not change anything on screen.
+  bool IsRedundantFrame(std::vector<HwcLayer*>& source_layers);
+
   void SetMediaEffectsState(bool apply_effects,
                             const std::vector<OverlayLayer>& layers,
                             DisplayPlaneStateList& current_composition_planes);
 
   void UpdateOnScreenSurfaces();
 
+  // Updates the tracker with the flip of the last frame and returns the
+  // time composition of this frame should start, or 0 if it should start
+  // right away. deadline_lock_ must be held.
+  uint64_t ScheduleCompositionLocked(uint64_t period, uint64_t flip,
+                                     bool flip_pending);
+
+  // Learns the composition budget from a scheduled frame which started
+  // composition at start_ns and has just been committed.
+  void UpdateCompositionBudget(uint64_t start_ns);
+
   // Re-initialize all state. When we are hearing this means the
   // queue is teraing down or re-started for some reason.
   void ResetQueue();
 
   void HandleCommitFailure(DisplayPlaneStateList& current_composition_planes);
+
+  // Keeps the layers and planes replaced by a batched commit, which are
+  // still on screen until the batch is flushed.
+  void HoldStateForBatchedCommit(std::vector<OverlayLayer>& layers,
+                                 DisplayPlaneStateList& planes);
   void InitializeOverlayLayers(std::vector<HwcLayer*>& source_layers,
                                bool handle_constraints, bool validate_layers,
                                std::vector<OverlayLayer>& layers,
@@ -375,6 +538,7 @@ class DisplayQueue {
   DisplayPlaneStateList previous_plane_state_;
   FrameStateTracker idle_tracker_;
   ScalingTracker scaling_tracker_;
+  DeadlineTracker deadline_tracker_;
   // shared_ptr since we need to use this outside of the thread lock (to
   // actually call the hook) and we don't want the memory freed until we're
   // done
@@ -393,9 +557,19 @@ class DisplayQueue {
   bool last_commit_failed_update_ = false;
   // Set to true if cloned display needs to be validated.
   bool needs_clone_validation_ = false;
+  // Set while a frame waits for its batched commit. batched_layers_ and
+  // batched_plane_state_ hold what is on screen meanwhile, they are
+  // restored if the batch fails.
+  bool batched_commit_pending_ = false;
+  std::vector<OverlayLayer> batched_layers_;
+  DisplayPlaneStateList batched_plane_state_;
   bool clone_mode_ = false;
   // Set to true if this queue needs to render the offscreen surfaces.
   bool clone_rendered_ = false;
+  // Index of the source layer shown through the pipe canvas, -1 if the
+  // canvas color set by the client is in use.
+  int solid_background_index_ = -1;
+  uint32_t solid_background_color_ = 0;
   // Surfaces to be marked as not in use. These
   // are surfaces which are added to surfaces_not_inuse_
   // below.
@@ -19,12 +19,29 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include <thread>
+
+#include <gpudevice.h>
+
 #include "displayqueue.h"
+#include "hwcreactor.h"
 #include "hwctrace.h"
 
 namespace hwcomposer {
 
 static const int64_t kOneSecondNs = 1 * 1000 * 1000 * 1000;
+// Retry interval when vblank events can't be requested, about a frame.
+static const uint64_t kVblankRetryNs = 16 * 1000 * 1000;
+
+// Handler whose event is being dispatched on this thread, if any.
+static thread_local VblankEventHandler* tls_dispatching = NULL;
+
+SpinLock VblankEventHandler::handlers_lock_;
+std::map<uint32_t, VblankEventHandler*> VblankEventHandler::handlers_;
+uint32_t VblankEventHandler::next_handler_id_ = 1;
+SpinLock VblankEventHandler::sources_lock_;
+std::map<int, VblankEventHandler::DrmEventSource>
+    VblankEventHandler::sources_;
 
 VblankEventHandler::VblankEventHandler(DisplayQueue* queue)
     : HWCThread(-8, "VblankEventHandler"),
@@ -37,6 +54,7 @@ VblankEventHandler::VblankEventHandler(DisplayQueue* queue)
 }
 
 VblankEventHandler::~VblankEventHandler() {
+  StopReactorTasks();
 }
 
 void VblankEventHandler::Init(int fd, int pipe) {
@@ -48,9 +66,15 @@ void VblankEventHandler::Init(int fd, int pipe) {
 
 bool VblankEventHandler::SetPowerMode(uint32_t power_mode) {
   if (power_mode != kOn) {
+    StopReactorTasks();
     Exit();
-  } else {
-    if (!InitWorker()) {
+  } else if (!reactor_) {
+    HWCReactor* reactor = GpuDevice::getInstance().GetReactor();
+    if (reactor && !initialized_) {
+      if (!StartReactorTasks(reactor)) {
+        ETRACE("Failed to register VblankEventHandler with reactor.");
+      }
+    } else if (!InitWorker()) {
       ETRACE("Failed to initalize thread for VblankEventHandler. %s",
              PRINTERROR());
     }
@@ -92,10 +116,13 @@ void VblankEventHandler::HandlePageFlipEvent(unsigned int sec,
   IPAGEFLIPEVENTTRACE("Callback called from HandlePageFlipEvent. %lu",
                       timestamp);
   spin_lock_.lock();
-  if (enabled_ && callback_) {
-    callback_->Callback(display_, timestamp);
-  }
+  std::shared_ptr<VsyncCallback> callback = enabled_ ? callback_ : NULL;
+  uint32_t display = display_;
   spin_lock_.unlock();
+
+  // The callback may call back into us, i.e. to disable vsync.
+  if (callback)
+    callback->Callback(display, timestamp);
 }
 
 void VblankEventHandler::HandleWait() {
@@ -116,4 +143,149 @@ void VblankEventHandler::HandleRoutine() {
     HandlePageFlipEvent(vblank.reply.tval_sec, (int64_t)vblank.reply.tval_usec);
 }
 
+bool VblankEventHandler::StartReactorTasks(HWCReactor* reactor) {
+  handlers_lock_.lock();
+  uint32_t handler_id = next_handler_id_++;
+  handlers_lock_.unlock();
+
+  retry_timer_ =
+      reactor->AddTimer([handler_id]() { HandleRetry(handler_id); });
+  if (retry_timer_ < 0)
+    return false;
+
+  sources_lock_.lock();
+  auto it = sources_.find(fd_);
+  if (it == sources_.end()) {
+    int fd = fd_;
+    int task = reactor->AddFd(fd, [fd]() { DispatchDrmEvents(fd); });
+    if (task < 0) {
+      sources_lock_.unlock();
+      reactor->RemoveTask(retry_timer_);
+      retry_timer_ = -1;
+      return false;
+    }
+
+    DrmEventSource source;
+    source.task = task;
+    source.users = 1;
+    sources_.emplace(fd, source);
+  } else {
+    it->second.users++;
+  }
+  sources_lock_.unlock();
+
+  reactor_ = reactor;
+  handler_id_ = handler_id;
+  handlers_lock_.lock();
+  handlers_.emplace(handler_id_, this);
+  if (!RequestVblankEvent())
+    reactor_->ArmTimer(retry_timer_, kVblankRetryNs, 0);
+  handlers_lock_.unlock();
+
+  return true;
+}
+
+void VblankEventHandler::StopReactorTasks() {
+  if (!reactor_)
+    return;
+
+  // Once removed, pending events and retries for this handler are
+  // ignored.
+  handlers_lock_.lock();
+  handlers_.erase(handler_id_);
+  // Wait for events already being dispatched to us on other threads.
+  uint32_t self = tls_dispatching == this ? 1 : 0;
+  while (dispatch_count_ > self) {
+    handlers_lock_.unlock();
+    std::this_thread::yield();
+    handlers_lock_.lock();
+  }
+  handlers_lock_.unlock();
+
+  reactor_->RemoveTask(retry_timer_);
+  retry_timer_ = -1;
+
+  sources_lock_.lock();
+  auto it = sources_.find(fd_);
+  if (it != sources_.end() && --it->second.users == 0) {
+    reactor_->RemoveTask(it->second.task);
+    sources_.erase(it);
+  }
+  sources_lock_.unlock();
+
+  reactor_ = NULL;
+}
+
+bool VblankEventHandler::RequestVblankEvent() {
+  drmVBlank vblank;
+  memset(&vblank, 0, sizeof(vblank));
+  vblank.request.sequence = 1;
+  vblank.request.type = (drmVBlankSeqType)(type_ | DRM_VBLANK_EVENT);
+  vblank.request.signal = handler_id_;
+
+  return !drmWaitVBlank(fd_, &vblank);
+}
+
+void VblankEventHandler::HandleVblankEvent(unsigned int sec,
+                                           unsigned int usec) {
+  uint32_t handler_id = handler_id_;
+  queue_->HandleIdleCase();
+  HandlePageFlipEvent(sec, usec);
+  // Callbacks may have stopped us, i.e. by turning the display off.
+  if (reactor_ && handler_id_ == handler_id && !RequestVblankEvent())
+    reactor_->ArmTimer(retry_timer_, kVblankRetryNs, 0);
+}
+
+void VblankEventHandler::HandleVblankFailure() {
+  queue_->HandleIdleCase();
+  if (reactor_ && !RequestVblankEvent())
+    reactor_->ArmTimer(retry_timer_, kVblankRetryNs, 0);
+}
+
+VblankEventHandler* VblankEventHandler::BeginDispatch(uint32_t handler_id) {
+  ScopedSpinLock lock(handlers_lock_);
+  auto it = handlers_.find(handler_id);
+  if (it == handlers_.end())
+    return NULL;
+
+  it->second->dispatch_count_++;
+  tls_dispatching = it->second;
+  return it->second;
+}
+
+void VblankEventHandler::EndDispatch() {
+  ScopedSpinLock lock(handlers_lock_);
+  tls_dispatching = NULL;
+  dispatch_count_--;
+}
+
+void VblankEventHandler::DispatchDrmEvents(int fd) {
+  drmEventContext context;
+  memset(&context, 0, sizeof(context));
+  context.version = 2;
+  context.vblank_handler = VblankEventCallback;
+  drmHandleEvent(fd, &context);
+}
+
+void VblankEventHandler::VblankEventCallback(int /*fd*/,
+                                             unsigned int /*sequence*/,
+                                             unsigned int sec,
+                                             unsigned int usec, void* data) {
+  uint32_t handler_id =
+      static_cast<uint32_t>(reinterpret_cast<uintptr_t>(data));
+  VblankEventHandler* handler = BeginDispatch(handler_id);
+  if (handler) {
+    handler->HandleVblankEvent(sec, usec);
+    handler->EndDispatch();
+  }
+}
+
+void VblankEventHandler::HandleRetry(uint32_t handler_id) {
+  VblankEventHandler* handler = BeginDispatch(handler_id);
+  if (handler) {
+    handler->HandleVblankFailure();
+    handler->EndDispatch();
+  }
+}
+
 }  // namespace hwcomposer
@@ -23,6 +23,7 @@
 #include <nativedisplay.h>
 #include <spinlock.h>
 
+#include <map>
 #include <memory>
 
 #include "hwcthread.h"
@@ -30,6 +31,7 @@
 namespace hwcomposer {
 
 class DisplayQueue;
+class HWCReactor;
 
 class VblankEventHandler : public HWCThread {
  public:
@@ -52,6 +54,46 @@ class VblankEventHandler : public HWCThread {
   void HandleWait() override;
 
  private:
+  // When the reactor is enabled, vblank events are requested from the
+  // kernel and delivered on the drm fd, which is watched by the reactor
+  // for all displays sharing it, instead of a thread per display blocking
+  // in drmWaitVBlank.
+  bool StartReactorTasks(HWCReactor* reactor);
+  void StopReactorTasks();
+  bool RequestVblankEvent();
+  void HandleVblankEvent(unsigned int sec, unsigned int usec);
+  void HandleVblankFailure();
+
+  static void DispatchDrmEvents(int fd);
+  static void VblankEventCallback(int fd, unsigned int sequence,
+                                  unsigned int sec, unsigned int usec,
+                                  void* data);
+  static void HandleRetry(uint32_t handler_id);
+  // Events are dispatched without holding handlers_lock_, so that
+  // callbacks can call back into the handler. StopReactorTasks waits for
+  // dispatches in progress on other threads.
+  static VblankEventHandler* BeginDispatch(uint32_t handler_id);
+  void EndDispatch();
+
+  struct DrmEventSource {
+    int task;
+    uint32_t users;
+  };
+
+  // Handlers are looked up by id, as events requested before a handler
+  // was stopped can still be delivered after it.
+  static SpinLock handlers_lock_;
+  static std::map<uint32_t, VblankEventHandler*> handlers_;
+  static uint32_t next_handler_id_;
+  static SpinLock sources_lock_;
+  static std::map<int, DrmEventSource> sources_;
+
+  HWCReactor* reactor_ = NULL;
+  int retry_timer_ = -1;
+  uint32_t handler_id_ = 0;
+  // Protected by handlers_lock_.
+  uint32_t dispatch_count_ = 0;
+
   // shared_ptr since we need to use this outside of the thread lock (to
   // actually call the hook) and we don't want the memory freed until we're
   // done
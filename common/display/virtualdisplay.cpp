@@ -24,6 +24,8 @@
 #include <sstream>
 #include <vector>
 
+#include "bufferimportcache.h"
+#include "gpudevice.h"
 #include "hwctrace.h"
 #include "overlaylayer.h"
 
@@ -278,8 +280,8 @@ bool VirtualDisplay::Present(std::vector<HwcLayer *> &source_layers,
     size_t purged_size = purged_gl_resources.size();
 
     if (purged_size != 0) {
-      const NativeBufferHandler *handler =
-          resource_manager_->GetNativeBufferHandler();
+      BufferImportCache *import_cache =
+          GpuDevice::getInstance().GetBufferImportCache();
 
       for (size_t i = 0; i < purged_size; i++) {
         const ResourceHandle &handle = purged_gl_resources.at(i);
@@ -308,8 +310,7 @@ bool VirtualDisplay::Present(std::vector<HwcLayer *> &source_layers,
           }
           mHyperDmaExportedBuffers.erase(search);
         }
-        handler->ReleaseBuffer(handle.handle_);
-        handler->DestroyHandle(handle.handle_);
+        import_cache->ReleaseImport(handle.handle_);
       }
     }
     return true;
@@ -24,6 +24,8 @@
 #include <sstream>
 #include <vector>
 
+#include "bufferimportcache.h"
+#include "gpudevice.h"
 #include "hwctrace.h"
 #include "overlaylayer.h"
 
@@ -266,8 +268,8 @@ void VirtualPanoramaDisplay::HyperDmaExport(bool notify_stopping) {
   size_t purged_size = purged_gl_resources.size();
 
   if (purged_size != 0) {
-    const NativeBufferHandler *handler =
-        resource_manager_->GetNativeBufferHandler();
+    BufferImportCache *import_cache =
+        GpuDevice::getInstance().GetBufferImportCache();
 
     for (size_t i = 0; i < purged_size; i++) {
       const ResourceHandle &handle = purged_gl_resources.at(i);
@@ -294,8 +296,7 @@ void VirtualPanoramaDisplay::HyperDmaExport(bool notify_stopping) {
         }
         mHyperDmaExportedBuffers.erase(search);
       }
-      handler->ReleaseBuffer(handle.handle_);
-      handler->DestroyHandle(handle.handle_);
+      import_cache->ReleaseImport(handle.handle_);
     }
   }
 #endif
@@ -17,21 +17,27 @@
 #include "fdhandler.h"
 
 #include <errno.h>
-#include <poll.h>
 #include <string.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "hwctrace.h"
 
 namespace hwcomposer {
 
-FDHandler::FDHandler() {
+FDHandler::FDHandler() : events_(1) {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    ETRACE("Failed to create epoll fd %s", PRINTERROR());
+  }
 }
 
 FDHandler::~FDHandler() {
+  if (epoll_fd_ >= 0)
+    close(epoll_fd_);
 }
 
-bool FDHandler::AddFd(int fd) {
+bool FDHandler::AddFd(int fd, bool edge_triggered) {
   if (fd < 0) {
     ETRACE("Cannot add negative fd: %d", fd);
     return false;
@@ -43,7 +49,21 @@ bool FDHandler::AddFd(int fd) {
     return false;
   }
 
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  if (edge_triggered)
+    event.events |= EPOLLET;
+
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+    ETRACE("Failed to watch fd %d %s", fd, PRINTERROR());
+    return false;
+  }
+
   fds_.emplace(fd, FDWatch());
+  if (fds_.size() > events_.size())
+    events_.resize(fds_.size());
 
   return true;
 }
@@ -55,26 +75,25 @@ bool FDHandler::RemoveFd(int fd) {
     return false;
   }
 
+  // The fd might already have been closed, which removes it from the
+  // epoll set, so failure here is expected.
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, NULL);
   fds_.erase(fd_iter);
   return true;
 }
 
 int FDHandler::Poll(int timeout) {
-  nfds_t nfds = fds_.size();
-  struct pollfd fds[nfds];
-
-  int i = 0;
-  for (auto &it : fds_) {
-    fds[i].fd = it.first;
-    fds[i].events = POLLIN;
-    it.second.idx = i;
-    i++;
-  }
-
-  int ret = poll(fds, nfds, timeout);
-
-  for (auto &it : fds_) {
-    it.second.revents = fds[it.second.idx].revents;
+  int ret = epoll_wait(epoll_fd_, events_.data(), events_.size(), timeout);
+  // Results of previous calls are discarded by bumping the count, instead
+  // of clearing every FDWatch.
+  poll_count_++;
+  for (int i = 0; i < ret; i++) {
+    auto it = fds_.find(events_[i].data.fd);
+    if (it == fds_.end())
+      continue;
+
+    it->second.poll_count = poll_count_;
+    it->second.revents = events_[i].events;
   }
 
   return ret;
@@ -87,18 +106,19 @@ int FDHandler::IsReady(int fd) const {
     return false;
   }
 
-  int revents = it->second.revents;
-  if (revents & POLLIN)
+  if (it->second.poll_count != poll_count_)
+    return 0;
+
+  uint32_t revents = it->second.revents;
+  if (revents & EPOLLIN)
     return 1;
-  else if (revents & POLLERR)
+  else if (revents & EPOLLERR)
     return -1;
-  else if (revents & POLLNVAL)
-    return -2;
   else
     return 0;
 }
 
-FDHandler::FDWatch::FDWatch() : idx(0), revents(0) {
+FDHandler::FDWatch::FDWatch() : poll_count(0), revents(0) {
 }
 
 }  // namespace hwcomposer
@@ -17,26 +17,35 @@
 #ifndef COMMON_UTILS_FDHANDLER_H_
 #define COMMON_UTILS_FDHANDLER_H_
 
-#include <map>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#include <unordered_map>
+#include <vector>
 
 namespace hwcomposer {
 
-// Class wrapper around poll() and struct pollfd.
-// It keeps the fds added on it so one doesn't have to keep
-// recreating/populating the pollfd manually.
+// Class wrapper around epoll. Fds are registered once with a persistent
+// epoll set, so adding, removing and polling don't depend on the number
+// of fds being watched.
 class FDHandler {
  public:
   FDHandler();
   virtual ~FDHandler();
 
+  // Owns epoll_fd_, which would be closed twice by a copy.
+  FDHandler(const FDHandler &rhs) = delete;
+  FDHandler &operator=(const FDHandler &rhs) = delete;
+
   // Add fd to the list of fds that we care about. This makes ::Poll watch for
-  // this fd when called.
-  bool AddFd(int fd);
+  // this fd when called. With edge_triggered set, fd is only reported once
+  // each time it becomes ready, instead of as long as it is ready.
+  bool AddFd(int fd, bool edge_triggered = false);
 
   // Remove the fd from the list of fds that we are watching.
   bool RemoveFd(int fd);
 
-  // Call poll() on the list of fds that we are watching. Will block if
+  // Call epoll_wait() on the fds that we are watching. Will block if
   // timemout > 0. Store the result from the poll request, so it can be queried
   // with ::IsReady().
   //  - timeout: time in miliseconds to stay blocked before returning if no fd
@@ -49,17 +58,20 @@ class FDHandler {
   // - return: 1 if fd is ready to read
   //           0 if fd is not ready
   //           -1 if there's an error on the fd
-  //           -2 if the fd is closed and can't be polled
   int IsReady(int fd) const;
 
  private:
   struct FDWatch {
     FDWatch();
-    int idx;
-    short revents;
+    // Poll call in which revents were reported.
+    uint32_t poll_count;
+    uint32_t revents;
   };
 
-  std::map<int, FDWatch> fds_;
+  std::unordered_map<int, FDWatch> fds_;
+  std::vector<struct epoll_event> events_;
+  int epoll_fd_ = -1;
+  uint32_t poll_count_ = 0;
 };
 
 }  // namespace hwcomposer
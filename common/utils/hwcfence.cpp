@@ -0,0 +1,204 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "hwcfence.h"
+
+#include <fcntl.h>
+#include <linux/sync_file.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <libsync.h>
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+// sw_sync is a debug interface, its uapi is not exported by the kernel.
+struct SwSyncCreateFenceData {
+  uint32_t value;
+  char name[32];
+  int32_t fence;
+};
+
+#define SW_SYNC_IOC_MAGIC 'W'
+#define SW_SYNC_IOC_CREATE_FENCE \
+  _IOWR(SW_SYNC_IOC_MAGIC, 0, struct SwSyncCreateFenceData)
+#define SW_SYNC_IOC_INC _IOW(SW_SYNC_IOC_MAGIC, 1, uint32_t)
+
+HWCFence::HWCFence(HWCFence &&other) : fd_(other.Release()) {
+}
+
+HWCFence &HWCFence::operator=(HWCFence &&other) {
+  if (this != &other)
+    Reset(other.Release());
+
+  return *this;
+}
+
+HWCFence::~HWCFence() {
+  Reset();
+}
+
+int32_t HWCFence::Release() {
+  int32_t fd = fd_;
+  fd_ = -1;
+  return fd;
+}
+
+void HWCFence::Reset(int32_t fd) {
+  if (fd_ > 0)
+    close(fd_);
+
+  fd_ = fd;
+}
+
+int32_t HWCFence::Dup() const {
+  if (fd_ <= 0)
+    return -1;
+
+  return dup(fd_);
+}
+
+bool HWCFence::Wait(int timeout) const {
+  if (fd_ <= 0)
+    return true;
+
+  return sync_wait(fd_, timeout) == 0;
+}
+
+HWCFence::Status HWCFence::GetStatus() const {
+  if (fd_ <= 0)
+    return kSignaled;
+
+  struct sync_file_info info;
+  memset(&info, 0, sizeof(info));
+  if (ioctl(fd_, SYNC_IOC_FILE_INFO, &info) < 0) {
+    ETRACE("Failed to query fence %d. %s", fd_, PRINTERROR());
+    return kError;
+  }
+
+  if (info.status < 0)
+    return kError;
+
+  return info.status ? kSignaled : kActive;
+}
+
+uint64_t HWCFence::GetSignalTime() const {
+  if (fd_ <= 0)
+    return 0;
+
+  // The first call gets the number of fences, the second their info.
+  struct sync_file_info info;
+  memset(&info, 0, sizeof(info));
+  if (ioctl(fd_, SYNC_IOC_FILE_INFO, &info) < 0 || info.status != 1 ||
+      info.num_fences == 0) {
+    return 0;
+  }
+
+  std::vector<struct sync_fence_info> fences(info.num_fences);
+  memset(fences.data(), 0, sizeof(struct sync_fence_info) * fences.size());
+  info.sync_fence_info = reinterpret_cast<uint64_t>(fences.data());
+  if (ioctl(fd_, SYNC_IOC_FILE_INFO, &info) < 0) {
+    ETRACE("Failed to query fences of %d. %s", fd_, PRINTERROR());
+    return 0;
+  }
+
+  uint64_t timestamp = 0;
+  for (const struct sync_fence_info &fence : fences) {
+    if (fence.timestamp_ns > timestamp)
+      timestamp = fence.timestamp_ns;
+  }
+
+  return timestamp;
+}
+
+HWCFence HWCFence::Merge(const char *name, std::vector<int32_t> &fences) {
+  int32_t merged = -1;
+  for (int32_t fence : fences) {
+    if (fence <= 0)
+      continue;
+
+    if (merged <= 0) {
+      merged = fence;
+      continue;
+    }
+
+    if (sync_accumulate(name, &merged, fence)) {
+      ETRACE("Unable to merge fences");
+      // Fall back to waiting here, the merged fence covers the rest.
+      sync_wait(fence, -1);
+    }
+
+    close(fence);
+  }
+
+  std::vector<int32_t>().swap(fences);
+  return HWCFence(merged);
+}
+
+HWCSyncTimeline::~HWCSyncTimeline() {
+  if (timeline_fd_ >= 0)
+    close(timeline_fd_);
+}
+
+bool HWCSyncTimeline::Initialize() {
+  if (timeline_fd_ >= 0)
+    return true;
+
+  timeline_fd_ = open("/sys/kernel/debug/sync/sw_sync", O_RDWR | O_CLOEXEC);
+  if (timeline_fd_ < 0)
+    timeline_fd_ = open("/dev/sw_sync", O_RDWR | O_CLOEXEC);
+
+  if (timeline_fd_ < 0) {
+    ETRACE("Failed to open sw_sync timeline. %s", PRINTERROR());
+    return false;
+  }
+
+  return true;
+}
+
+HWCFence HWCSyncTimeline::CreateFence(const char *name, uint32_t steps) {
+  if (timeline_fd_ < 0)
+    return HWCFence();
+
+  struct SwSyncCreateFenceData data;
+  memset(&data, 0, sizeof(data));
+  data.value = current_point_ + steps;
+  strncpy(data.name, name, sizeof(data.name) - 1);
+  if (ioctl(timeline_fd_, SW_SYNC_IOC_CREATE_FENCE, &data) < 0) {
+    ETRACE("Failed to create fence on sw_sync timeline. %s", PRINTERROR());
+    return HWCFence();
+  }
+
+  return HWCFence(data.fence);
+}
+
+bool HWCSyncTimeline::Advance(uint32_t steps) {
+  if (timeline_fd_ < 0)
+    return false;
+
+  if (ioctl(timeline_fd_, SW_SYNC_IOC_INC, &steps) < 0) {
+    ETRACE("Failed to advance sw_sync timeline. %s", PRINTERROR());
+    return false;
+  }
+
+  current_point_ += steps;
+  return true;
+}
+
+}  // namespace hwcomposer
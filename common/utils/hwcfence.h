@@ -0,0 +1,108 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_HWCFENCE_H_
+#define COMMON_UTILS_HWCFENCE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace hwcomposer {
+
+// Owns a sync file fd and closes it when destroyed. Like the rest of HWC,
+// fds <= 0 are treated as no fence.
+class HWCFence {
+ public:
+  enum Status { kError = -1, kActive = 0, kSignaled = 1 };
+
+  HWCFence() = default;
+  explicit HWCFence(int32_t fd) : fd_(fd) {
+  }
+
+  HWCFence(HWCFence &&other);
+  HWCFence &operator=(HWCFence &&other);
+  ~HWCFence();
+
+  int32_t get() const {
+    return fd_;
+  }
+
+  bool IsValid() const {
+    return fd_ > 0;
+  }
+
+  // Gives up ownership of the fd and returns it.
+  int32_t Release();
+
+  // Closes the current fd and takes ownership of fd.
+  void Reset(int32_t fd = -1);
+
+  // Returns a new fd for the same fence, or -1.
+  int32_t Dup() const;
+
+  // Waits for the fence for at most timeout ms, -1 waits forever.
+  // Returns true if the fence signaled or there is no fence.
+  bool Wait(int timeout) const;
+
+  // Queries the fence with SYNC_IOC_FILE_INFO without waiting.
+  Status GetStatus() const;
+
+  // Returns CLOCK_MONOTONIC time in ns at which the last of the merged
+  // fences signaled, or 0 if the fence is still active.
+  uint64_t GetSignalTime() const;
+
+  // Returns a fence which signals once all |fences| have signaled, so
+  // that consumers need to wait only once. Takes ownership of |fences|
+  // and clears it. Returns an invalid fence if none of them is valid.
+  static HWCFence Merge(const char *name, std::vector<int32_t> &fences);
+
+ private:
+  HWCFence(const HWCFence &) = delete;
+  HWCFence &operator=(const HWCFence &) = delete;
+
+  int32_t fd_ = -1;
+};
+
+// A software timeline backed by sw_sync. Fences created on it signal
+// once the timeline is advanced past their point, which allows the
+// fence flow to run without a GPU or display (i.e. in tests).
+class HWCSyncTimeline {
+ public:
+  HWCSyncTimeline() = default;
+  ~HWCSyncTimeline();
+
+  // Needs CONFIG_SW_SYNC and access to the sw_sync debugfs node.
+  bool Initialize();
+
+  // Creates a fence which signals once the timeline advanced by |steps|
+  // from its current point.
+  HWCFence CreateFence(const char *name, uint32_t steps = 1);
+
+  // Moves the timeline forward by |steps|, signalling the fences created
+  // for those points.
+  bool Advance(uint32_t steps = 1);
+
+ private:
+  HWCSyncTimeline(const HWCSyncTimeline &) = delete;
+  HWCSyncTimeline &operator=(const HWCSyncTimeline &) = delete;
+
+  int timeline_fd_ = -1;
+  uint32_t current_point_ = 0;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_HWCFENCE_H_
@@ -0,0 +1,242 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_HWCFORMATS_H_
+#define COMMON_UTILS_HWCFORMATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <drm_fourcc.h>
+
+#include "platformdefines.h"
+
+namespace hwcomposer {
+
+// Layout and properties of a DRM fourcc pixel format. Planes other than
+// plane 0 are chroma planes and are subsampled by hsub and vsub.
+struct HwcFormatInfo {
+  uint32_t format;
+  // Format to use when importing the buffer (i.e. to KMS). Differs from
+  // format for vendor specific aliases.
+  uint32_t native_format;
+  uint32_t planes;
+  // Bytes per pixel of each plane, 0 for unused planes.
+  uint32_t cpp[3];
+  uint32_t hsub;
+  uint32_t vsub;
+  bool has_alpha;
+  bool is_yuv;
+  // Layout is always Y tiled, whatever the modifier is.
+  bool y_tiled;
+  // Composited by the media backend rather than GL, see
+  // IsSupportedMediaFormat.
+  bool is_media;
+  // Fourcc used by VA for this format, 0 if we don't use VA with it.
+  uint32_t va_fourcc;
+};
+
+// VA fourccs use the same encoding as DRM ones.
+#define HWC_VA_FOURCC(a, b, c, d) fourcc_code(a, b, c, d)
+
+// Every format HWC knows about. Keep the table sorted by kind, lookups
+// are linear.
+constexpr HwcFormatInfo kHwcFormats[] = {
+    // format, native_format, planes, cpp, hsub, vsub, has_alpha, is_yuv,
+    // y_tiled, is_media, va_fourcc
+    {DRM_FORMAT_C8, DRM_FORMAT_C8, 1, {1, 0, 0}, 1, 1, false, false, false,
+     false, 0},
+    {DRM_FORMAT_R8, DRM_FORMAT_R8, 1, {1, 0, 0}, 1, 1, false, false, false,
+     false, 0},
+    {DRM_FORMAT_R16, DRM_FORMAT_R16, 1, {2, 0, 0}, 1, 1, false, false, false,
+     false, 0},
+    {DRM_FORMAT_RG88, DRM_FORMAT_RG88, 1, {2, 0, 0}, 1, 1, false, false, false,
+     false, 0},
+    {DRM_FORMAT_GR88, DRM_FORMAT_GR88, 1, {2, 0, 0}, 1, 1, false, false, false,
+     false, 0},
+    {DRM_FORMAT_RGB332, DRM_FORMAT_RGB332, 1, {1, 0, 0}, 1, 1, false, false,
+     false, false, 0},
+    {DRM_FORMAT_BGR233, DRM_FORMAT_BGR233, 1, {1, 0, 0}, 1, 1, false, false,
+     false, false, 0},
+    {DRM_FORMAT_XRGB4444, DRM_FORMAT_XRGB4444, 1, {2, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_XBGR4444, DRM_FORMAT_XBGR4444, 1, {2, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_RGBX4444, DRM_FORMAT_RGBX4444, 1, {2, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_BGRX4444, DRM_FORMAT_BGRX4444, 1, {2, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_ARGB4444, DRM_FORMAT_ARGB4444, 1, {2, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_ABGR4444, DRM_FORMAT_ABGR4444, 1, {2, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_RGBA4444, DRM_FORMAT_RGBA4444, 1, {2, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_BGRA4444, DRM_FORMAT_BGRA4444, 1, {2, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_XRGB1555, DRM_FORMAT_XRGB1555, 1, {2, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_XBGR1555, DRM_FORMAT_XBGR1555, 1, {2, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_RGBX5551, DRM_FORMAT_RGBX5551, 1, {2, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_BGRX5551, DRM_FORMAT_BGRX5551, 1, {2, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_ARGB1555, DRM_FORMAT_ARGB1555, 1, {2, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_ABGR1555, DRM_FORMAT_ABGR1555, 1, {2, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_RGBA5551, DRM_FORMAT_RGBA5551, 1, {2, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_BGRA5551, DRM_FORMAT_BGRA5551, 1, {2, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_RGB565, DRM_FORMAT_RGB565, 1, {2, 0, 0}, 1, 1, false, false,
+     false, false, 0},
+    {DRM_FORMAT_BGR565, DRM_FORMAT_BGR565, 1, {2, 0, 0}, 1, 1, false, false,
+     false, false, 0},
+    {DRM_FORMAT_RGB888, DRM_FORMAT_RGB888, 1, {3, 0, 0}, 1, 1, false, false,
+     false, false, 0},
+    {DRM_FORMAT_BGR888, DRM_FORMAT_BGR888, 1, {3, 0, 0}, 1, 1, false, false,
+     false, false, 0},
+    {DRM_FORMAT_XRGB8888, DRM_FORMAT_XRGB8888, 1, {4, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_XBGR8888, DRM_FORMAT_XBGR8888, 1, {4, 0, 0}, 1, 1, false,
+     false, false, false, HWC_VA_FOURCC('R', 'G', 'B', 'X')},
+    {DRM_FORMAT_RGBX8888, DRM_FORMAT_RGBX8888, 1, {4, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_BGRX8888, DRM_FORMAT_BGRX8888, 1, {4, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_ARGB8888, DRM_FORMAT_ARGB8888, 1, {4, 0, 0}, 1, 1, true, false,
+     false, false, HWC_VA_FOURCC('A', 'B', 'G', 'R')},
+    {DRM_FORMAT_ABGR8888, DRM_FORMAT_ABGR8888, 1, {4, 0, 0}, 1, 1, true, false,
+     false, false, HWC_VA_FOURCC('R', 'G', 'B', 'A')},
+    {DRM_FORMAT_RGBA8888, DRM_FORMAT_RGBA8888, 1, {4, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_BGRA8888, DRM_FORMAT_BGRA8888, 1, {4, 0, 0}, 1, 1, true, false,
+     false, false, 0},
+    {DRM_FORMAT_XRGB2101010, DRM_FORMAT_XRGB2101010, 1, {4, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_XBGR2101010, DRM_FORMAT_XBGR2101010, 1, {4, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_RGBX1010102, DRM_FORMAT_RGBX1010102, 1, {4, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_BGRX1010102, DRM_FORMAT_BGRX1010102, 1, {4, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_ARGB2101010, DRM_FORMAT_ARGB2101010, 1, {4, 0, 0}, 1, 1, true,
+     false, false, false, 0},
+    {DRM_FORMAT_ABGR2101010, DRM_FORMAT_ABGR2101010, 1, {4, 0, 0}, 1, 1, true,
+     false, false, false, 0},
+    {DRM_FORMAT_RGBA1010102, DRM_FORMAT_RGBA1010102, 1, {4, 0, 0}, 1, 1, true,
+     false, false, false, 0},
+    {DRM_FORMAT_BGRA1010102, DRM_FORMAT_BGRA1010102, 1, {4, 0, 0}, 1, 1, true,
+     false, false, false, 0},
+    {DRM_FORMAT_XRGB161616, DRM_FORMAT_XRGB161616, 1, {8, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    {DRM_FORMAT_XBGR161616, DRM_FORMAT_XBGR161616, 1, {8, 0, 0}, 1, 1, false,
+     false, false, false, 0},
+    // Packed YUV.
+    {DRM_FORMAT_YUYV, DRM_FORMAT_YUYV, 1, {2, 0, 0}, 1, 1, false, true, false,
+     true, HWC_VA_FOURCC('Y', 'U', 'Y', '2')},
+    {DRM_FORMAT_YVYU, DRM_FORMAT_YVYU, 1, {2, 0, 0}, 1, 1, false, true, false,
+     true, 0},
+    {DRM_FORMAT_UYVY, DRM_FORMAT_UYVY, 1, {2, 0, 0}, 1, 1, false, true, false,
+     true, HWC_VA_FOURCC('U', 'Y', 'V', 'Y')},
+    {DRM_FORMAT_VYUY, DRM_FORMAT_VYUY, 1, {2, 0, 0}, 1, 1, false, true, false,
+     true, 0},
+    {DRM_FORMAT_AYUV, DRM_FORMAT_AYUV, 1, {4, 0, 0}, 1, 1, true, true, false,
+     true, 0},
+    // Semi planar YUV.
+    {DRM_FORMAT_NV12, DRM_FORMAT_NV12, 2, {1, 2, 0}, 2, 2, false, true, false,
+     true, HWC_VA_FOURCC('N', 'V', '1', '2')},
+    {DRM_FORMAT_NV21, DRM_FORMAT_NV12, 2, {1, 2, 0}, 2, 2, false, true, false,
+     true, 0},
+    {DRM_FORMAT_NV12_Y_TILED_INTEL, DRM_FORMAT_NV12, 2, {1, 2, 0}, 2, 2, false,
+     true, true, true, 0},
+    {DRM_FORMAT_NV16, DRM_FORMAT_NV16, 2, {1, 2, 0}, 2, 1, false, true, false,
+     true, 0},
+    {DRM_FORMAT_NV61, DRM_FORMAT_NV61, 2, {1, 2, 0}, 2, 1, false, true, false,
+     false, 0},
+    {DRM_FORMAT_P010, DRM_FORMAT_P010, 2, {2, 4, 0}, 2, 2, false, true, false,
+     true, HWC_VA_FOURCC('P', '0', '1', '0')},
+    {DRM_FORMAT_P012, DRM_FORMAT_P012, 2, {2, 4, 0}, 2, 2, false, true, false,
+     false, 0},
+    {DRM_FORMAT_P016, DRM_FORMAT_P016, 2, {2, 4, 0}, 2, 2, false, true, false,
+     false, 0},
+    // Planar YUV.
+    {DRM_FORMAT_YUV410, DRM_FORMAT_YUV410, 3, {1, 1, 1}, 4, 4, false, true,
+     false, false, 0},
+    {DRM_FORMAT_YVU410, DRM_FORMAT_YVU410, 3, {1, 1, 1}, 4, 4, false, true,
+     false, false, 0},
+    {DRM_FORMAT_YUV411, DRM_FORMAT_YUV411, 3, {1, 1, 1}, 4, 1, false, true,
+     false, false, 0},
+    {DRM_FORMAT_YVU411, DRM_FORMAT_YVU411, 3, {1, 1, 1}, 4, 1, false, true,
+     false, false, 0},
+    {DRM_FORMAT_YUV420, DRM_FORMAT_YUV420, 3, {1, 1, 1}, 2, 2, false, true,
+     false, true, HWC_VA_FOURCC('I', '4', '2', '0')},
+    {DRM_FORMAT_YVU420, DRM_FORMAT_YVU420, 3, {1, 1, 1}, 2, 2, false, true,
+     false, true, HWC_VA_FOURCC('Y', 'V', '1', '2')},
+    {DRM_FORMAT_YVU420_ANDROID, DRM_FORMAT_YUV420, 3, {1, 1, 1}, 2, 2, false,
+     true, false, true, 0},
+    // VA treats planar 4:2:2 as YUY2.
+    {DRM_FORMAT_YUV422, DRM_FORMAT_YUV422, 3, {1, 1, 1}, 2, 1, false, true,
+     false, true, HWC_VA_FOURCC('Y', 'U', 'Y', '2')},
+    {DRM_FORMAT_YVU422, DRM_FORMAT_YVU422, 3, {1, 1, 1}, 2, 1, false, true,
+     false, false, 0},
+    {DRM_FORMAT_YUV444, DRM_FORMAT_YUV444, 3, {1, 1, 1}, 1, 1, false, true,
+     false, true, 0},
+    {DRM_FORMAT_YVU444, DRM_FORMAT_YVU444, 3, {1, 1, 1}, 1, 1, false, true,
+     false, false, 0},
+};
+
+constexpr size_t kHwcFormatsSize = sizeof(kHwcFormats) / sizeof(kHwcFormats[0]);
+
+// Returns description of format or NULL if HWC doesn't know about it.
+constexpr const HwcFormatInfo *GetFormatInfo(uint32_t format,
+                                             size_t index = 0) {
+  return index == kHwcFormatsSize
+             ? nullptr
+             : kHwcFormats[index].format == format
+                   ? &kHwcFormats[index]
+                   : GetFormatInfo(format, index + 1);
+}
+
+// Width in pixels of plane for a buffer of given width.
+constexpr uint32_t GetFormatPlaneWidth(const HwcFormatInfo &info,
+                                       uint32_t plane, uint32_t width) {
+  return plane == 0 ? width : (width + info.hsub - 1) / info.hsub;
+}
+
+// Height in lines of plane for a buffer of given height.
+constexpr uint32_t GetFormatPlaneHeight(const HwcFormatInfo &info,
+                                        uint32_t plane, uint32_t height) {
+  return plane == 0 ? height : (height + info.vsub - 1) / info.vsub;
+}
+
+// Bytes needed by one line of plane, without any padding.
+constexpr uint32_t GetFormatPlaneLineSize(const HwcFormatInfo &info,
+                                          uint32_t plane, uint32_t width) {
+  return GetFormatPlaneWidth(info, plane, width) * info.cpp[plane];
+}
+
+// Bytes needed by plane with lines of stride bytes.
+constexpr size_t GetFormatPlaneSize(const HwcFormatInfo &info, uint32_t plane,
+                                    uint32_t height, uint32_t stride) {
+  return static_cast<size_t>(GetFormatPlaneHeight(info, plane, height)) *
+         stride;
+}
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_HWCFORMATS_H_
@@ -0,0 +1,523 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "hwcframepacer.h"
+
+#include <algorithm>
+
+#include <hwcutils.h>
+
+#include "hwcreactor.h"
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+// Vblanks which may be missed before queued frames are released anyway.
+static const uint64_t kMaxMissedVblanks = 4;
+
+// Vblanks without a queued frame after which vsync is turned off again.
+static const uint32_t kIdleVblanks = 30;
+
+HWCFramePacer::HWCFramePacer() {
+}
+
+HWCFramePacer::~HWCFramePacer() {
+  // Waits for callbacks which are still running.
+  reactor_.reset();
+  Flush();
+}
+
+bool HWCFramePacer::Initialize(PresentCallback present,
+                               VsyncControlCallback vsync_control) {
+  present_ = present;
+  vsync_control_ = vsync_control;
+  reactor_.reset(new HWCReactor(1, "hwcframepacer"));
+  if (!reactor_->Initialize()) {
+    ETRACE("Failed to initialize frame pacer thread.");
+    reactor_.reset();
+    return false;
+  }
+
+  work_event_ = reactor_->AddEvent([this]() { HandleWork(); });
+  watchdog_ = reactor_->AddTimer([this]() { HandleWatchdog(); });
+  deadline_timer_ = reactor_->AddTimer([this]() { HandleDeadline(); });
+  if (work_event_ < 0 || watchdog_ < 0 || deadline_timer_ < 0) {
+    ETRACE("Failed to add frame pacer tasks.");
+    reactor_.reset();
+    return false;
+  }
+
+  has_timeline_ = timeline_.Initialize();
+  if (!has_timeline_)
+    ITRACE("No sw_sync, queued frames won't have a retire fence.");
+
+  return true;
+}
+
+void HWCFramePacer::SetRefreshPeriod(uint64_t period_ns) {
+  lock_.lock();
+  period_ns_ = period_ns;
+  lock_.unlock();
+}
+
+uint64_t HWCFramePacer::GetRefreshPeriod() const {
+  lock_.lock();
+  uint64_t period = period_ns_;
+  lock_.unlock();
+  return period;
+}
+
+void HWCFramePacer::OnVblank(uint64_t timestamp_ns) {
+  lock_.lock();
+  if (last_vblank_ns_ && timestamp_ns > last_vblank_ns_) {
+    uint64_t interval = timestamp_ns - last_vblank_ns_;
+    if (!period_ns_) {
+      period_ns_ = interval;
+    } else if (interval > period_ns_ / 2 && interval < period_ns_ * 3 / 2) {
+      // Follow the actual refresh rate, ignoring missed vblanks.
+      period_ns_ = (period_ns_ * 7 + interval) / 8;
+    }
+  }
+
+  last_vblank_ns_ = timestamp_ns;
+  bool signal = ReleaseDueFrames(timestamp_ns, false);
+  if (!frames_.empty() || release_pending_) {
+    idle_vblanks_ = 0;
+  } else if (vsync_wanted_ && ++idle_vblanks_ >= kIdleVblanks) {
+    vsync_wanted_ = false;
+  }
+
+  signal |= vsync_wanted_ != vsync_enabled_;
+  uint64_t watchdog_ns = 0;
+  if (!frames_.empty())
+    watchdog_ns = GetWatchdogTimeoutLocked(GetMonotonicTimeNs());
+  lock_.unlock();
+
+  if (!reactor_)
+    return;
+
+  if (watchdog_ns)
+    reactor_->ArmTimer(watchdog_, watchdog_ns, 0);
+
+  if (signal)
+    reactor_->SignalEvent(work_event_);
+}
+
+uint64_t HWCFramePacer::PredictVblank(uint64_t time_ns) const {
+  lock_.lock();
+  uint64_t vblank = PredictVblankLocked(time_ns);
+  lock_.unlock();
+  return vblank;
+}
+
+uint64_t HWCFramePacer::PredictVblankLocked(uint64_t time_ns) const {
+  if (!last_vblank_ns_ || !period_ns_)
+    return 0;
+
+  if (time_ns < last_vblank_ns_)
+    return last_vblank_ns_;
+
+  uint64_t periods = (time_ns - last_vblank_ns_) / period_ns_ + 1;
+  return last_vblank_ns_ + periods * period_ns_;
+}
+
+bool HWCFramePacer::HasRecentVblankLocked(uint64_t now) const {
+  return last_vblank_ns_ && period_ns_ &&
+         now < last_vblank_ns_ + kMaxMissedVblanks * period_ns_;
+}
+
+HWCFramePacer::Result HWCFramePacer::QueueFrame(uint64_t target_ns,
+                                                uint64_t frame,
+                                                int32_t *retire_fence) {
+  if (retire_fence)
+    *retire_fence = -1;
+
+  uint64_t now = GetMonotonicTimeNs();
+  lock_.lock();
+  idle_vblanks_ = 0;
+  bool signal = !vsync_wanted_ && !vsync_enabled_;
+  vsync_wanted_ = true;
+
+  Result result = kQueued;
+  uint64_t half_period = period_ns_ / 2;
+  if (!reactor_ || !period_ns_) {
+    result = kPresented;
+  } else if (!HasRecentVblankLocked(now)) {
+    // Vsync was off or stalled, so there is nothing to predict from. Show
+    // frames due within a period now and queue the others until vblanks
+    // are back.
+    if (frames_.empty() && target_ns < now + period_ns_)
+      result = target_ns + half_period < now ? kLate : kPresented;
+  } else if (frames_.empty() && !release_pending_) {
+    // A commit now flips at the next vblank. If that is as close to the
+    // target as we can get, there is nothing to wait for.
+    uint64_t next_vblank = PredictVblankLocked(now);
+    if (target_ns + half_period < next_vblank) {
+      result = kLate;
+    } else if (target_ns < next_vblank + half_period) {
+      result = kPresented;
+    }
+  }
+
+  uint64_t watchdog_ns = 0;
+  if (result == kQueued) {
+    Frame queued;
+    queued.target_ns = target_ns;
+    queued.id = frame;
+    CreateRetireFenceLocked(queued, retire_fence);
+    auto it = frames_.begin();
+    while (it != frames_.end() && it->target_ns <= target_ns)
+      it++;
+
+    frames_.insert(it, queued);
+    watchdog_ns = GetWatchdogTimeoutLocked(now);
+  } else {
+    CountLocked(result);
+  }
+  lock_.unlock();
+
+  if (!reactor_)
+    return result;
+
+  if (watchdog_ns)
+    reactor_->ArmTimer(watchdog_, watchdog_ns, 0);
+
+  if (signal)
+    reactor_->SignalEvent(work_event_);
+
+  return result;
+}
+
+HWCFramePacer::Result HWCFramePacer::ScheduleFrame(uint64_t start_ns,
+                                                   uint64_t frame,
+                                                   int32_t *retire_fence) {
+  if (retire_fence)
+    *retire_fence = -1;
+
+  uint64_t now = GetMonotonicTimeNs();
+  if (!reactor_ || start_ns <= now)
+    return kPresented;
+
+  lock_.lock();
+  bool signal = frame_scheduled_;
+  if (frame_scheduled_)
+    dropped_.emplace_back(scheduled_frame_);
+
+  scheduled_frame_ = Frame();
+  scheduled_frame_.target_ns = start_ns;
+  scheduled_frame_.id = frame;
+  frame_scheduled_ = true;
+  CreateRetireFenceLocked(scheduled_frame_, retire_fence);
+  lock_.unlock();
+
+  reactor_->ArmTimer(deadline_timer_, start_ns - now, 0);
+  if (signal)
+    reactor_->SignalEvent(work_event_);
+
+  return kQueued;
+}
+
+void HWCFramePacer::CreateRetireFenceLocked(Frame &frame,
+                                            int32_t *retire_fence) {
+  if (!has_timeline_)
+    return;
+
+  // Creating a sw_sync fence doesn't block.
+  HWCFence fence = timeline_.CreateFence("hwcframepacer",
+                                         last_point_ + 1 - signaled_point_);
+  if (!fence.IsValid())
+    return;
+
+  frame.point = ++last_point_;
+  if (retire_fence)
+    *retire_fence = fence.Release();
+}
+
+uint64_t HWCFramePacer::GetWatchdogTimeoutLocked(uint64_t now) const {
+  uint64_t period = period_ns_ ? period_ns_ : 1000000000ULL / 60;
+  uint64_t timeout_ns = kMaxMissedVblanks * period;
+  if (!frames_.empty() && frames_.front().target_ns > now)
+    timeout_ns += frames_.front().target_ns - now;
+
+  return timeout_ns;
+}
+
+bool HWCFramePacer::ReleaseDueFrames(uint64_t vblank_ns, bool force) {
+  if (frames_.empty() || (!period_ns_ && !force))
+    return false;
+
+  // Frames whose target is closest to the next vblank or before it are
+  // due. Only the newest of them can be shown.
+  uint64_t next_vblank = vblank_ns + period_ns_;
+  uint64_t half_period = period_ns_ / 2;
+  size_t due = 0;
+  while (due < frames_.size() &&
+         (force || frames_.at(due).target_ns < next_vblank + half_period)) {
+    due++;
+  }
+
+  if (!due)
+    return false;
+
+  // A frame released at the previous vblank which wasn't committed yet
+  // has been superseded as well.
+  stats_.dropped += due - 1;
+  if (release_pending_) {
+    stats_.dropped++;
+    dropped_.emplace_back(pending_frame_);
+  }
+
+  dropped_.insert(dropped_.end(), frames_.begin(), frames_.begin() + due - 1);
+  release_pending_ = true;
+  pending_frame_ = frames_.at(due - 1);
+  if (force || pending_frame_.target_ns + half_period < next_vblank) {
+    pending_result_ = kLate;
+  } else {
+    pending_result_ = kPresented;
+  }
+
+  frames_.erase(frames_.begin(), frames_.begin() + due);
+  return true;
+}
+
+void HWCFramePacer::HandleWatchdog() {
+  uint64_t now = GetMonotonicTimeNs();
+  lock_.lock();
+  bool signal = false;
+  uint64_t watchdog_ns = 0;
+  if (!frames_.empty()) {
+    if (HasRecentVblankLocked(now)) {
+      watchdog_ns = GetWatchdogTimeoutLocked(now);
+    } else {
+      ITRACE("No vblank for %d periods, releasing frames.",
+             static_cast<int>(kMaxMissedVblanks));
+      signal = ReleaseDueFrames(now, true);
+    }
+  }
+  lock_.unlock();
+
+  if (watchdog_ns)
+    reactor_->ArmTimer(watchdog_, watchdog_ns, 0);
+
+  if (signal)
+    reactor_->SignalEvent(work_event_);
+}
+
+void HWCFramePacer::HandleWork() {
+  lock_.lock();
+  bool release = release_pending_;
+  Result result = pending_result_;
+  Frame frame = pending_frame_;
+  release_pending_ = false;
+  if (release)
+    CountLocked(result);
+
+  std::vector<Frame> dropped;
+  dropped.swap(dropped_);
+  bool vsync_changed = vsync_wanted_ != vsync_enabled_;
+  bool vsync = vsync_wanted_;
+  vsync_enabled_ = vsync_wanted_;
+  lock_.unlock();
+
+  if (vsync_changed && vsync_control_)
+    vsync_control_(vsync);
+
+  if (present_) {
+    for (const Frame &dropped_frame : dropped) {
+      present_(kDropped, dropped_frame.id);
+    }
+  }
+
+  lock_.lock();
+  for (const Frame &dropped_frame : dropped) {
+    RetireLocked(dropped_frame.point);
+  }
+  lock_.unlock();
+
+  if (release)
+    PresentFrame(frame, result);
+}
+
+void HWCFramePacer::HandleDeadline() {
+  lock_.lock();
+  bool scheduled = frame_scheduled_;
+  Frame frame = scheduled_frame_;
+  frame_scheduled_ = false;
+  lock_.unlock();
+
+  if (scheduled)
+    PresentFrame(frame, kPresented);
+}
+
+void HWCFramePacer::PresentFrame(const Frame &frame, Result result) {
+  HWCFence retire_fence;
+  if (present_)
+    retire_fence.Reset(present_(result, frame.id));
+
+  if (retire_fence.IsValid()) {
+    RetireOnFence(frame.point, retire_fence);
+    return;
+  }
+
+  lock_.lock();
+  RetireLocked(frame.point);
+  lock_.unlock();
+}
+
+void HWCFramePacer::RetireOnFence(uint32_t point, const HWCFence &fence) {
+  if (!point)
+    return;
+
+  // There is a single worker, so the task can't run before HandleWork
+  // recorded it.
+  int task = reactor_->AddFd(fence.get(), [this, point]() {
+    HandleRetired(point);
+  });
+  lock_.lock();
+  if (task >= 0) {
+    retire_tasks_.emplace(point, task);
+  } else {
+    ETRACE("Failed to wait for retire fence, signalling frame early.");
+    RetireLocked(point);
+  }
+  lock_.unlock();
+}
+
+void HWCFramePacer::HandleRetired(uint32_t point) {
+  lock_.lock();
+  int task = -1;
+  auto it = retire_tasks_.find(point);
+  if (it != retire_tasks_.end()) {
+    task = it->second;
+    retire_tasks_.erase(it);
+    RetireLocked(point);
+  }
+  lock_.unlock();
+
+  if (task >= 0)
+    reactor_->RemoveTask(task);
+}
+
+void HWCFramePacer::RetireLocked(uint32_t point) {
+  if (!point)
+    return;
+
+  retired_points_.emplace_back(point);
+  uint32_t steps = 0;
+  auto it = std::find(retired_points_.begin(), retired_points_.end(),
+                      signaled_point_ + steps + 1);
+  while (it != retired_points_.end()) {
+    retired_points_.erase(it);
+    steps++;
+    it = std::find(retired_points_.begin(), retired_points_.end(),
+                   signaled_point_ + steps + 1);
+  }
+
+  if (!steps)
+    return;
+
+  signaled_point_ += steps;
+  timeline_.Advance(steps);
+}
+
+void HWCFramePacer::CountLocked(Result result) {
+  switch (result) {
+    case kPresented:
+      stats_.presented++;
+      break;
+    case kLate:
+      stats_.late++;
+      break;
+    case kDropped:
+      stats_.dropped++;
+      break;
+    case kQueued:
+      break;
+  }
+}
+
+void HWCFramePacer::Flush() {
+  lock_.lock();
+  stats_.dropped += frames_.size();
+  if (release_pending_) {
+    stats_.dropped++;
+    dropped_.emplace_back(pending_frame_);
+  }
+
+  release_pending_ = false;
+  if (frame_scheduled_)
+    dropped_.emplace_back(scheduled_frame_);
+
+  frame_scheduled_ = false;
+  dropped_.insert(dropped_.end(), frames_.begin(), frames_.end());
+  std::vector<Frame>().swap(frames_);
+  bool signal = !dropped_.empty();
+  lock_.unlock();
+
+  if (signal && reactor_)
+    reactor_->SignalEvent(work_event_);
+}
+
+HWCFramePacer::Stats HWCFramePacer::GetStats() const {
+  lock_.lock();
+  Stats stats = stats_;
+  lock_.unlock();
+  return stats;
+}
+
+HWCVsyncSimulator::HWCVsyncSimulator() {
+}
+
+HWCVsyncSimulator::~HWCVsyncSimulator() {
+  Stop();
+}
+
+bool HWCVsyncSimulator::Start(uint64_t period_ns, Callback callback) {
+  Stop();
+  if (!period_ns)
+    return false;
+
+  callback_ = callback;
+  reactor_.reset(new HWCReactor(1, "hwcvsyncsim"));
+  if (!reactor_->Initialize()) {
+    reactor_.reset();
+    return false;
+  }
+
+  timer_ = reactor_->AddTimer([this]() {
+    callback_(GetMonotonicTimeNs());
+  });
+  if (timer_ < 0 || !reactor_->ArmTimer(timer_, period_ns, period_ns)) {
+    ETRACE("Failed to start simulated vsync");
+    Stop();
+    return false;
+  }
+
+  return true;
+}
+
+void HWCVsyncSimulator::Stop() {
+  if (!reactor_)
+    return;
+
+  if (timer_ >= 0)
+    reactor_->RemoveTask(timer_);
+
+  timer_ = -1;
+  reactor_.reset();
+}
+
+}  // namespace hwcomposer
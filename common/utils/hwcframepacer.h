@@ -0,0 +1,202 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_HWCFRAMEPACER_H_
+#define COMMON_UTILS_HWCFRAMEPACER_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <spinlock.h>
+
+#include "hwcfence.h"
+
+namespace hwcomposer {
+
+class HWCReactor;
+
+// Paces frames which should be shown at a given time against predicted
+// vblanks. Frames which can't be committed right away are queued and the
+// vblank before their target hands the newest due one to the present
+// callback, on a thread of the pacer, so that its commit flips at the
+// target. Queued frames get a retire fence of their own from a sw_sync
+// timeline, signalled once the commit's retire fence signals or the frame
+// is dropped. Frames can also be scheduled at a given time, for late
+// composition. Vblank timestamps come from the display or from
+// HWCVsyncSimulator, all times are CLOCK_MONOTONIC in ns.
+class HWCFramePacer {
+ public:
+  enum Result {
+    kPresented = 0,  // Shown at the vblank closest to its target.
+    kLate = 1,       // Shown after the vblank of its target passed.
+    kDropped = 2,    // A newer frame was due at the same vblank.
+    kQueued = 3      // Will be passed to the present callback when due.
+  };
+
+  struct Stats {
+    uint64_t presented = 0;
+    uint64_t late = 0;
+    uint64_t dropped = 0;
+  };
+
+  // Commits queued frame, result is kPresented or kLate, and returns the
+  // retire fence of the commit or -1. Called with kDropped for queued
+  // frames which are not shown, the return value is ignored then.
+  typedef std::function<int32_t(Result result, uint64_t frame)>
+      PresentCallback;
+  // Vblanks are only needed while frames are paced, enabled is false once
+  // no frame was queued for a while.
+  typedef std::function<void(bool enabled)> VsyncControlCallback;
+
+  HWCFramePacer();
+  ~HWCFramePacer();
+
+  bool Initialize(PresentCallback present,
+                  VsyncControlCallback vsync_control);
+
+  // Nominal refresh period, used until it is measured from vblanks.
+  void SetRefreshPeriod(uint64_t period_ns);
+  uint64_t GetRefreshPeriod() const;
+
+  // Records a vblank and releases the frame due at the next one.
+  void OnVblank(uint64_t timestamp_ns);
+
+  // Returns predicted time of the first vblank after time_ns, or 0 if no
+  // vblank has been seen yet.
+  uint64_t PredictVblank(uint64_t time_ns) const;
+
+  // Returns kPresented or kLate if a frame to be shown at target_ns should
+  // be committed by the caller right away, or kQueued if it will be passed
+  // to the present callback later, identified by frame. For queued frames
+  // retire_fence, if not NULL, is set to their retire fence, or -1 if
+  // sw_sync is not available. Never blocks. Frames are not held if
+  // vblanks stop arriving.
+  Result QueueFrame(uint64_t target_ns, uint64_t frame = 0,
+                    int32_t *retire_fence = NULL);
+
+  // Passes frame to the present callback at start_ns rather than at a
+  // vblank, i.e. when late composition should start. A frame scheduled
+  // before which wasn't presented yet is dropped in its favour. Returns
+  // kQueued, or kPresented if the caller should commit right away.
+  // retire_fence is set as for QueueFrame. Not counted in the stats.
+  Result ScheduleFrame(uint64_t start_ns, uint64_t frame,
+                       int32_t *retire_fence = NULL);
+
+  // Drops all queued frames, i.e. when the display turns off. They are
+  // passed to the present callback as kDropped later, unless the pacer
+  // is being destroyed.
+  void Flush();
+
+  Stats GetStats() const;
+
+ private:
+  struct Frame {
+    uint64_t target_ns = 0;
+    uint64_t id = 0;
+    // Point of timeline_ signalled once the frame retired, 0 if none.
+    uint32_t point = 0;
+  };
+
+  HWCFramePacer(const HWCFramePacer &) = delete;
+  HWCFramePacer &operator=(const HWCFramePacer &) = delete;
+
+  uint64_t PredictVblankLocked(uint64_t time_ns) const;
+  bool HasRecentVblankLocked(uint64_t now) const;
+  // Releases the newest frame due at the vblank following vblank_ns, or
+  // all frames if force is set. Returns true if one was released.
+  bool ReleaseDueFrames(uint64_t vblank_ns, bool force);
+  // Returns how long to wait for vblanks before releasing queued frames.
+  uint64_t GetWatchdogTimeoutLocked(uint64_t now) const;
+  void HandleWatchdog();
+  void HandleWork();
+  void HandleDeadline();
+  void CountLocked(Result result);
+  // Gives frame a point of timeline_ and sets retire_fence to its fence.
+  void CreateRetireFenceLocked(Frame &frame, int32_t *retire_fence);
+  // Passes frame to present_ and retires it once shown.
+  void PresentFrame(const Frame &frame, Result result);
+  // Signals the retire fence of the frame at point once all frames queued
+  // before it retired as well, the timeline can only move forward.
+  void RetireLocked(uint32_t point);
+  // Retires the frame at point once fence signals.
+  void RetireOnFence(uint32_t point, const HWCFence &fence);
+  void HandleRetired(uint32_t point);
+
+  std::unique_ptr<HWCReactor> reactor_;
+  PresentCallback present_;
+  VsyncControlCallback vsync_control_;
+  int work_event_ = -1;
+  int watchdog_ = -1;
+  int deadline_timer_ = -1;
+
+  // Queued frames, in order of their target.
+  std::vector<Frame> frames_;
+  // Frames to pass to present_ as kDropped.
+  std::vector<Frame> dropped_;
+  // Frame to be handed to present_, if release_pending_.
+  Frame pending_frame_;
+  // Frame passed to present_ once deadline_timer_ expires, if
+  // frame_scheduled_.
+  Frame scheduled_frame_;
+  bool frame_scheduled_ = false;
+  HWCSyncTimeline timeline_;
+  bool has_timeline_ = false;
+  // Last timeline point given to a frame and last one signalled.
+  uint32_t last_point_ = 0;
+  uint32_t signaled_point_ = 0;
+  // Points of retired frames waiting for earlier ones.
+  std::vector<uint32_t> retired_points_;
+  // Reactor tasks waiting for retire fences of presented frames, by point.
+  std::map<uint32_t, int> retire_tasks_;
+  Stats stats_;
+  uint64_t last_vblank_ns_ = 0;
+  uint64_t period_ns_ = 0;
+  // Result of the frame to be handed to present_, if release_pending_.
+  Result pending_result_ = kPresented;
+  bool release_pending_ = false;
+  bool vsync_wanted_ = false;
+  bool vsync_enabled_ = false;
+  uint32_t idle_vblanks_ = 0;
+  mutable SpinLock lock_;
+};
+
+// Generates vblank timestamps with a fixed period on a timer, so that
+// frame pacing can be exercised without a display.
+class HWCVsyncSimulator {
+ public:
+  typedef std::function<void(uint64_t timestamp_ns)> Callback;
+
+  HWCVsyncSimulator();
+  ~HWCVsyncSimulator();
+
+  bool Start(uint64_t period_ns, Callback callback);
+  void Stop();
+
+ private:
+  HWCVsyncSimulator(const HWCVsyncSimulator &) = delete;
+  HWCVsyncSimulator &operator=(const HWCVsyncSimulator &) = delete;
+
+  std::unique_ptr<HWCReactor> reactor_;
+  Callback callback_;
+  int timer_ = -1;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_HWCFRAMEPACER_H_
@@ -0,0 +1,338 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "hwcreactor.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+static const uint64_t kOneSecondNs = 1000 * 1000 * 1000;
+
+// epoll data of the exit event, tasks are stored as id + 1.
+static const uint64_t kExitEvent = 0;
+
+HWCReactor::Worker::Worker(HWCReactor *reactor, const char *name)
+    : HWCThread(-8, name), reactor_(reactor) {
+}
+
+HWCReactor::Worker::~Worker() {
+  Exit();
+}
+
+bool HWCReactor::Worker::Initialize() {
+  return InitWorker();
+}
+
+void HWCReactor::Worker::HandleWait() {
+  if (!stopped_) {
+    task_ = reactor_->WaitForTask();
+    if (task_ >= 0)
+      return;
+
+    stopped_ = true;
+  }
+
+  // The reactor is going away, wait for Exit.
+  HWCThread::HandleWait();
+}
+
+void HWCReactor::Worker::HandleRoutine() {
+  if (task_ < 0)
+    return;
+
+  reactor_->HandleTask(task_);
+  task_ = -1;
+}
+
+HWCReactor::HWCReactor(uint32_t max_workers, const char *name)
+    : max_workers_(max_workers), name_(name) {
+}
+
+HWCReactor::~HWCReactor() {
+  if (exit_fd_ >= 0) {
+    // exit_fd_ is never read, so it wakes up every worker.
+    uint64_t value = 1;
+    if (write(exit_fd_, &value, sizeof(value)) != sizeof(value))
+      ETRACE("Failed to signal exit to reactor %s", name_.c_str());
+  }
+
+  std::vector<std::unique_ptr<Worker>>().swap(workers_);
+
+  for (auto &task : tasks_) {
+    close(task.second->fd);
+  }
+
+  if (exit_fd_ >= 0)
+    close(exit_fd_);
+
+  if (epoll_fd_ >= 0)
+    close(epoll_fd_);
+}
+
+bool HWCReactor::Initialize() {
+  if (epoll_fd_ >= 0)
+    return true;
+
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    ETRACE("Failed to create epoll for reactor %s. %s", name_.c_str(),
+           PRINTERROR());
+    return false;
+  }
+
+  exit_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (exit_fd_ < 0) {
+    ETRACE("Failed to create exit event for reactor %s. %s", name_.c_str(),
+           PRINTERROR());
+    return false;
+  }
+
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = kExitEvent;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, exit_fd_, &event) < 0) {
+    ETRACE("Failed to watch exit event of reactor %s. %s", name_.c_str(),
+           PRINTERROR());
+    return false;
+  }
+
+  for (uint32_t i = 0; i < max_workers_; i++) {
+    std::unique_ptr<Worker> worker(new Worker(this, name_.c_str()));
+    if (!worker->Initialize()) {
+      ETRACE("Failed to initialize worker %d of reactor %s", i,
+             name_.c_str());
+      return false;
+    }
+
+    workers_.emplace_back(std::move(worker));
+  }
+
+  return true;
+}
+
+int HWCReactor::AddFd(int fd, Callback callback) {
+  if (fd < 0) {
+    ETRACE("Cannot add negative fd: %d", fd);
+    return -1;
+  }
+
+  // Tasks own their fd, so that it can be closed once no worker uses it.
+  int task_fd = dup(fd);
+  if (task_fd < 0) {
+    ETRACE("Failed to dup fd %d for reactor %s. %s", fd, name_.c_str(),
+           PRINTERROR());
+    return -1;
+  }
+
+  return AddTask(task_fd, kFd, callback);
+}
+
+int HWCReactor::AddEvent(Callback callback) {
+  int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd < 0) {
+    ETRACE("Failed to create event for reactor %s. %s", name_.c_str(),
+           PRINTERROR());
+    return -1;
+  }
+
+  return AddTask(fd, kEvent, callback);
+}
+
+int HWCReactor::AddTimer(Callback callback) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (fd < 0) {
+    ETRACE("Failed to create timer for reactor %s. %s", name_.c_str(),
+           PRINTERROR());
+    return -1;
+  }
+
+  return AddTask(fd, kTimer, callback);
+}
+
+int HWCReactor::AddTask(int fd, TaskType type, Callback callback) {
+  std::shared_ptr<Task> task(new Task());
+  task->fd = fd;
+  task->type = type;
+  task->callback = callback;
+
+  lock_.lock();
+  int id = next_task_++;
+  struct epoll_event event;
+  event.events = EPOLLIN | EPOLLONESHOT;
+  event.data.u64 = static_cast<uint64_t>(id) + 1;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+    lock_.unlock();
+    ETRACE("Failed to add fd %d to reactor %s. %s", fd, name_.c_str(),
+           PRINTERROR());
+    close(fd);
+    return -1;
+  }
+
+  tasks_.emplace(id, task);
+  lock_.unlock();
+
+  return id;
+}
+
+bool HWCReactor::SignalEvent(int id) {
+  lock_.lock();
+  auto it = tasks_.find(id);
+  if (it == tasks_.end() || it->second->type != kEvent) {
+    lock_.unlock();
+    ETRACE("Reactor %s has no event %d", name_.c_str(), id);
+    return false;
+  }
+
+  int fd = it->second->fd;
+  uint64_t value = 1;
+  bool success = write(fd, &value, sizeof(value)) == sizeof(value);
+  lock_.unlock();
+
+  return success;
+}
+
+bool HWCReactor::ArmTimer(int id, uint64_t timeout_ns, uint64_t period_ns) {
+  struct itimerspec spec;
+  spec.it_value.tv_sec = timeout_ns / kOneSecondNs;
+  spec.it_value.tv_nsec = timeout_ns % kOneSecondNs;
+  spec.it_interval.tv_sec = period_ns / kOneSecondNs;
+  spec.it_interval.tv_nsec = period_ns % kOneSecondNs;
+
+  lock_.lock();
+  auto it = tasks_.find(id);
+  if (it == tasks_.end() || it->second->type != kTimer) {
+    lock_.unlock();
+    ETRACE("Reactor %s has no timer %d", name_.c_str(), id);
+    return false;
+  }
+
+  bool success = timerfd_settime(it->second->fd, 0, &spec, NULL) == 0;
+  lock_.unlock();
+
+  return success;
+}
+
+void HWCReactor::RemoveTask(int id) {
+  lock_.lock();
+  auto it = tasks_.find(id);
+  if (it == tasks_.end()) {
+    lock_.unlock();
+    return;
+  }
+
+  std::shared_ptr<Task> task = it->second;
+  tasks_.erase(it);
+  task->removed = true;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, task->fd, NULL);
+  bool self = task->running && task->runner == std::this_thread::get_id();
+  task->close_after_run = self;
+  lock_.unlock();
+
+  if (self) {
+    // The worker closes fd once the callback returns.
+    return;
+  }
+
+  while (true) {
+    lock_.lock();
+    bool running = task->running;
+    lock_.unlock();
+    if (!running)
+      break;
+
+    std::this_thread::yield();
+  }
+
+  close(task->fd);
+}
+
+void HWCReactor::HandleTask(int id) {
+  lock_.lock();
+  auto it = tasks_.find(id);
+  if (it == tasks_.end()) {
+    lock_.unlock();
+    return;
+  }
+
+  std::shared_ptr<Task> task = it->second;
+  task->running = true;
+  task->runner = std::this_thread::get_id();
+  lock_.unlock();
+
+  if (task->type != kFd) {
+    // Clear the counter of eventfd or expirations of timerfd.
+    uint64_t value = 0;
+    if (read(task->fd, &value, sizeof(value)) != sizeof(value))
+      value = 0;
+
+    if (value != 0)
+      task->callback();
+  } else {
+    task->callback();
+  }
+
+  lock_.lock();
+  task->running = false;
+  if (task->removed) {
+    bool close_fd = task->close_after_run;
+    lock_.unlock();
+    if (close_fd)
+      close(task->fd);
+
+    return;
+  }
+
+  struct epoll_event event;
+  event.events = EPOLLIN | EPOLLONESHOT;
+  event.data.u64 = static_cast<uint64_t>(id) + 1;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, task->fd, &event) < 0) {
+    ETRACE("Failed to re-arm task %d of reactor %s. %s", id, name_.c_str(),
+           PRINTERROR());
+  }
+  lock_.unlock();
+}
+
+int HWCReactor::WaitForTask() {
+  while (true) {
+    struct epoll_event event;
+    int ret = epoll_wait(epoll_fd_, &event, 1, -1);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+
+      ETRACE("epoll_wait failed in reactor %s. %s", name_.c_str(),
+             PRINTERROR());
+      return -1;
+    }
+
+    if (ret == 0)
+      continue;
+
+    if (event.data.u64 == kExitEvent)
+      return -1;
+
+    return static_cast<int>(event.data.u64 - 1);
+  }
+}
+
+}  // namespace hwcomposer
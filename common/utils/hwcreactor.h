@@ -0,0 +1,119 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_HWCREACTOR_H_
+#define COMMON_UTILS_HWCREACTOR_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hwcthread.h"
+#include "spinlock.h"
+
+namespace hwcomposer {
+
+// Runs callbacks for file descriptors, timers and events registered by
+// components on a small set of shared worker threads, instead of each
+// component polling on a thread of its own. Callbacks of one task never
+// run concurrently, callbacks of different tasks may run in parallel if
+// there is more than one worker.
+class HWCReactor {
+ public:
+  typedef std::function<void()> Callback;
+
+  HWCReactor(uint32_t max_workers, const char *name);
+  ~HWCReactor();
+
+  bool Initialize();
+
+  // Runs callback whenever fd is readable. The callback is responsible
+  // for reading from fd. Returns id of the task or -1 in case of failure.
+  int AddFd(int fd, Callback callback);
+
+  // Runs callback once every time the event is signalled with
+  // SignalEvent. Returns id of the task or -1 in case of failure.
+  int AddEvent(Callback callback);
+
+  // Runs callback when the timer armed with ArmTimer expires. Returns id
+  // of the task or -1 in case of failure.
+  int AddTimer(Callback callback);
+
+  bool SignalEvent(int task);
+
+  // Arms timer to expire after timeout_ns and then every period_ns, if
+  // period_ns is non zero. A zero timeout_ns disarms the timer.
+  bool ArmTimer(int task, uint64_t timeout_ns, uint64_t period_ns);
+
+  // Unregisters task. If its callback is running on another thread, waits
+  // for it to complete. Can be called from the callback of the task.
+  void RemoveTask(int task);
+
+ private:
+  enum TaskType { kFd = 0, kEvent = 1, kTimer = 2 };
+
+  struct Task {
+    int fd = -1;
+    TaskType type = kFd;
+    Callback callback;
+    bool running = false;
+    bool removed = false;
+    // Set if the task was removed from its own callback.
+    bool close_after_run = false;
+    std::thread::id runner;
+  };
+
+  // Waits for a task on epoll_fd_ on behalf of a worker thread.
+  class Worker : public HWCThread {
+   public:
+    Worker(HWCReactor *reactor, const char *name);
+    ~Worker() override;
+
+    bool Initialize();
+
+   protected:
+    void HandleWait() override;
+    void HandleRoutine() override;
+
+   private:
+    HWCReactor *reactor_;
+    int task_ = -1;
+    bool stopped_ = false;
+  };
+
+  int AddTask(int fd, TaskType type, Callback callback);
+  // Returns id of the next task ready to run or -1 once the reactor is
+  // being destroyed.
+  int WaitForTask();
+  void HandleTask(int id);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::map<int, std::shared_ptr<Task>> tasks_;
+  uint32_t max_workers_;
+  int epoll_fd_ = -1;
+  int exit_fd_ = -1;
+  int next_task_ = 0;
+  std::string name_;
+  SpinLock lock_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_HWCREACTOR_H_
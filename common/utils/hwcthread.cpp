@@ -17,9 +17,8 @@
 #include "hwcthread.h"
 
 #include <sys/prctl.h>
-#include <sys/time.h>
-#include <sys/resource.h>
 
+#include "hwcthreadscheduler.h"
 #include "hwctrace.h"
 
 namespace hwcomposer {
@@ -84,18 +83,21 @@ void HWCThread::HandleWait() {
 }
 
 void HWCThread::ProcessThread() {
-  setpriority(PRIO_PROCESS, 0, priority_);
+  HWCThreadScheduler::AttachThread(name_, priority_);
   prctl(PR_SET_NAME, name_.c_str());
 
+  HWCThreadScheduler::Stats stats;
   while (1) {
     HandleWait();
     if (exit_) {
       HandleExit();
       fd_handler_.RemoveFd(event_.get_fd());
+      HWCThreadScheduler::DetachThread();
       return;
     }
 
     HandleRoutine();
+    HWCThreadScheduler::UpdateStats(name_, stats);
   }
 }
 
@@ -0,0 +1,211 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "hwcthreadscheduler.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hwctrace.h"
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+namespace hwcomposer {
+
+std::map<pid_t, HWCThreadScheduler::Thread> HWCThreadScheduler::threads_;
+std::map<std::string, HWCThreadPolicy> HWCThreadScheduler::policies_;
+SpinLock HWCThreadScheduler::lock_;
+
+#ifdef __NR_sched_setattr
+// Layout of struct sched_attr, which libc does not provide.
+struct SchedAttr {
+  uint32_t size;
+  uint32_t sched_policy;
+  uint64_t sched_flags;
+  int32_t sched_nice;
+  uint32_t sched_priority;
+  uint64_t sched_runtime;
+  uint64_t sched_deadline;
+  uint64_t sched_period;
+};
+#endif
+
+static pid_t GetThreadId() {
+  return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+void HWCThreadScheduler::SetPolicy(const std::string &name,
+                                   const HWCThreadPolicy &policy) {
+  lock_.lock();
+  policies_[name] = policy;
+  for (auto &thread : threads_) {
+    if (thread.second.name == name)
+      Apply(thread.first, thread.second, &policy);
+  }
+  lock_.unlock();
+}
+
+void HWCThreadScheduler::AttachThread(const std::string &name,
+                                      int default_nice) {
+  pid_t tid = GetThreadId();
+  lock_.lock();
+  Thread &thread = threads_[tid];
+  thread.name = name;
+  thread.default_nice = default_nice;
+  auto it = policies_.find(name);
+  Apply(tid, thread, it != policies_.end() ? &it->second : NULL);
+  lock_.unlock();
+}
+
+void HWCThreadScheduler::DetachThread() {
+  pid_t tid = GetThreadId();
+  lock_.lock();
+  threads_.erase(tid);
+  lock_.unlock();
+}
+
+void HWCThreadScheduler::Apply(pid_t tid, const Thread &thread,
+                               const HWCThreadPolicy *policy) {
+  int nice = thread.default_nice;
+  if (!policy) {
+    setpriority(PRIO_PROCESS, tid, nice);
+    return;
+  }
+
+  if (policy->has_nice)
+    nice = policy->nice;
+
+  if (policy->affinity_mask) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (uint32_t cpu = 0; cpu < 64; cpu++) {
+      if (policy->affinity_mask & (1ULL << cpu))
+        CPU_SET(cpu, &cpus);
+    }
+
+    if (sched_setaffinity(tid, sizeof(cpus), &cpus) < 0) {
+      ETRACE("Failed to set affinity 0x%llx of %s. %s",
+             static_cast<unsigned long long>(policy->affinity_mask),
+             thread.name.c_str(), PRINTERROR());
+    }
+  }
+
+  bool realtime = false;
+  switch (policy->policy) {
+    case HWCThreadPolicy::kFifo:
+    case HWCThreadPolicy::kRoundRobin: {
+      struct sched_param param;
+      param.sched_priority = policy->rt_priority;
+      int sched_policy =
+          policy->policy == HWCThreadPolicy::kFifo ? SCHED_FIFO : SCHED_RR;
+      realtime = sched_setscheduler(tid, sched_policy, &param) == 0;
+      break;
+    }
+    case HWCThreadPolicy::kDeadline: {
+#ifdef __NR_sched_setattr
+      SchedAttr attr;
+      attr.size = sizeof(attr);
+      attr.sched_policy = SCHED_DEADLINE;
+      attr.sched_flags = 0;
+      attr.sched_nice = 0;
+      attr.sched_priority = 0;
+      attr.sched_runtime = policy->runtime_ns;
+      attr.sched_deadline = policy->deadline_ns;
+      attr.sched_period = policy->period_ns;
+      realtime = syscall(__NR_sched_setattr, tid, &attr, 0) == 0;
+#else
+      errno = ENOSYS;
+#endif
+      break;
+    }
+    default: {
+      // Drop any real-time policy set by a previous configuration.
+      struct sched_param param;
+      param.sched_priority = 0;
+      sched_setscheduler(tid, SCHED_OTHER, &param);
+      break;
+    }
+  }
+
+  if (!realtime && policy->policy != HWCThreadPolicy::kNormal) {
+    // Most likely CAP_SYS_NICE is missing or the deadline parameters were
+    // rejected by admission control. Keep running with nice value.
+    ETRACE("Failed to set real-time policy of %s, using nice %d. %s",
+           thread.name.c_str(), nice, PRINTERROR());
+  }
+
+  if (!realtime && setpriority(PRIO_PROCESS, tid, nice) < 0) {
+    ETRACE("Failed to set nice %d of %s. %s", nice, thread.name.c_str(),
+           PRINTERROR());
+  }
+}
+
+void HWCThreadScheduler::UpdateStats(const std::string &name,
+                                     Stats &stats) {
+#ifdef ENABLE_THREAD_SCHEDULING_TRACING
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t now_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000 +
+                    static_cast<uint64_t>(now.tv_nsec);
+  if (now_ns - stats.last_dump_ns < 1000000000)
+    return;
+
+  // Needs CONFIG_SCHED_INFO. Fields are time spent on cpu, time spent
+  // waiting on a runqueue and number of timeslices run on this cpu.
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat",
+           GetThreadId());
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return;
+
+  unsigned long long run_ns = 0;
+  unsigned long long run_delay_ns = 0;
+  unsigned long long timeslices = 0;
+  int fields = fscanf(file, "%llu %llu %llu", &run_ns, &run_delay_ns,
+                      &timeslices);
+  fclose(file);
+  if (fields != 3)
+    return;
+
+  if (stats.last_dump_ns != 0) {
+    uint64_t delay = run_delay_ns - stats.run_delay_ns;
+    uint64_t slices = timeslices - stats.timeslices;
+    ITHREADSCHEDULINGTRACE(
+        "%s: %llu timeslices, scheduling latency %llu us total, %llu us avg",
+        name.c_str(), static_cast<unsigned long long>(slices),
+        static_cast<unsigned long long>(delay / 1000),
+        static_cast<unsigned long long>(slices ? delay / slices / 1000 : 0));
+  }
+
+  stats.last_dump_ns = now_ns;
+  stats.run_delay_ns = run_delay_ns;
+  stats.timeslices = timeslices;
+#else
+  (void)name;
+  (void)stats;
+#endif
+}
+
+}  // namespace hwcomposer
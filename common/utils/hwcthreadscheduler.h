@@ -0,0 +1,90 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_HWCTHREADSCHEDULER_H_
+#define COMMON_UTILS_HWCTHREADSCHEDULER_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+
+#include "spinlock.h"
+
+namespace hwcomposer {
+
+struct HWCThreadPolicy {
+  enum Policy { kNormal = 0, kFifo = 1, kRoundRobin = 2, kDeadline = 3 };
+
+  Policy policy = kNormal;
+  // Priority of kFifo and kRoundRobin.
+  uint32_t rt_priority = 0;
+  // Parameters of kDeadline.
+  uint64_t runtime_ns = 0;
+  uint64_t deadline_ns = 0;
+  uint64_t period_ns = 0;
+  // Nice value used for kNormal and whenever the real-time policy cannot
+  // be applied (i.e. missing CAP_SYS_NICE).
+  bool has_nice = false;
+  int nice = 0;
+  // CPUs the thread may run on, 0 leaves affinity unchanged.
+  uint64_t affinity_mask = 0;
+};
+
+// Applies scheduling settings to HWC threads. Settings are keyed by the
+// name the thread was created with, so that every thread of a role (i.e.
+// all "VblankEventHandler" threads) shares them.
+class HWCThreadScheduler {
+ public:
+  // Per thread scheduling statistics, owned by the thread itself.
+  struct Stats {
+    uint64_t last_dump_ns = 0;
+    uint64_t run_delay_ns = 0;
+    uint64_t timeslices = 0;
+  };
+
+  // Sets settings of all threads named |name|, including already running
+  // ones.
+  static void SetPolicy(const std::string &name,
+                        const HWCThreadPolicy &policy);
+
+  // Called by a thread when it starts. Applies the settings of |name| or
+  // default_nice if there are none.
+  static void AttachThread(const std::string &name, int default_nice);
+  static void DetachThread();
+
+  // Traces the time the calling thread spent runnable but waiting for a
+  // CPU since the previous call, at most once per second. Only does work
+  // if ENABLE_THREAD_SCHEDULING_TRACING is set.
+  static void UpdateStats(const std::string &name, Stats &stats);
+
+ private:
+  struct Thread {
+    std::string name;
+    int default_nice = 0;
+  };
+
+  static void Apply(pid_t tid, const Thread &thread,
+                    const HWCThreadPolicy *policy);
+
+  static std::map<pid_t, Thread> threads_;
+  static std::map<std::string, HWCThreadPolicy> policies_;
+  static SpinLock lock_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_HWCTHREADSCHEDULER_H_
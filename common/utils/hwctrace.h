@@ -44,6 +44,7 @@ extern "C" {
 // #define SURFACE_BASIC_TRACING 1
 // #define COMPOSITOR_TRACING 1
 // #define RECT_DAMAGE_TRACING 1
+// #define ENABLE_THREAD_SCHEDULING_TRACING 1
 
 // Function call tracing
 #ifdef FUNCTION_CALL_TRACING
@@ -137,6 +138,12 @@ class TraceFunc {
 #define ISURFACETRACE(fmt, ...) ((void)0)
 #endif
 
+#ifdef ENABLE_THREAD_SCHEDULING_TRACING
+#define ITHREADSCHEDULINGTRACE ITRACE
+#else
+#define ITHREADSCHEDULINGTRACE(fmt, ...) ((void)0)
+#endif
+
 // Errors
 #define PRINTERROR() strerror(-errno)
 
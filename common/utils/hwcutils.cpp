@@ -17,7 +17,9 @@
 #include "hwcutils.h"
 
 #include <poll.h>
+#include <time.h>
 
+#include "hwcformats.h"
 #include "hwctrace.h"
 
 #include <drm_fourcc.h>
@@ -37,6 +39,13 @@ int HWCPoll(int fd, int timeout) {
   return ret;
 }
 
+uint64_t GetMonotonicTimeNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 +
+         static_cast<uint64_t>(now.tv_nsec);
+}
+
 void ResetRectToRegion(const HwcRegion& hwc_region, HwcRect<int>& rect) {
   size_t total_rects = hwc_region.size();
   if (total_rects == 0) {
@@ -95,53 +104,59 @@ void CalculateSourceRect(const HwcRect<float>& target_rect,
   new_rect.bottom = std::max(target_rect.bottom, new_rect.bottom);
 }
 
-bool IsSupportedMediaFormat(uint32_t format) {
-  switch (format) {
-    case DRM_FORMAT_NV12:
-    case DRM_FORMAT_NV16:
-    case DRM_FORMAT_P010:
-    case DRM_FORMAT_YVU420:
-    case DRM_FORMAT_YUV420:
-    case DRM_FORMAT_YUV422:
-    case DRM_FORMAT_YUV444:
-    case DRM_FORMAT_UYVY:
-    case DRM_FORMAT_YUYV:
-    case DRM_FORMAT_YVYU:
-    case DRM_FORMAT_VYUY:
-    case DRM_FORMAT_AYUV:
-    case DRM_FORMAT_NV12_Y_TILED_INTEL:
-    case DRM_FORMAT_NV21:
-    case DRM_FORMAT_YVU420_ANDROID:
-      return true;
-    default:
-      break;
-  }
+// Sanity checks of the format table, every entry is verified at compile
+// time.
+static constexpr bool IsValidFormatInfo(const HwcFormatInfo& info) {
+  return info.planes >= 1 && info.planes <= 3 && info.cpp[0] > 0 &&
+         (info.planes > 1) == (info.cpp[1] > 0) &&
+         (info.planes > 2) == (info.cpp[2] > 0) && info.hsub >= 1 &&
+         info.vsub >= 1 &&
+         (info.is_yuv || (info.planes == 1 && info.hsub == 1 &&
+                          info.vsub == 1 && !info.y_tiled)) &&
+         (info.is_yuv || !info.is_media) &&
+         GetFormatInfo(info.native_format) != nullptr &&
+         GetFormatInfo(info.native_format)->native_format ==
+             info.native_format &&
+         GetFormatInfo(info.native_format)->planes == info.planes;
+}
 
-  return false;
+static constexpr bool IsValidFormatTable(size_t index = 0) {
+  return index == kHwcFormatsSize ||
+         (IsValidFormatInfo(kHwcFormats[index]) &&
+          GetFormatInfo(kHwcFormats[index].format) == &kHwcFormats[index] &&
+          IsValidFormatTable(index + 1));
 }
 
-uint32_t GetTotalPlanesForFormat(uint32_t format) {
-  switch (format) {
-    case DRM_FORMAT_NV12:
-    case DRM_FORMAT_NV16:
-    case DRM_FORMAT_P010:
-      return 2;
-    case DRM_FORMAT_YVU420:
-    case DRM_FORMAT_YUV420:
-    case DRM_FORMAT_YUV422:
-    case DRM_FORMAT_YUV444:
-      return 3;
-    case DRM_FORMAT_UYVY:
-    case DRM_FORMAT_YUYV:
-    case DRM_FORMAT_YVYU:
-    case DRM_FORMAT_VYUY:
-    case DRM_FORMAT_AYUV:
-      return 1;
-    default:
-      break;
-  }
+static_assert(IsValidFormatTable(), "Invalid or duplicate format entry");
+static_assert(GetFormatInfo(DRM_FORMAT_NONE) == nullptr, "Unknown format");
+static_assert(GetFormatPlaneLineSize(*GetFormatInfo(DRM_FORMAT_NV12), 1,
+                                     1920) == 1920 &&
+                  GetFormatPlaneHeight(*GetFormatInfo(DRM_FORMAT_NV12), 1,
+                                       1080) == 540,
+              "NV12 chroma layout");
+static_assert(GetFormatPlaneLineSize(*GetFormatInfo(DRM_FORMAT_P010), 1,
+                                     1920) == 3840,
+              "P010 chroma layout");
+static_assert(GetFormatPlaneLineSize(*GetFormatInfo(DRM_FORMAT_YUV420), 2,
+                                     101) == 51 &&
+                  GetFormatPlaneHeight(*GetFormatInfo(DRM_FORMAT_YUV420), 2,
+                                       101) == 51,
+              "YUV420 odd size chroma layout");
+static_assert(GetFormatPlaneHeight(*GetFormatInfo(DRM_FORMAT_NV16), 1, 1080) ==
+                  1080,
+              "NV16 chroma layout");
+static_assert(GetFormatPlaneLineSize(*GetFormatInfo(DRM_FORMAT_RGB888), 0,
+                                     10) == 30,
+              "RGB888 layout");
 
-  return 1;
+bool IsSupportedMediaFormat(uint32_t format) {
+  const HwcFormatInfo* info = GetFormatInfo(format);
+  return info && info->is_media;
+}
+
+uint32_t GetTotalPlanesForFormat(uint32_t format) {
+  const HwcFormatInfo* info = GetFormatInfo(format);
+  return info ? info->planes : 1;
 }
 
 std::string StringifyRect(HwcRect<int> rect) {
@@ -0,0 +1,120 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "hwcworkerpool.h"
+
+#include <algorithm>
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+HWCWorkerPool::Worker::Worker(HWCWorkerPool *pool, const char *name)
+    : HWCThread(-8, name), pool_(pool) {
+}
+
+HWCWorkerPool::Worker::~Worker() {
+}
+
+bool HWCWorkerPool::Worker::Initialize() {
+  if (!done_.Initialize())
+    return false;
+
+  return InitWorker();
+}
+
+void HWCWorkerPool::Worker::Kick() {
+  Resume();
+}
+
+void HWCWorkerPool::Worker::WaitForCompletion() {
+  done_.Wait();
+}
+
+void HWCWorkerPool::Worker::HandleRoutine() {
+  pool_->Drain();
+  done_.Signal();
+}
+
+HWCWorkerPool::HWCWorkerPool(uint32_t max_workers, const char *name)
+    : max_workers_(max_workers), name_(name) {
+}
+
+HWCWorkerPool::~HWCWorkerPool() {
+  std::vector<std::unique_ptr<Worker>>().swap(workers_);
+}
+
+bool HWCWorkerPool::Initialize() {
+  if (!workers_.empty())
+    return true;
+
+  for (uint32_t i = 0; i < max_workers_; i++) {
+    std::unique_ptr<Worker> worker(new Worker(this, name_.c_str()));
+    if (!worker->Initialize()) {
+      ETRACE("Failed to initialize worker %d of pool %s", i, name_.c_str());
+      std::vector<std::unique_ptr<Worker>>().swap(workers_);
+      return false;
+    }
+
+    workers_.emplace_back(std::move(worker));
+  }
+
+  return true;
+}
+
+void HWCWorkerPool::Run(const std::vector<std::function<void()>> &tasks) {
+  size_t total = tasks.size();
+  if (total == 0)
+    return;
+
+  lock_.lock();
+  tasks_ = &tasks;
+  next_task_ = 0;
+  lock_.unlock();
+
+  // The calling thread picks up one task itself, so there is no point in
+  // waking up more workers than there are remaining tasks.
+  size_t active = std::min(workers_.size(), total - 1);
+  for (size_t i = 0; i < active; i++) {
+    workers_.at(i)->Kick();
+  }
+
+  Drain();
+
+  for (size_t i = 0; i < active; i++) {
+    workers_.at(i)->WaitForCompletion();
+  }
+
+  lock_.lock();
+  tasks_ = NULL;
+  lock_.unlock();
+}
+
+void HWCWorkerPool::Drain() {
+  while (true) {
+    lock_.lock();
+    if (!tasks_ || next_task_ >= tasks_->size()) {
+      lock_.unlock();
+      return;
+    }
+
+    const std::function<void()> &task = tasks_->at(next_task_++);
+    lock_.unlock();
+    task();
+  }
+}
+
+}  // namespace hwcomposer
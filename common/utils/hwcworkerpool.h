@@ -0,0 +1,82 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_HWCWORKERPOOL_H_
+#define COMMON_UTILS_HWCWORKERPOOL_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hwcevent.h"
+#include "hwcthread.h"
+#include "spinlock.h"
+
+namespace hwcomposer {
+
+// A bounded set of worker threads used to fan out a fixed list of tasks
+// and join on them. The calling thread takes part in running the tasks,
+// so a pool of N workers runs at most N + 1 tasks at a time. Tasks are
+// always started in index order.
+class HWCWorkerPool {
+ public:
+  HWCWorkerPool(uint32_t max_workers, const char *name);
+  ~HWCWorkerPool();
+
+  bool Initialize();
+
+  // Runs all tasks and returns once every one of them has completed.
+  // Must only be called from one thread at a time.
+  void Run(const std::vector<std::function<void()>> &tasks);
+
+  uint32_t GetMaxWorkers() const {
+    return workers_.size();
+  }
+
+ private:
+  class Worker : public HWCThread {
+   public:
+    Worker(HWCWorkerPool *pool, const char *name);
+    ~Worker() override;
+
+    bool Initialize();
+    void Kick();
+    void WaitForCompletion();
+
+   protected:
+    void HandleRoutine() override;
+
+   private:
+    HWCWorkerPool *pool_;
+    HWCEvent done_;
+  };
+
+  // Runs tasks until none are left to be started.
+  void Drain();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  const std::vector<std::function<void()>> *tasks_ = NULL;
+  uint32_t max_workers_;
+  uint32_t next_task_ = 0;
+  std::string name_;
+  SpinLock lock_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_HWCWORKERPOOL_H_
@@ -106,6 +106,13 @@ inline uint32_t GetNativeBuffer(uint32_t gpu_fd, HWCNativeHandle handle) {
   return id;
 }
 
+inline bool GetNativeBufferImportKey(HWCNativeHandle handle,
+                                     BufferImportKey* key) {
+  // Layout of a yalloc buffer is fixed at allocation, so the dma-buf
+  // identity of the first plane is enough to tell buffers apart.
+  return GetDmaBufIdentity(handle->target_->fds.data[0], key);
+}
+
 inline bool IsBufferProtected(HWCNativeHandle handle) {
   native_array_t* attrib_array = &native_handle->target_->attributes;
   if (attrib_array->data[4] & YALLOC_FLAG_PROTECTED) {
@@ -69,6 +69,13 @@ inline uint32_t GetNativeBuffer(uint32_t gpu_fd, HWCNativeHandle handle) {
   return id;
 }
 
+inline bool GetNativeBufferImportKey(HWCNativeHandle handle,
+                                     BufferImportKey* key) {
+  // Layout of a gralloc buffer is fixed at allocation, so the dma-buf
+  // identity of the first plane is enough to tell buffers apart.
+  return GetDmaBufIdentity(handle->handle_->data[0], key);
+}
+
 inline bool IsBufferProtected(HWCNativeHandle handle) {
   auto gr_handle = (const struct cros_gralloc_handle*)handle->handle_;
   if (gr_handle->consumer_usage & GRALLOC1_PRODUCER_USAGE_PROTECTED) {
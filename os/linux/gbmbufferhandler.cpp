@@ -86,6 +86,9 @@ bool GbmBufferHandler::CreateBuffer(uint32_t w, uint32_t h, int format,
                                     uint32_t layer_type, bool *modifier_used,
                                     int64_t preferred_modifier,
                                     bool raw_pixel_buffer) const {
+  // Displays of a Mosaic might be presented in parallel, serialize access
+  // to the gbm device.
+  ScopedSpinLock lock(lock_);
   uint32_t gbm_format = format;
   if (gbm_format == 0)
     gbm_format = GBM_FORMAT_XRGB8888;
@@ -190,6 +193,7 @@ bool GbmBufferHandler::CreateBuffer(uint32_t w, uint32_t h, int format,
 }
 
 bool GbmBufferHandler::ReleaseBuffer(HWCNativeHandle handle) const {
+  ScopedSpinLock lock(lock_);
   if (handle->bo || handle->imported_bo) {
     if (handle->bo && handle->hwc_buffer_) {
       gbm_bo_destroy(handle->bo);
@@ -270,6 +274,7 @@ bool GbmBufferHandler::ImportBuffer(HWCNativeHandle handle) const {
   bool use_modifier = true;
   uint64_t mod = 0;
 
+  ScopedSpinLock lock(lock_);
   if (!handle->imported_bo) {
     if (!handle->meta_data_.fb_modifiers_[0]) {
       use_modifier = false;
@@ -20,6 +20,7 @@
 #include <gbm.h>
 
 #include <nativebufferhandler.h>
+#include <spinlock.h>
 
 namespace hwcomposer {
 
@@ -58,6 +59,7 @@ class GbmBufferHandler : public NativeBufferHandler {
   struct gbm_device *device_;
   uint64_t preferred_cursor_width_;
   uint64_t preferred_cursor_height_;
+  mutable SpinLock lock_;
 };
 
 }  // namespace hwcomposer
@@ -24,6 +24,9 @@
 #define IAHWC_MODULE IAHWC_MODULE_INFO
 #define IAHWC_MODULE_STR "IAHWC_MODULE_INFO"
 
+// Version of iahwc_layer_state_t. New fields are only ever appended.
+#define IAHWC_LAYER_STATE_VERSION 1
+
 typedef void (*iahwc_function_ptr_t)();
 typedef uint32_t iahwc_display_t;
 typedef uint32_t iahwc_layer_t;
@@ -105,6 +108,10 @@ enum iahwc_function_descriptors {
   IAHWC_FUNC_LAYER_SET_SURFACE_DAMAGE,
   IAHWC_FUNC_LAYER_SET_PLANE_ALPHA,
   IAHWC_FUNC_LAYER_SET_INDEX,
+  IAHWC_FUNC_PRESENT_DISPLAY_AT,
+  IAHWC_FUNC_DISPLAY_GET_PRESENT_STATS,
+  IAHWC_FUNC_DISPLAY_SET_LAYER_STATES,
+  IAHWC_FUNC_DISPLAY_SET_LATE_COMPOSITION,
 };
 
 enum iahwc_callback_descriptor {
@@ -129,6 +136,19 @@ enum iahwc_layer_transform {
   IAHWC_TRANSFORM_FLIP_V_ROT_90
 };
 
+enum iahwc_present_result {
+  IAHWC_PRESENT_PRESENTED,
+  IAHWC_PRESENT_LATE,
+  IAHWC_PRESENT_DROPPED,
+  IAHWC_PRESENT_QUEUED
+};
+
+typedef struct iahwc_present_stats {
+  uint64_t presented;
+  uint64_t late;
+  uint64_t dropped;
+} iahwc_present_stats_t;
+
 typedef struct iahwc_rect {
   uint32_t left;
   uint32_t top;
@@ -141,6 +161,36 @@ typedef struct iahwc_region {
   iahwc_rect_t const* rects;
 } iahwc_region_t;
 
+// Fields of iahwc_layer_state_t to apply.
+enum iahwc_layer_state_fields {
+  IAHWC_LAYER_STATE_BO = 1 << 0,
+  IAHWC_LAYER_STATE_ACQUIRE_FENCE = 1 << 1,
+  IAHWC_LAYER_STATE_USAGE = 1 << 2,
+  IAHWC_LAYER_STATE_TRANSFORM = 1 << 3,
+  IAHWC_LAYER_STATE_SOURCE_CROP = 1 << 4,
+  IAHWC_LAYER_STATE_DISPLAY_FRAME = 1 << 5,
+  IAHWC_LAYER_STATE_SURFACE_DAMAGE = 1 << 6,
+  IAHWC_LAYER_STATE_PLANE_ALPHA = 1 << 7,
+  IAHWC_LAYER_STATE_INDEX = 1 << 8,
+};
+
+// State of one layer for IAHWC_FUNC_DISPLAY_SET_LAYER_STATES. Only the
+// fields in valid are applied, with the same semantics as the matching
+// IAHWC_FUNC_LAYER_SET_* call.
+typedef struct iahwc_layer_state {
+  iahwc_layer_t layer;
+  uint32_t valid;
+  struct gbm_bo* bo;
+  int32_t acquire_fence;
+  int32_t usage;
+  int32_t transform;
+  iahwc_rect_t source_crop;
+  iahwc_rect_t display_frame;
+  iahwc_region_t surface_damage;
+  float plane_alpha;
+  uint32_t index;
+} iahwc_layer_state_t;
+
 typedef int (*IAHWC_PFN_GET_NUM_DISPLAYS)(iahwc_device_t*, int* num_displays);
 typedef int (*IAHWC_PFN_REGISTER_CALLBACK)(iahwc_device_t*, int descriptor,
                                            iahwc_display_t display_handle,
@@ -224,6 +274,42 @@ typedef int (*IAHWC_PFN_LAYER_SET_INDEX)(iahwc_device_t*,
                                          iahwc_display_t display_handle,
                                          iahwc_layer_t layer_handle,
                                          uint32_t layer_index);
+// Presents the current layers at the vblank closest to target_timestamp
+// (CLOCK_MONOTONIC, ns). If that is the next vblank, the layers are
+// presented right away. Otherwise the frame is queued, result is
+// IAHWC_PRESENT_QUEUED, and it is presented from the vblank before its
+// target with the layer state at the time of the call: buffers, acquire
+// fences and geometry. Layers showing raw pixel data show the latest
+// upload. release_fd of a queued frame signals once it is shown or
+// dropped, it is -1 without sw_sync, and its buffers must be kept until
+// then. A queued frame superseded by a newer one due at the same vblank
+// is not presented, this is counted in IAHWC_FUNC_DISPLAY_GET_PRESENT_STATS.
+typedef int (*IAHWC_PFN_PRESENT_DISPLAY_AT)(iahwc_device_t*,
+                                            iahwc_display_t display_handle,
+                                            int64_t target_timestamp,
+                                            int32_t* release_fd,
+                                            int32_t* result);
+typedef int (*IAHWC_PFN_DISPLAY_GET_PRESENT_STATS)(
+    iahwc_device_t*, iahwc_display_t display_handle,
+    iahwc_present_stats_t* stats);
+// Updates num_states layers in one call. version is the
+// IAHWC_LAYER_STATE_VERSION and state_size the sizeof(iahwc_layer_state_t)
+// the caller was built with, states are state_size bytes apart. States of
+// unknown layers are skipped, their acquire fences closed, and
+// IAHWC_ERROR_BAD_LAYER is returned once all other states have been
+// applied.
+typedef int (*IAHWC_PFN_DISPLAY_SET_LAYER_STATES)(
+    iahwc_device_t*, iahwc_display_t display_handle, uint32_t version,
+    uint32_t state_size, uint32_t num_states,
+    const iahwc_layer_state_t* states);
+// Enables or disables late composition, where composition of a frame is
+// delayed until just before the vblank it can flip at. Overrides
+// LATE_COMPOSITION of hwc_display.ini for the display. Then
+// IAHWC_FUNC_PRESENT_DISPLAY returns right away and the frame shows the
+// layer state set until its deadline. release_fd signals once it is shown
+// or replaced by a later present, it is -1 without sw_sync.
+typedef int (*IAHWC_PFN_DISPLAY_SET_LATE_COMPOSITION)(
+    iahwc_device_t*, iahwc_display_t display_handle, uint32_t enable);
 typedef int (*IAHWC_PFN_VSYNC)(iahwc_callback_data_t data,
                                iahwc_display_t display, int64_t timestamp);
 typedef int (*IAHWC_PFN_PIXEL_UPLOADER)(iahwc_callback_data_t data,
@@ -18,6 +18,8 @@
 #include <commondrmutils.h>
 #include <hwcrect.h>
 
+#include <algorithm>
+
 #include "nativebufferhandler.h"
 
 #include "pixeluploader.h"
@@ -26,11 +28,13 @@ namespace hwcomposer {
 
 class IAHWCVsyncCallback : public hwcomposer::VsyncCallback {
  public:
-  IAHWCVsyncCallback(iahwc_callback_data_t data, iahwc_function_ptr_t hook)
-      : data_(data), hook_(hook) {
+  IAHWCVsyncCallback(iahwc_callback_data_t data, iahwc_function_ptr_t hook,
+                     HWCFramePacer* frame_pacer)
+      : data_(data), hook_(hook), frame_pacer_(frame_pacer) {
   }
 
   void Callback(uint32_t display, int64_t timestamp) {
+    frame_pacer_->OnVblank(timestamp);
     if (hook_ != NULL) {
       auto hook = reinterpret_cast<IAHWC_PFN_VSYNC>(hook_);
       hook(data_, display, timestamp);
@@ -40,6 +44,7 @@ class IAHWCVsyncCallback : public hwcomposer::VsyncCallback {
  private:
   iahwc_callback_data_t data_;
   iahwc_function_ptr_t hook_;
+  HWCFramePacer* frame_pacer_;
 };
 
 class IAPixelUploaderCallback : public hwcomposer::RawPixelUploadCallback {
@@ -176,6 +181,24 @@ iahwc_function_ptr_t IAHWC::HookGetFunctionPtr(iahwc_device_t* /* device */,
       return ToHook<IAHWC_PFN_PRESENT_DISPLAY>(
           DisplayHook<decltype(&IAHWCDisplay::PresentDisplay),
                       &IAHWCDisplay::PresentDisplay, int32_t*>);
+    case IAHWC_FUNC_PRESENT_DISPLAY_AT:
+      return ToHook<IAHWC_PFN_PRESENT_DISPLAY_AT>(
+          DisplayHook<decltype(&IAHWCDisplay::PresentDisplayAt),
+                      &IAHWCDisplay::PresentDisplayAt, int64_t, int32_t*,
+                      int32_t*>);
+    case IAHWC_FUNC_DISPLAY_GET_PRESENT_STATS:
+      return ToHook<IAHWC_PFN_DISPLAY_GET_PRESENT_STATS>(
+          DisplayHook<decltype(&IAHWCDisplay::GetPresentStats),
+                      &IAHWCDisplay::GetPresentStats, iahwc_present_stats_t*>);
+    case IAHWC_FUNC_DISPLAY_SET_LAYER_STATES:
+      return ToHook<IAHWC_PFN_DISPLAY_SET_LAYER_STATES>(
+          DisplayHook<decltype(&IAHWCDisplay::SetLayerStates),
+                      &IAHWCDisplay::SetLayerStates, uint32_t, uint32_t,
+                      uint32_t, const iahwc_layer_state_t*>);
+    case IAHWC_FUNC_DISPLAY_SET_LATE_COMPOSITION:
+      return ToHook<IAHWC_PFN_DISPLAY_SET_LATE_COMPOSITION>(
+          DisplayHook<decltype(&IAHWCDisplay::SetLateComposition),
+                      &IAHWCDisplay::SetLateComposition, uint32_t>);
     case IAHWC_FUNC_DISABLE_OVERLAY_USAGE:
       return ToHook<IAHWC_PFN_DISABLE_OVERLAY_USAGE>(
           DisplayHook<decltype(&IAHWCDisplay::DisableOverlayUsage),
@@ -289,15 +312,31 @@ IAHWC::IAHWCDisplay::IAHWCDisplay() : native_display_(NULL) {
 }
 
 IAHWC::IAHWCDisplay::~IAHWCDisplay() {
+  // Stops the pacer thread before the layers it presents go away.
+  frame_pacer_.reset();
+  // Layers release their buffers through raw_data_uploader_.
+  std::vector<LayerSlot>().swap(layer_slots_);
   delete raw_data_uploader_;
 }
 
 int IAHWC::IAHWCDisplay::Init(hwcomposer::NativeDisplay* display,
                               uint32_t gpu_fd) {
   native_display_ = display;
-  native_display_->InitializeLayerHashGenerator(4);
   raw_data_uploader_ =
       new PixelUploader(native_display_->GetNativeBufferHandler());
+  frame_pacer_.reset(new HWCFramePacer());
+  if (!frame_pacer_->Initialize(
+          [this](HWCFramePacer::Result result, uint64_t frame) {
+            return PresentQueuedFrame(result, frame);
+          },
+          [this](bool enabled) {
+            ScopedSpinLock lock(lock_);
+            paced_vsync_ = enabled;
+            UpdateVsyncControl();
+          })) {
+    ETRACE("Unable to initialize frame pacer, presents won't be paced.");
+  }
+
   return 0;
 }
 
@@ -340,6 +379,9 @@ int IAHWC::IAHWCDisplay::GetDisplayConfigs(uint32_t* num_configs,
 }
 
 int IAHWC::IAHWCDisplay::SetPowerMode(uint32_t power_mode) {
+  if (power_mode == hwcomposer::kOff)
+    frame_pacer_->Flush();
+
   native_display_->SetPowerMode(power_mode);
 
   return IAHWC_ERROR_NONE;
@@ -369,33 +411,184 @@ int IAHWC::IAHWCDisplay::GetDisplayConfig(uint32_t* config) {
 }
 
 int IAHWC::IAHWCDisplay::ClearAllLayers() {
-  layers_.clear();
-  native_display_->ResetLayerHashGenerator();
+  uint32_t size = layer_slots_.size();
+  for (uint32_t i = 0; i < size; i++) {
+    if (layer_slots_.at(i).layer)
+      FreeLayerSlot(i);
+  }
 
   return IAHWC_ERROR_NONE;
 }
 int IAHWC::IAHWCDisplay::PresentDisplay(int32_t* release_fd) {
+  // In late composition mode the frame is presented from the frame pacer
+  // thread at its deadline, so that it shows the layer state of then.
+  // Hooks must not wait for it, they hold lock_.
+  uint64_t deadline = native_display_->GetCompositionDeadline();
+  if (deadline) {
+    uint64_t frame = ++last_frame_id_;
+    if (frame_pacer_->ScheduleFrame(deadline, frame, release_fd) ==
+        HWCFramePacer::kQueued) {
+      QueuedFrame queued;
+      queued.id = frame;
+      queued.late_composition = true;
+      queued_frames_.emplace_back(std::move(queued));
+      return IAHWC_ERROR_NONE;
+    }
+  }
+
+  PresentLayers(release_fd);
+
+  return IAHWC_ERROR_NONE;
+}
+
+void IAHWC::IAHWCDisplay::PresentLayers(int32_t* release_fd) {
   std::vector<hwcomposer::HwcLayer*> layers;
   /*
    * Here the assumption is that the layer index set by the compositor
    * is numbered from bottom -> top, i.e. the bottom most layer has the
    * index of 0 and increases upwards.
    */
-  uint32_t total_layers = layers_.size();
+  uint32_t total_layers = total_layers_;
   layers.resize(total_layers);
   total_layers -= 1;
 
-  for (std::pair<const iahwc_layer_t, IAHWCLayer>& l : layers_) {
-    IAHWCLayer& temp = l.second;
-    uint32_t layer_index = total_layers - temp.GetLayerIndex();
-    layers[layer_index] = temp.GetLayer();
+  for (LayerSlot& slot : layer_slots_) {
+    if (!slot.layer)
+      continue;
+
+    uint32_t layer_index = total_layers - slot.layer->GetLayerIndex();
+    layers[layer_index] = slot.layer->GetLayer();
   }
 
   native_display_->Present(layers, release_fd, this);
+}
+
+int IAHWC::IAHWCDisplay::PresentDisplayAt(int64_t target_timestamp,
+                                          int32_t* release_fd,
+                                          int32_t* result) {
+  if (!vsync_registered_) {
+    int ret = UpdateVsyncCallback();
+    if (ret)
+      return ret;
+  }
+
+  if (!frame_pacer_->GetRefreshPeriod()) {
+    uint32_t config = 0;
+    int32_t refresh_rate = 0;
+    if (native_display_->GetActiveConfig(&config) &&
+        native_display_->GetDisplayAttribute(
+            config, hwcomposer::HWCDisplayAttribute::kRefreshRate,
+            &refresh_rate) &&
+        refresh_rate > 0) {
+      frame_pacer_->SetRefreshPeriod(1000000000ULL / refresh_rate);
+    }
+  }
+
+  uint64_t target = target_timestamp > 0 ? target_timestamp : 0;
+  uint64_t frame = ++last_frame_id_;
+  switch (frame_pacer_->QueueFrame(target, frame, release_fd)) {
+    case HWCFramePacer::kQueued: {
+      QueuedFrame queued;
+      queued.id = frame;
+      for (uint32_t i = 0; i < layer_slots_.size(); i++) {
+        LayerSlot& slot = layer_slots_.at(i);
+        if (!slot.layer)
+          continue;
+
+        queued.layers.emplace_back(slot.layer->TakeSnapshot());
+        queued.layers.back().handle = (slot.generation << kLayerSlotBits) | i;
+      }
+
+      // The pacer calls back on its own thread, which waits for lock_.
+      queued_frames_.emplace_back(std::move(queued));
+      *result = IAHWC_PRESENT_QUEUED;
+      return IAHWC_ERROR_NONE;
+    }
+    case HWCFramePacer::kDropped:
+      *release_fd = -1;
+      *result = IAHWC_PRESENT_DROPPED;
+      return IAHWC_ERROR_NONE;
+    case HWCFramePacer::kLate:
+      *result = IAHWC_PRESENT_LATE;
+      break;
+    case HWCFramePacer::kPresented:
+      *result = IAHWC_PRESENT_PRESENTED;
+      break;
+  }
+
+  PresentLayers(release_fd);
+
+  return IAHWC_ERROR_NONE;
+}
+
+int32_t IAHWC::IAHWCDisplay::PresentQueuedFrame(HWCFramePacer::Result result,
+                                                uint64_t frame) {
+  ScopedSpinLock lock(lock_);
+  auto it = std::find_if(
+      queued_frames_.begin(), queued_frames_.end(),
+      [frame](const QueuedFrame& queued) { return queued.id == frame; });
+  if (it == queued_frames_.end())
+    return -1;
+
+  // Acquire fences of a dropped frame are closed with it.
+  QueuedFrame queued = std::move(*it);
+  queued_frames_.erase(it);
+  if (result == HWCFramePacer::kDropped)
+    return -1;
+
+  int32_t retire_fence = -1;
+  if (queued.late_composition) {
+    PresentLayers(&retire_fence);
+    return retire_fence;
+  }
+
+  // Puts the frame's state on the layers for the commit and the current
+  // one back afterwards. Layers destroyed meanwhile are left out.
+  std::vector<IAHWCLayer::Snapshot> current;
+  std::vector<IAHWCLayer*> layers;
+  for (IAHWCLayer::Snapshot& snapshot : queued.layers) {
+    IAHWCLayer* layer = get_layer(snapshot.handle);
+    if (!layer)
+      continue;
+
+    current.emplace_back(layer->TakeSnapshot());
+    current.back().handle = snapshot.handle;
+    layer->ApplySnapshot(snapshot);
+    layers.emplace_back(layer);
+  }
+
+  // Same order as PresentDisplay, top most layer first.
+  std::stable_sort(layers.begin(), layers.end(),
+                   [](IAHWCLayer* a, IAHWCLayer* b) {
+                     return a->GetLayerIndex() > b->GetLayerIndex();
+                   });
+  std::vector<hwcomposer::HwcLayer*> hwc_layers;
+  for (IAHWCLayer* layer : layers) {
+    hwc_layers.emplace_back(layer->GetLayer());
+  }
+
+  native_display_->Present(hwc_layers, &retire_fence, this);
+  for (IAHWCLayer::Snapshot& snapshot : current) {
+    get_layer(snapshot.handle)->ApplySnapshot(snapshot);
+  }
+
+  return retire_fence;
+}
+
+int IAHWC::IAHWCDisplay::GetPresentStats(iahwc_present_stats_t* stats) {
+  HWCFramePacer::Stats pacer_stats = frame_pacer_->GetStats();
+  stats->presented = pacer_stats.presented;
+  stats->late = pacer_stats.late;
+  stats->dropped = pacer_stats.dropped;
 
   return IAHWC_ERROR_NONE;
 }
 
+int IAHWC::IAHWCDisplay::SetLateComposition(uint32_t enable) {
+  native_display_->SetLateComposition(enable != 0);
+  return IAHWC_ERROR_NONE;
+}
+
 int IAHWC::IAHWCDisplay::DisableOverlayUsage() {
   native_display_->SetDisableExplicitSync(false);
   return 0;
@@ -428,34 +621,113 @@ int IAHWC::IAHWCDisplay::RunPixelUploader(bool enable) {
 }
 
 int IAHWC::IAHWCDisplay::CreateLayer(uint32_t* layer_handle) {
-  *layer_handle = native_display_->AcquireId();
-  layers_.emplace(*layer_handle, IAHWCLayer(raw_data_uploader_));
+  uint32_t index;
+  if (!free_layer_slots_.empty()) {
+    index = free_layer_slots_.back();
+    free_layer_slots_.pop_back();
+  } else {
+    index = layer_slots_.size();
+    if (index > kLayerSlotMask)
+      return IAHWC_ERROR_NO_RESOURCES;
+
+    layer_slots_.emplace_back();
+  }
+
+  LayerSlot& slot = layer_slots_.at(index);
+  slot.layer.reset(new IAHWCLayer(raw_data_uploader_));
+  total_layers_++;
+  *layer_handle = (slot.generation << kLayerSlotBits) | index;
 
   return IAHWC_ERROR_NONE;
 }
 
 int IAHWC::IAHWCDisplay::DestroyLayer(uint32_t layer_handle) {
-  if (layers_.empty())
-    return IAHWC_ERROR_NONE;
-
-  if (layers_.erase(layer_handle))
-    native_display_->ReleaseId(layer_handle);
+  if (get_layer(layer_handle))
+    FreeLayerSlot(layer_handle & kLayerSlotMask);
 
   return IAHWC_ERROR_NONE;
 }
 
+void IAHWC::IAHWCDisplay::FreeLayerSlot(uint32_t index) {
+  LayerSlot& slot = layer_slots_.at(index);
+  slot.layer.reset();
+  // Generation 0 is skipped, so that 0 is never a valid handle.
+  slot.generation = (slot.generation + 1) & kLayerSlotMask;
+  if (!slot.generation)
+    slot.generation = 1;
+
+  free_layer_slots_.emplace_back(index);
+  total_layers_--;
+}
+
+int IAHWC::IAHWCDisplay::SetLayerStates(uint32_t version, uint32_t state_size,
+                                        uint32_t num_states,
+                                        const iahwc_layer_state_t* states) {
+  // Size of iahwc_layer_state_t in each version, indexed by version.
+  static const size_t kLayerStateSizes[] = {0, sizeof(iahwc_layer_state_t)};
+  static_assert(sizeof(kLayerStateSizes) / sizeof(kLayerStateSizes[0]) ==
+                    IAHWC_LAYER_STATE_VERSION + 1,
+                "Add the size of the new iahwc_layer_state_t version");
+  if (version == 0 || version > IAHWC_LAYER_STATE_VERSION ||
+      state_size < kLayerStateSizes[version]) {
+    return IAHWC_ERROR_UNSUPPORTED;
+  }
+
+  // Callers built against a newer header pass bigger states, fields we
+  // don't know about are ignored. Older callers leave the new ones zero.
+  size_t copy_size = std::min<size_t>(state_size, sizeof(iahwc_layer_state_t));
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(states);
+  int ret = IAHWC_ERROR_NONE;
+  for (uint32_t i = 0; i < num_states; i++) {
+    iahwc_layer_state_t state;
+    memset(&state, 0, sizeof(state));
+    memcpy(&state, data + static_cast<size_t>(i) * state_size, copy_size);
+    IAHWCLayer* layer = get_layer(state.layer);
+    if (!layer) {
+      // The fence was handed over to us either way.
+      if ((state.valid & IAHWC_LAYER_STATE_ACQUIRE_FENCE) &&
+          state.acquire_fence > 0) {
+        ::close(state.acquire_fence);
+      }
+
+      ret = IAHWC_ERROR_BAD_LAYER;
+      continue;
+    }
+
+    int status = layer->SetLayerState(state);
+    if (status != IAHWC_ERROR_NONE)
+      ret = status;
+  }
+
+  return ret;
+}
+
 int IAHWC::IAHWCDisplay::RegisterVsyncCallback(iahwc_callback_data_t data,
                                                iahwc_function_ptr_t hook) {
-  auto callback = std::make_shared<IAHWCVsyncCallback>(data, hook);
-  native_display_->VSyncControl(true);
+  ScopedSpinLock lock(lock_);
+  vsync_data_ = data;
+  vsync_hook_ = hook;
+  UpdateVsyncControl();
+  return UpdateVsyncCallback();
+}
+
+int IAHWC::IAHWCDisplay::UpdateVsyncCallback() {
+  auto callback = std::make_shared<IAHWCVsyncCallback>(
+      vsync_data_, vsync_hook_, frame_pacer_.get());
   int ret = native_display_->RegisterVsyncCallback(std::move(callback),
                                                    static_cast<int>(0));
   if (ret) {
     return IAHWC_ERROR_BAD_DISPLAY;
   }
+
+  vsync_registered_ = true;
   return IAHWC_ERROR_NONE;
 }
 
+void IAHWC::IAHWCDisplay::UpdateVsyncControl() {
+  native_display_->VSyncControl(vsync_hook_ != NULL || paced_vsync_);
+}
+
 void IAHWC::IAHWCDisplay::RegisterPixelUploaderCallback(
     iahwc_callback_data_t data, iahwc_function_ptr_t hook) {
   auto callback = std::make_shared<IAPixelUploaderCallback>(data, hook, 0);
@@ -517,6 +789,7 @@ int IAHWC::IAHWCLayer::SetBo(gbm_bo* bo) {
   hwc_handle_.meta_data_.num_planes_ =
       drm_bo_get_num_planes(hwc_handle_.import_data.fd_data.format);
 
+  bo_ = bo;
   hwc_handle_.bo = bo;
   hwc_handle_.hwc_buffer_ = true;
   hwc_handle_.gbm_flags = 0;
@@ -530,6 +803,7 @@ int IAHWC::IAHWCLayer::SetRawPixelData(iahwc_raw_pixel_data bo) {
   const NativeBufferHandler* buffer_handler =
       raw_data_uploader_->GetNativeBufferHandler();
   ClosePrimeHandles();
+  bo_ = NULL;
   if (pixel_buffer_ &&
       ((orig_height_ != bo.height) || (orig_stride_ != bo.stride))) {
     if (upload_in_progress_) {
@@ -610,6 +884,7 @@ int IAHWC::IAHWCLayer::SetLayerTransform(int32_t layer_transform) {
   // already contain both horizontal and vertical flips, so those fields are
   // redundant in this case. 90* rotation can be combined with either horizontal
   // flip or vertical flip, so treat it differently
+  transform_ = layer_transform;
   int32_t temp = 0;
   if (layer_transform == IAHWC_TRANSFORM_ROT_270) {
     temp = hwcomposer::HWCTransform::kTransform270;
@@ -629,6 +904,7 @@ int IAHWC::IAHWCLayer::SetLayerTransform(int32_t layer_transform) {
 }
 
 int IAHWC::IAHWCLayer::SetLayerSourceCrop(iahwc_rect_t rect) {
+  source_crop_ = rect;
   iahwc_layer_.SetSourceCrop(
       hwcomposer::HwcRect<float>(rect.left, rect.top, rect.right, rect.bottom));
 
@@ -636,6 +912,7 @@ int IAHWC::IAHWCLayer::SetLayerSourceCrop(iahwc_rect_t rect) {
 }
 
 int IAHWC::IAHWCLayer::SetLayerDisplayFrame(iahwc_rect_t rect) {
+  display_frame_ = rect;
   iahwc_layer_.SetDisplayFrame(
       hwcomposer::HwcRect<float>(rect.left, rect.top, rect.right, rect.bottom),
       0, 0);
@@ -646,6 +923,7 @@ int IAHWC::IAHWCLayer::SetLayerDisplayFrame(iahwc_rect_t rect) {
 int IAHWC::IAHWCLayer::SetLayerSurfaceDamage(iahwc_region_t region) {
   uint32_t num_rects = region.numRects;
   hwcomposer::HwcRegion hwc_region;
+  surface_damage_.assign(region.rects, region.rects + num_rects);
 
   for (size_t rect = 0; rect < num_rects; ++rect) {
     hwc_region.emplace_back(region.rects[rect].left, region.rects[rect].top,
@@ -659,6 +937,7 @@ int IAHWC::IAHWCLayer::SetLayerSurfaceDamage(iahwc_region_t region) {
 }
 
 int IAHWC::IAHWCLayer::SetLayerPlaneAlpha(float alpha) {
+  plane_alpha_ = alpha;
   iahwc_layer_.SetAlpha(alpha);
   if (alpha != 1.0) {
     iahwc_layer_.SetBlending(HWCBlending::kBlendingPremult);
@@ -673,10 +952,75 @@ int IAHWC::IAHWCLayer::SetLayerIndex(uint32_t layer_index) {
   return IAHWC_ERROR_NONE;
 }
 
+int IAHWC::IAHWCLayer::SetLayerState(const iahwc_layer_state_t& state) {
+  int ret = IAHWC_ERROR_NONE;
+  // Usage first, changing it drops the current pixel buffer.
+  if (state.valid & IAHWC_LAYER_STATE_USAGE)
+    SetLayerUsage(state.usage);
+
+  if (state.valid & IAHWC_LAYER_STATE_BO)
+    ret = SetBo(state.bo);
+
+  if (state.valid & IAHWC_LAYER_STATE_ACQUIRE_FENCE)
+    SetAcquireFence(state.acquire_fence);
+
+  if (state.valid & IAHWC_LAYER_STATE_TRANSFORM)
+    SetLayerTransform(state.transform);
+
+  if (state.valid & IAHWC_LAYER_STATE_SOURCE_CROP)
+    SetLayerSourceCrop(state.source_crop);
+
+  if (state.valid & IAHWC_LAYER_STATE_DISPLAY_FRAME)
+    SetLayerDisplayFrame(state.display_frame);
+
+  if (state.valid & IAHWC_LAYER_STATE_SURFACE_DAMAGE)
+    SetLayerSurfaceDamage(state.surface_damage);
+
+  if (state.valid & IAHWC_LAYER_STATE_PLANE_ALPHA)
+    SetLayerPlaneAlpha(state.plane_alpha);
+
+  if (state.valid & IAHWC_LAYER_STATE_INDEX)
+    SetLayerIndex(state.index);
+
+  return ret;
+}
+
 hwcomposer::HwcLayer* IAHWC::IAHWCLayer::GetLayer() {
   return &iahwc_layer_;
 }
 
+IAHWC::IAHWCLayer::Snapshot IAHWC::IAHWCLayer::TakeSnapshot() {
+  Snapshot snapshot;
+  snapshot.bo = bo_;
+  snapshot.transform = transform_;
+  snapshot.source_crop = source_crop_;
+  snapshot.display_frame = display_frame_;
+  snapshot.surface_damage = surface_damage_;
+  snapshot.plane_alpha = plane_alpha_;
+  snapshot.index = layer_index_;
+  snapshot.acquire_fence.Reset(iahwc_layer_.GetAcquireFence());
+
+  return snapshot;
+}
+
+void IAHWC::IAHWCLayer::ApplySnapshot(Snapshot& snapshot) {
+  // Importing a bo again would create new prime handles. A layer which
+  // switched to raw pixel data keeps showing it.
+  if (snapshot.bo && snapshot.bo != bo_ && !pixel_buffer_)
+    SetBo(snapshot.bo);
+
+  SetLayerTransform(snapshot.transform);
+  SetLayerSourceCrop(snapshot.source_crop);
+  SetLayerDisplayFrame(snapshot.display_frame);
+  iahwc_region_t region;
+  region.numRects = snapshot.surface_damage.size();
+  region.rects = snapshot.surface_damage.data();
+  SetLayerSurfaceDamage(region);
+  SetLayerPlaneAlpha(snapshot.plane_alpha);
+  SetLayerIndex(snapshot.index);
+  SetAcquireFence(snapshot.acquire_fence.Release());
+}
+
 void IAHWC::IAHWCLayer::ClosePrimeHandles() {
   if (hwc_handle_.import_data.fd_data.fd > 0) {
     ::close(hwc_handle_.import_data.fd_data.fd);
@@ -20,9 +20,11 @@
 #include <gpudevice.h>
 #include <hwcdefs.h>
 #include <hwclayer.h>
-#include <map>
+#include <memory>
 #include <type_traits>
 #include <vector>
+#include "hwcfence.h"
+#include "hwcframepacer.h"
 #include "iahwc.h"
 #include "pixeluploader.h"
 #include "spinlock.h"
@@ -39,6 +41,20 @@ class IAHWC : public iahwc_device {
 
   class IAHWCLayer : public PixelUploaderLayerCallback {
    public:
+    // State of the layer as set by the client, kept for a queued frame
+    // until it is presented. Raw pixel data is not part of it.
+    struct Snapshot {
+      iahwc_layer_t handle = 0;
+      gbm_bo* bo = NULL;
+      int32_t transform = 0;
+      iahwc_rect_t source_crop = {0, 0, 0, 0};
+      iahwc_rect_t display_frame = {0, 0, 0, 0};
+      std::vector<iahwc_rect_t> surface_damage;
+      float plane_alpha = 1.0;
+      uint32_t index = 0;
+      HWCFence acquire_fence;
+    };
+
     IAHWCLayer(PixelUploader* uploader);
     ~IAHWCLayer() override;
     int SetBo(gbm_bo* bo);
@@ -54,16 +70,29 @@ class IAHWC : public iahwc_device {
     int SetLayerSurfaceDamage(iahwc_region_t region);
     int SetLayerPlaneAlpha(float alpha);
     int SetLayerIndex(uint32_t layer_index);
+    // Applies the fields of state marked valid.
+    int SetLayerState(const iahwc_layer_state_t& state);
     uint32_t GetLayerIndex() {
       return layer_index_;
     }
     hwcomposer::HwcLayer* GetLayer();
 
+    // Takes the current state, including the acquire fence.
+    Snapshot TakeSnapshot();
+    void ApplySnapshot(Snapshot& snapshot);
+
     void UploadDone() override;
 
    private:
     void ClosePrimeHandles();
     hwcomposer::HwcLayer iahwc_layer_;
+    // Last values set by the client, for snapshots.
+    gbm_bo* bo_ = NULL;
+    int32_t transform_ = 0;
+    iahwc_rect_t source_crop_ = {0, 0, 0, 0};
+    iahwc_rect_t display_frame_ = {0, 0, 0, 0};
+    std::vector<iahwc_rect_t> surface_damage_;
+    float plane_alpha_ = 1.0;
     struct gbm_handle hwc_handle_;
     HWCNativeHandle pixel_buffer_ = NULL;
     uint32_t orig_width_ = 0;
@@ -90,17 +119,33 @@ class IAHWC : public iahwc_device {
     int SetPowerMode(uint32_t power_mode);
     int ClearAllLayers();
     int PresentDisplay(int32_t* release_fd);
+    int PresentDisplayAt(int64_t target_timestamp, int32_t* release_fd,
+                         int32_t* result);
+    int GetPresentStats(iahwc_present_stats_t* stats);
     int RegisterVsyncCallback(iahwc_callback_data_t data,
                               iahwc_function_ptr_t hook);
     void RegisterPixelUploaderCallback(iahwc_callback_data_t data,
                                        iahwc_function_ptr_t hook);
     int CreateLayer(uint32_t* layer_handle);
     int DestroyLayer(uint32_t layer_handle);
+    int SetLayerStates(uint32_t version, uint32_t state_size,
+                       uint32_t num_states, const iahwc_layer_state_t* states);
     bool IsConnected();
-    IAHWCLayer& get_layer(iahwc_layer_t layer) {
-      return layers_.at(layer);
+    // Returns NULL if layer was destroyed or never created.
+    IAHWCLayer* get_layer(iahwc_layer_t layer) {
+      uint32_t index = layer & kLayerSlotMask;
+      if (index >= layer_slots_.size())
+        return NULL;
+
+      LayerSlot& slot = layer_slots_[index];
+      if ((layer >> kLayerSlotBits) != slot.generation)
+        return NULL;
+
+      return slot.layer.get();
     }
 
+    int SetLateComposition(uint32_t enable);
+
     int DisableOverlayUsage();
 
     int EnableOverlayUsage();
@@ -111,10 +156,59 @@ class IAHWC : public iahwc_device {
                                 iahwc_function_ptr_t func);
     int RunPixelUploader(bool enable);
 
+    // Serializes hooks with presents of queued frames, which happen on
+    // the frame pacer thread.
+    SpinLock& GetLock() {
+      return lock_;
+    }
+
    private:
+    // A frame queued in frame_pacer_, with the layer state it was queued
+    // with. Frames scheduled for late composition show the layer state
+    // of the time they are presented instead.
+    struct QueuedFrame {
+      uint64_t id = 0;
+      bool late_composition = false;
+      std::vector<IAHWCLayer::Snapshot> layers;
+    };
+
+    // Layers are kept in slots which are reused once a layer is destroyed.
+    // Handles carry the slot index in their low bits and the generation
+    // of the slot in the high ones, so that a stale handle doesn't reach
+    // the next layer in the same slot.
+    struct LayerSlot {
+      std::unique_ptr<IAHWCLayer> layer;
+      uint32_t generation = 1;
+    };
+
+    static const uint32_t kLayerSlotBits = 16;
+    static const uint32_t kLayerSlotMask = (1u << kLayerSlotBits) - 1;
+
+    int UpdateVsyncCallback();
+    void UpdateVsyncControl();
+    // Presents the layers of frame, unless result is kDropped, and
+    // returns the retire fence of the commit.
+    int32_t PresentQueuedFrame(HWCFramePacer::Result result, uint64_t frame);
+    // Presents the current state of all layers.
+    void PresentLayers(int32_t* release_fd);
+    void FreeLayerSlot(uint32_t index);
+
     PixelUploader* raw_data_uploader_ = NULL;
     hwcomposer::NativeDisplay* native_display_;
-    std::map<iahwc_layer_t, IAHWCLayer> layers_;
+    // Vblanks are needed for paced presents even if the client did not
+    // register for them, so the callback always feeds frame_pacer_.
+    std::unique_ptr<HWCFramePacer> frame_pacer_;
+    std::vector<QueuedFrame> queued_frames_;
+    uint64_t last_frame_id_ = 0;
+    iahwc_callback_data_t vsync_data_ = NULL;
+    iahwc_function_ptr_t vsync_hook_ = NULL;
+    bool vsync_registered_ = false;
+    // Set while frame_pacer_ needs vblanks.
+    bool paced_vsync_ = false;
+    SpinLock lock_;
+    std::vector<LayerSlot> layer_slots_;
+    std::vector<uint32_t> free_layer_slots_;
+    uint32_t total_layers_ = 0;
   };
 
   static IAHWC* toIAHWC(iahwc_device_t* dev) {
@@ -142,6 +236,7 @@ class IAHWC : public iahwc_device {
                              iahwc_display_t display_handle, Args... args) {
     IAHWC* hwc = toIAHWC(dev);
     IAHWCDisplay* display = hwc->displays_.at(display_handle);
+    ScopedSpinLock lock(display->GetLock());
     return static_cast<int32_t>((display->*func)(std::forward<Args>(args)...));
   }
 
@@ -150,9 +245,12 @@ class IAHWC : public iahwc_device {
                            iahwc_layer_t layer_handle, Args... args) {
     IAHWC* hwc = toIAHWC(dev);
     IAHWCDisplay* display = hwc->displays_.at(display_handle);
-    IAHWCLayer& layer = display->get_layer(layer_handle);
+    ScopedSpinLock lock(display->GetLock());
+    IAHWCLayer* layer = display->get_layer(layer_handle);
+    if (!layer)
+      return IAHWC_ERROR_BAD_LAYER;
 
-    return static_cast<int32_t>((layer.*func)(std::forward<Args>(args)...));
+    return static_cast<int32_t>((layer->*func)(std::forward<Args>(args)...));
   }
 
  private:
@@ -18,6 +18,7 @@
 
 #include "displayplanemanager.h"
 #include "framebuffermanager.h"
+#include "hwcformats.h"
 #include "hwctrace.h"
 #include "hwcutils.h"
 #include "nativegpuresource.h"
@@ -159,7 +160,11 @@ void PixelUploader::HandleRawPixelUpdate() {
     uint32_t prime_fd = buffer.handle_->meta_data_.prime_fds_[0];
 
     uint32_t mapStride = buffer.original_stride_;
-    uint32_t bpp = mapStride / buffer.original_width_;
+    // Stride can be padded, only fall back to guessing bpp from it for
+    // formats we don't know about.
+    const HwcFormatInfo* info =
+        GetFormatInfo(buffer.handle_->meta_data_.format_);
+    uint32_t bpp = info ? info->cpp[0] : mapStride / buffer.original_width_;
     uint32_t x1 = buffer.surfaceDamage.left, y1 = buffer.surfaceDamage.top;
     uint32_t x2 = buffer.surfaceDamage.right, y2 = buffer.surfaceDamage.bottom;
     uint32_t startx = x1 * bpp;
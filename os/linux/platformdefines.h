@@ -77,6 +77,27 @@ inline uint32_t GetNativeBuffer(uint32_t gpu_fd, HWCNativeHandle handle) {
   return id;
 }
 
+inline bool GetNativeBufferImportKey(HWCNativeHandle handle,
+                                     BufferImportKey* key) {
+  int prime_fd = -1;
+  if (!handle->meta_data_.fb_modifiers_[0]) {
+    prime_fd = handle->import_data.fd_data.fd;
+    key->format_ = handle->import_data.fd_data.format;
+  } else {
+    const struct gbm_import_fd_modifier_data& data =
+        handle->import_data.fd_modifier_data;
+    prime_fd = data.fds[0];
+    key->format_ = data.format;
+    key->modifier_ = data.modifier;
+    for (uint32_t i = 0; i < data.num_fds && i < 4; i++) {
+      key->offsets_[i] = data.offsets[i];
+    }
+  }
+
+  key->flags_ = handle->gbm_flags | (handle->layer_type_ << 16);
+  return GetDmaBufIdentity(prime_fd, key);
+}
+
 inline bool IsBufferProtected(HWCNativeHandle handle) {
   return false;
 }
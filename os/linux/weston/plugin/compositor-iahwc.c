@@ -137,6 +137,7 @@ struct iahwc_backend {
   IAHWC_PFN_LAYER_SET_ACQUIRE_FENCE iahwc_layer_set_acquire_fence;
   IAHWC_PFN_LAYER_SET_USAGE iahwc_layer_set_usage;
   IAHWC_PFN_LAYER_SET_INDEX iahwc_layer_set_index;
+  IAHWC_PFN_DISPLAY_SET_LAYER_STATES iahwc_display_set_layer_states;
 
   int sprites_are_broken;
   int sprites_hidden;
@@ -180,6 +181,8 @@ struct iahwc_overlay {
   uint32_t overlay_layer_id;
   uint32_t layer_index;
   struct weston_surface *es;
+  struct wl_listener surface_destroy_listener;
+  bool in_use;
 };
 
 struct iahwc_output {
@@ -212,7 +215,6 @@ struct iahwc_output {
   struct wl_event_source *release_fence_source;
   struct iahwc_spinlock spin_lock;
   struct timespec last_vsync_ts;
-  uint32_t total_layers;
 
   enum dpms_enum current_dpms;
 };
@@ -543,41 +545,62 @@ static int init_egl(struct iahwc_backend *b) {
   return 0;
 }
 
+/* Damage with more rectangles than this is sent as its extents. */
+#define IAHWC_MAX_DAMAGE_RECTS 16
+
 /**
- * Return's overlay which is showing layer with index layer_index.
+ * Return's overlay which is showing surface es.
  */
 static struct iahwc_overlay *iahwc_get_existing_plane(
-    struct iahwc_output *output, uint32_t layer_index) {
+    struct iahwc_output *output, struct weston_surface *es) {
   struct iahwc_overlay *ps;
 
   wl_list_for_each(ps, &output->overlay_list, link) {
-    if (ps->layer_index == layer_index)
+    if (ps->es == es)
       return ps;
   }
 
   return NULL;
 }
 
+/**
+ * Forget the surface once it's gone, the overlay is cleaned up with the
+ * other unused ones during the next repaint.
+ */
+static void iahwc_overlay_handle_surface_destroy(struct wl_listener *listener,
+                                                 void *data) {
+  struct iahwc_overlay *plane =
+      container_of(listener, struct iahwc_overlay, surface_destroy_listener);
+
+  wl_list_remove(&plane->surface_destroy_listener.link);
+  plane->es = NULL;
+}
+
 /**
  * Add Overlay information to the list managed by the output.
  */
-static void iahwc_add_overlay_info(struct iahwc_overlay *plane,
-                                   struct iahwc_output *output,
-                                   struct wl_shm_buffer *shm_memory,
-                                   struct gbm_bo *overlay_bo,
-                                   uint32_t overlay_layer_id,
-                                   uint32_t layer_index,
-                                   struct weston_surface *es) {
+static struct iahwc_overlay *iahwc_add_overlay_info(
+    struct iahwc_overlay *plane, struct iahwc_output *output,
+    struct wl_shm_buffer *shm_memory, struct gbm_bo *overlay_bo,
+    uint32_t overlay_layer_id, struct weston_surface *es) {
   if (!plane) {
     plane = zalloc(sizeof *plane);
     if (!plane) {
       weston_log("%s: out of memory\n", __func__);
-      return;
+      return NULL;
     }
 
     wl_list_insert(&output->overlay_list, &plane->link);
+    plane->es = es;
+    plane->surface_destroy_listener.notify =
+        iahwc_overlay_handle_surface_destroy;
+    wl_signal_add(&es->destroy_signal, &plane->surface_destroy_listener);
   }
 
+  // The layer already uses the new buffer, the previous bo can go.
+  if (plane->overlay_bo && plane->overlay_bo != overlay_bo)
+    gbm_bo_destroy(plane->overlay_bo);
+
   if (shm_memory) {
     plane->shm_memory = shm_memory;
     plane->overlay_bo = 0;
@@ -587,30 +610,76 @@ static void iahwc_add_overlay_info(struct iahwc_overlay *plane,
   }
 
   plane->overlay_layer_id = overlay_layer_id;
-  plane->layer_index = layer_index;
-  plane->es = es;
+  return plane;
 }
 
 /**
- * Clean up output overlay lists.
+ * Clean up output overlay lists. With unused_only, only overlays whose
+ * surface wasn't shown in the current repaint are destroyed.
  */
 static void iahwc_overlay_destroy(struct iahwc_output *output,
-                                  uint32_t starting_index) {
+                                  bool unused_only) {
   struct iahwc_overlay *plane, *next;
   struct iahwc_backend *b = to_iahwc_backend(output->base.compositor);
 
   wl_list_for_each_safe(plane, next, &output->overlay_list, link) {
-    if (plane->layer_index >= starting_index) {
-      b->iahwc_destroy_layer(b->iahwc_device, 0, plane->overlay_layer_id);
-      if (plane->overlay_bo)
-        gbm_bo_destroy(plane->overlay_bo);
+    if (unused_only && plane->in_use)
+      continue;
 
-      wl_list_remove(&plane->link);
-      free(plane);
-    }
+    b->iahwc_destroy_layer(b->iahwc_device, 0, plane->overlay_layer_id);
+    if (plane->overlay_bo)
+      gbm_bo_destroy(plane->overlay_bo);
+
+    if (plane->es)
+      wl_list_remove(&plane->surface_destroy_listener.link);
+
+    wl_list_remove(&plane->link);
+    free(plane);
   }
 }
 
+/**
+ * Describe every rectangle of damage in region, so that only the damaged
+ * parts of the surface are recomposited. rects needs room for
+ * IAHWC_MAX_DAMAGE_RECTS.
+ */
+static void iahwc_fill_damage_region(pixman_region32_t *damage,
+                                     iahwc_rect_t *rects,
+                                     iahwc_region_t *region) {
+  pixman_box32_t *boxes;
+  int n_boxes, i;
+
+  boxes = pixman_region32_rectangles(damage, &n_boxes);
+  if (n_boxes > IAHWC_MAX_DAMAGE_RECTS) {
+    boxes = pixman_region32_extents(damage);
+    n_boxes = 1;
+  }
+
+  for (i = 0; i < n_boxes; i++) {
+    rects[i].left = boxes[i].x1;
+    rects[i].top = boxes[i].y1;
+    rects[i].right = boxes[i].x2;
+    rects[i].bottom = boxes[i].y2;
+  }
+
+  region->numRects = n_boxes;
+  region->rects = rects;
+}
+
+/**
+ * Apply the changes collected in state with a single call.
+ */
+static void iahwc_flush_layer_state(struct iahwc_backend *b,
+                                    iahwc_layer_state_t *state) {
+  if (!state->valid)
+    return;
+
+  b->iahwc_display_set_layer_states(b->iahwc_device, 0,
+                                    IAHWC_LAYER_STATE_VERSION, sizeof(*state),
+                                    1, state);
+  state->valid = 0;
+}
+
 static struct weston_plane *iahwc_output_prepare_overlay_view(
     struct iahwc_output *output, struct weston_view *ev, uint32_t layer_index) {
   struct weston_compositor *ec = output->base.compositor;
@@ -632,51 +701,54 @@ static struct weston_plane *iahwc_output_prepare_overlay_view(
   float x, y;
 
   uint32_t overlay_layer_id;
+  iahwc_layer_state_t state;
+  iahwc_rect_t damage_rects[IAHWC_MAX_DAMAGE_RECTS];
   if (ev->surface->buffer_ref.buffer == NULL) {
     return NULL;
   }
   buffer_resource = ev->surface->buffer_ref.buffer->resource;
   shmbuf = wl_shm_buffer_get(buffer_resource);
 
-  struct iahwc_overlay *plane = 0;
-  plane = iahwc_get_existing_plane(output, layer_index);
-  // Update Damage.
+  // Layers follow their surface, z-order changes only update the index.
+  struct weston_surface *es = ev->surface;
+  struct iahwc_overlay *plane = iahwc_get_existing_plane(output, es);
+  if (plane && plane->in_use) {
+    // Surface is already shown by another view.
+    return NULL;
+  }
+
+  // Layer changes are collected in state and applied together.
   bool layer_damaged = true;
   bool full_damage = false;
-  iahwc_region_t damage_region;
-  damage_region.numRects = 1;
-  struct weston_surface *es = ev->surface;
   if (!plane) {
     b->iahwc_create_layer(b->iahwc_device, 0, &overlay_layer_id);
     full_damage = true;
-  } else if (plane->es == es) {
+  } else {
     overlay_layer_id = plane->overlay_layer_id;
+  }
+
+  memset(&state, 0, sizeof(state));
+  state.layer = overlay_layer_id;
+
+  // Update Damage.
+  if (plane) {
     if (!pixman_region32_not_empty(&es->pending.damage_buffer) &&
         !pixman_region32_not_empty(&es->pending.damage_surface) &&
         !pixman_region32_not_empty(&es->damage)) {
-      iahwc_rect_t damage_rect = {0, 0, 0, 0};
-      damage_region.rects = &damage_rect;
-      b->iahwc_layer_set_surface_damage(b->iahwc_device, 0, overlay_layer_id,
-                                        damage_region);
+      memset(&damage_rects[0], 0, sizeof(damage_rects[0]));
+      state.surface_damage.numRects = 1;
+      state.surface_damage.rects = damage_rects;
       layer_damaged = false;
     } else {
       pixman_region32_t damage;
       pixman_region32_init(&damage);
       pixman_region32_union(&damage, &es->pending.damage_surface, &es->damage);
       pixman_region32_union(&damage, &es->pending.damage_buffer, &damage);
+      iahwc_fill_damage_region(&damage, damage_rects, &state.surface_damage);
       pixman_region32_fini(&damage);
-      pixman_box32_t *damage_extents = pixman_region32_extents(&damage);
-      iahwc_rect_t damage_rect = {damage_extents->x1, damage_extents->y1,
-                                  damage_extents->x2, damage_extents->y2};
-      damage_region.rects = &damage_rect;
-      b->iahwc_layer_set_surface_damage(b->iahwc_device, 0, overlay_layer_id,
-                                        damage_region);
     }
-  } else {
-    overlay_layer_id = plane->overlay_layer_id;
-    // Layer might have changed z-order as surface has changed.
-    // Mark full surface as damaged.
-    full_damage = true;
+
+    state.valid |= IAHWC_LAYER_STATE_SURFACE_DAMAGE;
   }
 
   pixman_region32_clear(&es->pending.damage_buffer);
@@ -687,12 +759,12 @@ static struct weston_plane *iahwc_output_prepare_overlay_view(
     if (ev->surface->width <= b->cursor_width &&
         ev->surface->height <= b->cursor_height) {
       is_cusor_layer = 1;
-      b->iahwc_layer_set_usage(b->iahwc_device, 0, overlay_layer_id,
-                               IAHWC_LAYER_USAGE_CURSOR);
+      state.usage = IAHWC_LAYER_USAGE_CURSOR;
     } else {
-      b->iahwc_layer_set_usage(b->iahwc_device, 0, overlay_layer_id,
-                               IAHWC_LAYER_USAGE_OVERLAY);
+      state.usage = IAHWC_LAYER_USAGE_OVERLAY;
     }
+
+    state.valid |= IAHWC_LAYER_STATE_USAGE;
   }
 
   if (is_cusor_layer) {
@@ -716,14 +788,15 @@ static struct weston_plane *iahwc_output_prepare_overlay_view(
 
     iahwc_rect_t display_frame = {x, y, surfwidth + x, surfheight + y};
 
-    b->iahwc_layer_set_source_crop(b->iahwc_device, 0, overlay_layer_id,
-                                   source_crop);
-    b->iahwc_layer_set_display_frame(b->iahwc_device, 0, overlay_layer_id,
-                                     display_frame);
+    state.source_crop = source_crop;
+    state.display_frame = display_frame;
+    state.valid |=
+        IAHWC_LAYER_STATE_SOURCE_CROP | IAHWC_LAYER_STATE_DISPLAY_FRAME;
     if (full_damage) {
-      damage_region.rects = &source_crop;
-      b->iahwc_layer_set_surface_damage(b->iahwc_device, 0, overlay_layer_id,
-                                        damage_region);
+      damage_rects[0] = source_crop;
+      state.surface_damage.numRects = 1;
+      state.surface_damage.rects = damage_rects;
+      state.valid |= IAHWC_LAYER_STATE_SURFACE_DAMAGE;
     }
   } else {
     box = pixman_region32_extents(&ev->transform.boundingbox);
@@ -792,14 +865,15 @@ static struct weston_plane *iahwc_output_prepare_overlay_view(
     iahwc_rect_t display_frame = {dest_x, dest_y, dest_w + dest_x,
                                   dest_h + dest_y};
 
-    b->iahwc_layer_set_source_crop(b->iahwc_device, 0, overlay_layer_id,
-                                   source_crop);
-    b->iahwc_layer_set_display_frame(b->iahwc_device, 0, overlay_layer_id,
-                                     display_frame);
+    state.source_crop = source_crop;
+    state.display_frame = display_frame;
+    state.valid |=
+        IAHWC_LAYER_STATE_SOURCE_CROP | IAHWC_LAYER_STATE_DISPLAY_FRAME;
     if (full_damage) {
-      damage_region.rects = &source_crop;
-      b->iahwc_layer_set_surface_damage(b->iahwc_device, 0, overlay_layer_id,
-                                        damage_region);
+      damage_rects[0] = source_crop;
+      state.surface_damage.numRects = 1;
+      state.surface_damage.rects = damage_rects;
+      state.valid |= IAHWC_LAYER_STATE_SURFACE_DAMAGE;
     }
   }
 
@@ -836,6 +910,8 @@ static struct weston_plane *iahwc_output_prepare_overlay_view(
       }
 
       dbo.callback_data = shmbuf;
+      // Usage has to be set before the pixel data.
+      iahwc_flush_layer_state(b, &state);
       int ret = b->iahwc_layer_set_raw_pixel_data(b->iahwc_device, 0,
                                                   overlay_layer_id, dbo);
       if (ret == -1) {
@@ -872,6 +948,9 @@ static struct weston_plane *iahwc_output_prepare_overlay_view(
          * knowledge. */
         if (dmabuf->attributes.n_planes != 1 ||
             dmabuf->attributes.offset[0] != 0 || dmabuf->attributes.flags) {
+          if (!plane)
+            b->iahwc_destroy_layer(b->iahwc_device, 0, overlay_layer_id);
+
           return NULL;
         }
 
@@ -883,19 +962,40 @@ static struct weston_plane *iahwc_output_prepare_overlay_view(
       }
 
       if (!bo) {
+        if (!plane)
+          b->iahwc_destroy_layer(b->iahwc_device, 0, overlay_layer_id);
+
         return NULL;
       }
 
-      b->iahwc_layer_set_usage(b->iahwc_device, 0, overlay_layer_id,
-                               IAHWC_LAYER_USAGE_OVERLAY);
-      b->iahwc_layer_set_bo(b->iahwc_device, 0, overlay_layer_id, bo);
+      state.usage = IAHWC_LAYER_USAGE_OVERLAY;
+      state.bo = bo;
+      state.valid |= IAHWC_LAYER_STATE_USAGE | IAHWC_LAYER_STATE_BO;
     }
+  }
 
-    b->iahwc_layer_set_index(b->iahwc_device, 0, overlay_layer_id, layer_index);
+  if (full_damage || plane->layer_index != layer_index) {
+    state.index = layer_index;
+    state.valid |= IAHWC_LAYER_STATE_INDEX;
+  }
+
+  iahwc_flush_layer_state(b, &state);
+
+  if (layer_damaged) {
+    plane = iahwc_add_overlay_info(plane, output, shmbuf, bo, overlay_layer_id,
+                                   es);
+    if (!plane) {
+      b->iahwc_destroy_layer(b->iahwc_device, 0, overlay_layer_id);
+      if (bo)
+        gbm_bo_destroy(bo);
 
-    iahwc_add_overlay_info(plane, output, shmbuf, bo, overlay_layer_id,
-                           layer_index, ev->surface);
+      return NULL;
+    }
   }
+
+  plane->layer_index = layer_index;
+
+  plane->in_use = true;
   es->keep_buffer = true;
 
   return p;
@@ -992,6 +1092,7 @@ static void iahwc_assign_planes(struct weston_output *output_base,
   struct iahwc_output *output = to_iahwc_output(output_base);
   struct weston_view *ev, *next;
   struct weston_plane *next_plane;
+  struct iahwc_overlay *plane;
   uint32_t layer_index = 0;
 
   if (b->sprites_are_broken) {
@@ -1006,6 +1107,10 @@ static void iahwc_assign_planes(struct weston_output *output_base,
     output->overlay_enabled = true;
   }
 
+  wl_list_for_each(plane, &output->overlay_list, link) {
+    plane->in_use = false;
+  }
+
   wl_list_for_each_safe(ev, next, &output_base->compositor->view_list, link) {
     next_plane = iahwc_output_prepare_overlay_view(output, ev, layer_index);
 
@@ -1021,10 +1126,8 @@ static void iahwc_assign_planes(struct weston_output *output_base,
   }
 
   // Clean up our bookkeeping for unused overlays.
-  if (output->total_layers > 0 && (output->total_layers > layer_index))
-    iahwc_overlay_destroy(output, layer_index++);
+  iahwc_overlay_destroy(output, true);
 
-  output->total_layers = layer_index;
   pixman_region32_clear(&output->overlay_plane.damage);
   pixman_region32_clear(&output->overlay_plane.clip);
   struct weston_compositor *c = output_base->compositor;
@@ -1223,7 +1326,6 @@ static int iahwc_output_enable(struct weston_output *base) {
   output->state_invalid = true;
   output->last_vsync_ts.tv_nsec = 0;
   output->last_vsync_ts.tv_sec = 0;
-  output->total_layers = 0;
   output->overlay_enabled = true;
   base->disable_planes = 0;
   unlock(&output->spin_lock);
@@ -1251,7 +1353,7 @@ static void iahwc_output_destroy(struct weston_output *base) {
     free(mode);
   }
 
-  iahwc_overlay_destroy(output, 0);
+  iahwc_overlay_destroy(output, false);
   weston_output_release(&output->base);
 
   if (output->backlight)
@@ -1609,6 +1711,9 @@ static struct iahwc_backend *iahwc_backend_create(
   b->iahwc_layer_set_index =
       (IAHWC_PFN_LAYER_SET_INDEX)iahwc_device->getFunctionPtr(
           iahwc_device, IAHWC_FUNC_LAYER_SET_INDEX);
+  b->iahwc_display_set_layer_states =
+      (IAHWC_PFN_DISPLAY_SET_LAYER_STATES)iahwc_device->getFunctionPtr(
+          iahwc_device, IAHWC_FUNC_DISPLAY_SET_LAYER_STATES);
   b->iahwc_register_callback =
       (IAHWC_PFN_REGISTER_CALLBACK)iahwc_device->getFunctionPtr(
           iahwc_device, IAHWC_FUNC_REGISTER_CALLBACK);
@@ -94,6 +94,23 @@ typedef struct FBKey {
   }
 } FBKey;
 
+// Identity of a client dma-buf as seen by the importer. Two handles with the
+// same key refer to the same memory with the same layout, so they can share
+// a single import (gbm bo, GEM handles and framebuffer) across displays.
+typedef struct BufferImportKey {
+  uint64_t dev_ = 0;
+  uint64_t ino_ = 0;
+  uint64_t modifier_ = 0;
+  uint32_t offsets_[4] = {0, 0, 0, 0};
+  uint32_t format_ = 0;
+  uint32_t flags_ = 0;
+} BufferImportKey;
+
+// Fills dev_ and ino_ of key from the dma-buf behind prime_fd. Returns false
+// if the fd can't be queried or the kernel doesn't give each dma-buf its own
+// inode, in which case buffers must not share imports.
+bool GetDmaBufIdentity(int prime_fd, BufferImportKey *key);
+
 int CreateFrameBuffer(
     const uint32_t &iwidth, const uint32_t &iheight, const uint64_t &modifier,
     const uint32_t &iframe_buffer_format, const uint32_t &num_planes,
@@ -19,6 +19,9 @@
 #include "hwctrace.h"
 
 #include <drm_fourcc.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
 
 int ReleaseFrameBuffer(const FBKey &key, uint32_t fd, uint32_t gpu_fd) {
   int ret = fd > 0 ? drmModeRmFB(gpu_fd, fd) : 0;
@@ -101,3 +104,31 @@ int CreateFrameBuffer(
 
   return ret;
 }
+
+// Before Linux 5.3 every dma-buf shares the same anon inode, so st_ino
+// can't tell buffers apart.
+static bool DmaBufHasUniqueInode() {
+  struct utsname name;
+  int major = 0;
+  int minor = 0;
+  if (uname(&name) || sscanf(name.release, "%d.%d", &major, &minor) != 2)
+    return false;
+
+  return major > 5 || (major == 5 && minor >= 3);
+}
+
+bool GetDmaBufIdentity(int prime_fd, BufferImportKey *key) {
+  static const bool unique_inode = DmaBufHasUniqueInode();
+  if (!unique_inode)
+    return false;
+
+  struct stat st;
+  if (prime_fd < 0 || fstat(prime_fd, &st)) {
+    ETRACE("Failed to query dma-buf identity of prime fd %d \n", prime_fd);
+    return false;
+  }
+
+  key->dev_ = static_cast<uint64_t>(st.st_dev);
+  key->ino_ = static_cast<uint64_t>(st.st_ino);
+  return true;
+}
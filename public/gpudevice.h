@@ -26,9 +26,12 @@
 #include <sstream>
 #include <string>
 
+#include "bufferimportcache.h"
 #include "displaymanager.h"
 #include "framebuffermanager.h"
+#include "hwcreactor.h"
 #include "hwcthread.h"
+#include "hwcthreadscheduler.h"
 #include "logicaldisplaymanager.h"
 #include "nativedisplay.h"
 
@@ -51,6 +54,49 @@ class GpuDevice : public HWCThread {
 
   FrameBufferManager* GetFrameBufferManager();
 
+  BufferImportCache* GetBufferImportCache();
+
+  // Commits of displays are deferred between these calls and applied with
+  // a single atomic commit. See DisplayManager::BeginCommitBatch.
+  bool BeginCommitBatch(const std::vector<NativeDisplay*>& displays);
+  bool FlushCommitBatch(const std::vector<NativeDisplay*>& displays,
+                        int32_t* retire_fence);
+
+  bool IsMosaicAtomicCommitEnabled() const {
+    return mosaic_atomic_commit_;
+  }
+
+  // Number of worker threads used to present the physical displays of a
+  // mosaic in parallel. Zero means displays are presented serially.
+  uint32_t GetMosaicPresentWorkers() const {
+    return mosaic_present_workers_;
+  }
+
+  // Time in ms without updates after which a display squashes its layers
+  // into a single plane. Zero disables idle mode.
+  uint32_t GetIdleTimeout() const {
+    return idle_timeout_ms_;
+  }
+
+  // Time in ms updates have to keep coming after idle mode, before layers
+  // are moved back to overlays.
+  uint32_t GetIdleExitTime() const {
+    return idle_exit_ms_;
+  }
+
+  // Whether displays start in late composition mode, see
+  // NativeDisplay::SetLateComposition.
+  bool IsLateCompositionEnabled() const {
+    return late_composition_;
+  }
+
+  // Shared event loop components can register their fds, timers and
+  // events with instead of running a thread of their own. NULL if
+  // disabled in the settings.
+  HWCReactor* GetReactor() const {
+    return reactor_.get();
+  }
+
   uint32_t GetFD() const;
 
   NativeDisplay* GetDisplay(uint32_t display);
@@ -165,6 +211,15 @@ class GpuDevice : public HWCThread {
   void ParseFloatDisplaySetting(std::string& value,
                                 std::vector<HwcRect<int32_t>>& float_displays,
                                 std::vector<uint32_t>& float_display_indices);
+  void ParseThreadAffinitySetting(
+      std::string& value,
+      std::map<std::string, HWCThreadPolicy>& thread_policies);
+  void ParseThreadNiceSetting(
+      std::string& value,
+      std::map<std::string, HWCThreadPolicy>& thread_policies);
+  void ParseThreadPolicySetting(
+      std::string& value,
+      std::map<std::string, HWCThreadPolicy>& thread_policies);
 
   void InitializeDisplayIndex(std::vector<uint32_t>& physical_displays,
                               std::vector<NativeDisplay*>& displays);
@@ -189,6 +244,13 @@ class GpuDevice : public HWCThread {
   std::vector<NativeDisplay*> total_displays_;
 
   bool reserve_plane_ = false;
+  bool mosaic_atomic_commit_ = false;
+  uint32_t mosaic_present_workers_ = 0;
+  uint32_t reactor_workers_ = 0;
+  uint32_t idle_timeout_ms_ = 4000;
+  uint32_t idle_exit_ms_ = 100;
+  bool late_composition_ = false;
+  std::unique_ptr<HWCReactor> reactor_;
   bool enable_all_display_ = false;
   std::map<uint8_t, std::vector<uint32_t>> reserved_drm_display_planes_map_;
   uint32_t initialization_state_ = kUnInitialized;
@@ -301,6 +301,7 @@ struct HwcLayer {
   void SufaceDamageTransfrom();
 
   void SetTotalDisplays(uint32_t total_displays);
+  void ResetConstraints();
   friend class VirtualDisplay;
   friend class PhysicalDisplay;
   friend class MosaicDisplay;
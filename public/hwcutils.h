@@ -34,6 +34,13 @@ namespace hwcomposer {
  */
 int HWCPoll(int fd, int timeout);
 
+/**
+ * Get the current time of CLOCK_MONOTONIC
+ *
+ * @return time in nanoseconds
+ */
+uint64_t GetMonotonicTimeNs();
+
 /**
  * Reset the bounds of a rectangle to enclose all rectangles in a region
  *
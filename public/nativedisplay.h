@@ -295,6 +295,27 @@ class NativeDisplay {
   virtual void SetDisableExplicitSync(bool /*explicit_sync_enabled*/) {
   }
 
+  /**
+   * API to enable late composition. Frames are composed and committed
+   * just in time for the vblank they can flip at, rather than as soon as
+   * Present is called, see GetCompositionDeadline. This reduces latency
+   * for clients presenting once per vblank. Falls back to composing right
+   * away if deadlines are missed.
+   */
+  virtual void SetLateComposition(bool /*enable*/) {
+  }
+
+  /**
+   * In late composition mode, returns the CLOCK_MONOTONIC time in ns at
+   * which Present should be called for the next frame, i.e. the vblank it
+   * can flip at minus the learned composition budget, or 0 if it should
+   * be presented right away. Never blocks. Callers wait on a thread of
+   * their own and present the latest layer state once it is reached.
+   */
+  virtual uint64_t GetCompositionDeadline() {
+    return 0;
+  }
+
   /**
    * API to connect the display. Note that this doesn't necessarily
    * mean display is turned on. Implementation is free to reset any display
@@ -0,0 +1,172 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/* Compares the epoll based FDHandler with the poll based one it replaced,
+ * for the number of fds HWC threads typically watch. */
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include "fdhandler.h"
+
+// FDHandler as it was before moving to epoll: fds are kept in a map and
+// the pollfd array is rebuilt on every Poll.
+class PollFDHandler {
+ public:
+  bool AddFd(int fd) {
+    return fds_.emplace(fd, FDWatch()).second;
+  }
+
+  bool RemoveFd(int fd) {
+    return fds_.erase(fd) == 1;
+  }
+
+  int Poll(int timeout) {
+    nfds_t nfds = fds_.size();
+    std::vector<struct pollfd> fds(nfds);
+
+    int i = 0;
+    for (auto &it : fds_) {
+      fds[i].fd = it.first;
+      fds[i].events = POLLIN;
+      it.second.idx = i;
+      i++;
+    }
+
+    int ret = poll(fds.data(), nfds, timeout);
+
+    for (auto &it : fds_) {
+      it.second.revents = fds[it.second.idx].revents;
+    }
+
+    return ret;
+  }
+
+  int IsReady(int fd) const {
+    const auto &it = fds_.find(fd);
+    if (it == fds_.end())
+      return 0;
+
+    int revents = it->second.revents;
+    if (revents & POLLIN)
+      return 1;
+    else if (revents & POLLERR)
+      return -1;
+    else
+      return 0;
+  }
+
+ private:
+  struct FDWatch {
+    int idx = 0;
+    int revents = 0;
+  };
+
+  std::map<int, FDWatch> fds_;
+};
+
+// Signals one of num_fds eventfds per iteration, then polls and checks
+// every fd for readiness like the HWC thread loops do. Returns the average
+// time per iteration in ns, or -1 on failure.
+template <typename Handler>
+static double run_benchmark(uint32_t num_fds, uint32_t iterations) {
+  std::vector<int> fds;
+  Handler handler;
+  for (uint32_t i = 0; i < num_fds; i++) {
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0 || !handler.AddFd(fd)) {
+      fprintf(stderr, "failed to add eventfd %u: %m\n", i);
+      for (int f : fds)
+        close(f);
+      return -1;
+    }
+
+    fds.emplace_back(fd);
+  }
+
+  double result = 0;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint64_t value = 1;
+    int signaled = fds[i % num_fds];
+    if (write(signaled, &value, sizeof(value)) != sizeof(value) ||
+        handler.Poll(-1) != 1) {
+      fprintf(stderr, "poll failed in iteration %u\n", i);
+      result = -1;
+      break;
+    }
+
+    for (int fd : fds) {
+      if (handler.IsReady(fd) && read(fd, &value, sizeof(value)) < 0) {
+        fprintf(stderr, "failed to read eventfd: %m\n");
+        result = -1;
+      }
+    }
+
+    if (result < 0)
+      break;
+  }
+
+  if (result == 0) {
+    std::chrono::steady_clock::duration elapsed =
+        std::chrono::steady_clock::now() - start;
+    result = static_cast<double>(
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                     .count()) /
+             iterations;
+  }
+
+  for (int fd : fds) {
+    handler.RemoveFd(fd);
+    close(fd);
+  }
+
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t iterations = 100000;
+  if (argc > 1)
+    iterations = strtoul(argv[1], NULL, 10);
+
+  if (!iterations) {
+    fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  static const uint32_t kNumFds[] = {2, 8, 32};
+  printf("%6s %16s %16s\n", "fds", "poll (ns/iter)", "epoll (ns/iter)");
+  for (uint32_t num_fds : kNumFds) {
+    double poll_ns = run_benchmark<PollFDHandler>(num_fds, iterations);
+    double epoll_ns =
+        run_benchmark<hwcomposer::FDHandler>(num_fds, iterations);
+    if (poll_ns < 0 || epoll_ns < 0)
+      return 1;
+
+    printf("%6u %16.0f %16.0f\n", num_fds, poll_ns, epoll_ns);
+  }
+
+  return 0;
+}
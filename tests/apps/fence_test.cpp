@@ -0,0 +1,146 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/* Exercises HWCFence on sw_sync timelines, without a GPU or display.
+ * Needs CONFIG_SW_SYNC and access to the sw_sync debugfs node. */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include <hwcutils.h>
+
+#include "hwcfence.h"
+#include "testutils.h"
+
+using hwcomposer::HWCFence;
+using hwcomposer::HWCSyncTimeline;
+
+static bool is_fd_open(int fd) {
+  return fcntl(fd, F_GETFD) != -1;
+}
+
+static void test_ownership(HWCSyncTimeline &timeline) {
+  HWCFence fence = timeline.CreateFence("hwc_test_owner");
+  CHECK(fence.IsValid());
+  int fd = fence.get();
+
+  int dup_fd = fence.Dup();
+  CHECK(dup_fd > 0 && dup_fd != fd);
+  HWCFence dup(dup_fd);
+
+  HWCFence moved(std::move(fence));
+  CHECK(!fence.IsValid());
+  CHECK(moved.get() == fd);
+
+  moved.Reset();
+  CHECK(!is_fd_open(fd));
+  CHECK(is_fd_open(dup_fd));
+
+  int released = dup.Release();
+  CHECK(released == dup_fd && !dup.IsValid());
+  close(released);
+
+  // Fences created above are still pending on the timeline.
+  timeline.Advance();
+}
+
+static void test_status(HWCSyncTimeline &timeline) {
+  HWCFence fence = timeline.CreateFence("hwc_test_status");
+  CHECK(fence.GetStatus() == HWCFence::kActive);
+  CHECK(fence.GetSignalTime() == 0);
+  CHECK(!fence.Wait(0));
+
+  uint64_t before = hwcomposer::GetMonotonicTimeNs();
+  CHECK(timeline.Advance());
+  uint64_t after = hwcomposer::GetMonotonicTimeNs();
+
+  CHECK(fence.GetStatus() == HWCFence::kSignaled);
+  CHECK(fence.Wait(0));
+  uint64_t signal_time = fence.GetSignalTime();
+  CHECK(signal_time >= before && signal_time <= after);
+
+  // No fence behaves like a signaled one.
+  HWCFence none;
+  CHECK(none.GetStatus() == HWCFence::kSignaled);
+  CHECK(none.Wait(0));
+}
+
+static void test_merge(HWCSyncTimeline &timeline) {
+  std::vector<int32_t> fds;
+  for (uint32_t steps = 1; steps <= 3; steps++) {
+    fds.emplace_back(timeline.CreateFence("hwc_test_merge", steps).Release());
+  }
+
+  // Invalid fds are skipped.
+  fds.emplace_back(-1);
+  HWCFence merged = HWCFence::Merge("hwc_test_merged", fds);
+  CHECK(fds.empty());
+  CHECK(merged.IsValid());
+
+  timeline.Advance(2);
+  CHECK(merged.GetStatus() == HWCFence::kActive);
+
+  timeline.Advance();
+  CHECK(merged.GetStatus() == HWCFence::kSignaled);
+  CHECK(merged.GetSignalTime() != 0);
+
+  std::vector<int32_t> none(2, -1);
+  CHECK(!HWCFence::Merge("hwc_test_none", none).IsValid());
+}
+
+// An acquire fence which signals while the consumer already waits on it,
+// which is what a late client buffer looks like to HWC.
+static void test_late_fence(HWCSyncTimeline &timeline) {
+  static const uint64_t kLateNs = 20 * 1000 * 1000;
+  HWCFence fence = timeline.CreateFence("hwc_test_late");
+
+  uint64_t start = hwcomposer::GetMonotonicTimeNs();
+  std::thread producer([&timeline]() {
+    usleep(kLateNs / 1000);
+    timeline.Advance();
+  });
+
+  CHECK(fence.Wait(1000));
+  uint64_t woken = hwcomposer::GetMonotonicTimeNs();
+  producer.join();
+
+  uint64_t signal_time = fence.GetSignalTime();
+  CHECK(signal_time >= start + kLateNs);
+  CHECK(woken >= signal_time);
+  printf("late fence: signaled after %.2f ms, waiter woke %.3f ms later\n",
+         (signal_time - start) / 1000000.0, (woken - signal_time) / 1000000.0);
+}
+
+int main() {
+  HWCSyncTimeline timeline;
+  if (!timeline.Initialize()) {
+    printf("sw_sync is not available, skipping.\n");
+    return TEST_SKIP;
+  }
+
+  test_ownership(timeline);
+  test_status(timeline);
+  test_merge(timeline);
+  test_late_fence(timeline);
+
+  return TestResult("fence");
+}
@@ -0,0 +1,207 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/* Checks every entry of the pixel format table against layouts written
+ * down independently of it, one DRM FOURCC at a time. */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <hwcutils.h>
+
+#include "hwcformats.h"
+
+using hwcomposer::HwcFormatInfo;
+
+struct ExpectedFormat {
+  uint32_t format;
+  const char *name;
+  uint32_t planes;
+  uint32_t cpp[3];
+  uint32_t hsub;
+  uint32_t vsub;
+  bool has_alpha;
+  bool is_yuv;
+  // Goes through the media backend.
+  bool is_media;
+};
+
+#define FORMAT(f) DRM_FORMAT_##f, #f
+
+static const ExpectedFormat kExpected[] = {
+    {FORMAT(C8), 1, {1, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(R8), 1, {1, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(R16), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(RG88), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(GR88), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(RGB332), 1, {1, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(BGR233), 1, {1, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(XRGB4444), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(XBGR4444), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(RGBX4444), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(BGRX4444), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(ARGB4444), 1, {2, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(ABGR4444), 1, {2, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(RGBA4444), 1, {2, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(BGRA4444), 1, {2, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(XRGB1555), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(XBGR1555), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(RGBX5551), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(BGRX5551), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(ARGB1555), 1, {2, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(ABGR1555), 1, {2, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(RGBA5551), 1, {2, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(BGRA5551), 1, {2, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(RGB565), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(BGR565), 1, {2, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(RGB888), 1, {3, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(BGR888), 1, {3, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(XRGB8888), 1, {4, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(XBGR8888), 1, {4, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(RGBX8888), 1, {4, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(BGRX8888), 1, {4, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(ARGB8888), 1, {4, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(ABGR8888), 1, {4, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(RGBA8888), 1, {4, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(BGRA8888), 1, {4, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(XRGB2101010), 1, {4, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(XBGR2101010), 1, {4, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(RGBX1010102), 1, {4, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(BGRX1010102), 1, {4, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(ARGB2101010), 1, {4, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(ABGR2101010), 1, {4, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(RGBA1010102), 1, {4, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(BGRA1010102), 1, {4, 0, 0}, 1, 1, true, false, false},
+    {FORMAT(XRGB161616), 1, {8, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(XBGR161616), 1, {8, 0, 0}, 1, 1, false, false, false},
+    {FORMAT(YUYV), 1, {2, 0, 0}, 1, 1, false, true, true},
+    {FORMAT(YVYU), 1, {2, 0, 0}, 1, 1, false, true, true},
+    {FORMAT(UYVY), 1, {2, 0, 0}, 1, 1, false, true, true},
+    {FORMAT(VYUY), 1, {2, 0, 0}, 1, 1, false, true, true},
+    {FORMAT(AYUV), 1, {4, 0, 0}, 1, 1, true, true, true},
+    {FORMAT(NV12), 2, {1, 2, 0}, 2, 2, false, true, true},
+    {FORMAT(NV21), 2, {1, 2, 0}, 2, 2, false, true, true},
+    {FORMAT(NV12_Y_TILED_INTEL), 2, {1, 2, 0}, 2, 2, false, true, true},
+    {FORMAT(NV16), 2, {1, 2, 0}, 2, 1, false, true, true},
+    {FORMAT(NV61), 2, {1, 2, 0}, 2, 1, false, true, false},
+    {FORMAT(P010), 2, {2, 4, 0}, 2, 2, false, true, true},
+    {FORMAT(P012), 2, {2, 4, 0}, 2, 2, false, true, false},
+    {FORMAT(P016), 2, {2, 4, 0}, 2, 2, false, true, false},
+    {FORMAT(YUV410), 3, {1, 1, 1}, 4, 4, false, true, false},
+    {FORMAT(YVU410), 3, {1, 1, 1}, 4, 4, false, true, false},
+    {FORMAT(YUV411), 3, {1, 1, 1}, 4, 1, false, true, false},
+    {FORMAT(YVU411), 3, {1, 1, 1}, 4, 1, false, true, false},
+    {FORMAT(YUV420), 3, {1, 1, 1}, 2, 2, false, true, true},
+    {FORMAT(YVU420), 3, {1, 1, 1}, 2, 2, false, true, true},
+    {FORMAT(YVU420_ANDROID), 3, {1, 1, 1}, 2, 2, false, true, true},
+    {FORMAT(YUV422), 3, {1, 1, 1}, 2, 1, false, true, true},
+    {FORMAT(YVU422), 3, {1, 1, 1}, 2, 1, false, true, false},
+    {FORMAT(YUV444), 3, {1, 1, 1}, 1, 1, false, true, true},
+    {FORMAT(YVU444), 3, {1, 1, 1}, 1, 1, false, true, false},
+};
+
+static int check_format(const ExpectedFormat &expected) {
+  const HwcFormatInfo *info = hwcomposer::GetFormatInfo(expected.format);
+  if (!info) {
+    fprintf(stderr, "%s: missing from the format table\n", expected.name);
+    return 1;
+  }
+
+  int failures = 0;
+  if (info->planes != expected.planes ||
+      hwcomposer::GetTotalPlanesForFormat(expected.format) != expected.planes) {
+    fprintf(stderr, "%s: %u planes, expected %u\n", expected.name,
+            info->planes, expected.planes);
+    failures++;
+  }
+
+  for (uint32_t plane = 0; plane < 3; plane++) {
+    if (info->cpp[plane] != expected.cpp[plane]) {
+      fprintf(stderr, "%s: plane %u has %u bytes per pixel, expected %u\n",
+              expected.name, plane, info->cpp[plane], expected.cpp[plane]);
+      failures++;
+    }
+  }
+
+  if (info->hsub != expected.hsub || info->vsub != expected.vsub) {
+    fprintf(stderr, "%s: subsampling %ux%u, expected %ux%u\n", expected.name,
+            info->hsub, info->vsub, expected.hsub, expected.vsub);
+    failures++;
+  }
+
+  if (info->has_alpha != expected.has_alpha ||
+      info->is_yuv != expected.is_yuv) {
+    fprintf(stderr, "%s: alpha %d yuv %d, expected alpha %d yuv %d\n",
+            expected.name, info->has_alpha, info->is_yuv, expected.has_alpha,
+            expected.is_yuv);
+    failures++;
+  }
+
+  if (info->is_media != expected.is_media ||
+      hwcomposer::IsSupportedMediaFormat(expected.format) !=
+          expected.is_media) {
+    fprintf(stderr, "%s: media %d, expected media %d\n", expected.name,
+            info->is_media, expected.is_media);
+    failures++;
+  }
+
+  // An odd sized buffer needs rounded up chroma planes.
+  for (uint32_t plane = 1; plane < info->planes; plane++) {
+    uint32_t width = hwcomposer::GetFormatPlaneWidth(*info, plane, 101);
+    uint32_t height = hwcomposer::GetFormatPlaneHeight(*info, plane, 101);
+    if (width * expected.hsub < 101 || height * expected.vsub < 101) {
+      fprintf(stderr, "%s: plane %u of 101x101 is only %ux%u\n",
+              expected.name, plane, width, height);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+int main() {
+  int failures = 0;
+  for (const ExpectedFormat &expected : kExpected) {
+    failures += check_format(expected);
+  }
+
+  // New table entries need an expectation above.
+  for (const HwcFormatInfo &info : hwcomposer::kHwcFormats) {
+    bool found = false;
+    for (const ExpectedFormat &expected : kExpected) {
+      found |= expected.format == info.format;
+    }
+
+    if (!found) {
+      fprintf(stderr, "Format %.4s is not covered by this test\n",
+              reinterpret_cast<const char *>(&info.format));
+      failures++;
+    }
+  }
+
+  if (hwcomposer::GetFormatInfo(DRM_FORMAT_NONE)) {
+    fprintf(stderr, "DRM_FORMAT_NONE should be unknown\n");
+    failures++;
+  }
+
+  if (failures) {
+    fprintf(stderr, "%d format checks failed\n", failures);
+    return 1;
+  }
+
+  printf("All %zu formats passed.\n", hwcomposer::kHwcFormatsSize);
+  return 0;
+}
@@ -0,0 +1,277 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/* Drives HWCFramePacer with vblanks from HWCVsyncSimulator, without a
+ * display. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <hwcutils.h>
+
+#include "hwcfence.h"
+#include "hwcframepacer.h"
+#include "testutils.h"
+
+using hwcomposer::HWCFence;
+using hwcomposer::HWCFramePacer;
+using hwcomposer::HWCSyncTimeline;
+using hwcomposer::HWCVsyncSimulator;
+
+static const uint64_t kPeriodNs = 1000000000ULL / 60;
+
+// Records what the pacer asks the display to do. Commits get a retire
+// fence from a sw_sync timeline, if available, which the test advances.
+class FakeDisplay {
+ public:
+  struct Present {
+    uint64_t time_ns;
+    HWCFramePacer::Result result;
+    uint64_t frame;
+  };
+
+  bool Initialize() {
+    return timeline_.Initialize();
+  }
+
+  int32_t OnPresent(HWCFramePacer::Result result, uint64_t frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (result == HWCFramePacer::kDropped) {
+      dropped_.push_back(frame);
+      return -1;
+    }
+
+    presents_.push_back({hwcomposer::GetMonotonicTimeNs(), result, frame});
+    cond_.notify_all();
+    return timeline_.CreateFence("fakedisplay").Release();
+  }
+
+  // Signals the retire fence of the oldest commit not retired yet.
+  void Retire() {
+    timeline_.Advance();
+  }
+
+  void OnVsyncControl(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    vsync_enabled_ = enabled;
+    cond_.notify_all();
+  }
+
+  // Waits until count frames have been presented in total.
+  bool WaitForPresents(size_t count, uint32_t timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                          [&]() { return presents_.size() >= count; });
+  }
+
+  bool WaitForVsync(bool enabled, uint32_t timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                          [&]() { return vsync_enabled_ == enabled; });
+  }
+
+  std::vector<Present> GetPresents() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return presents_;
+  }
+
+  std::vector<uint64_t> GetDropped() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+  }
+
+ private:
+  HWCSyncTimeline timeline_;
+  std::vector<Present> presents_;
+  std::vector<uint64_t> dropped_;
+  bool vsync_enabled_ = false;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+// A frame due in a few vblanks is queued and handed back one vblank
+// before its target.
+static void test_queued(HWCFramePacer &pacer, FakeDisplay &display) {
+  uint64_t target = hwcomposer::GetMonotonicTimeNs() + 5 * kPeriodNs;
+  size_t presented = display.GetPresents().size();
+  CHECK(pacer.QueueFrame(target, 1) == HWCFramePacer::kQueued);
+  CHECK(display.WaitForPresents(presented + 1, 500));
+
+  std::vector<FakeDisplay::Present> presents = display.GetPresents();
+  CHECK(presents.size() == presented + 1);
+  if (presents.size() != presented + 1)
+    return;
+
+  const FakeDisplay::Present &present = presents.back();
+  CHECK(present.result == HWCFramePacer::kPresented);
+  CHECK(present.frame == 1);
+  CHECK(present.time_ns + 2 * kPeriodNs > target);
+  CHECK(present.time_ns < target);
+  display.Retire();
+}
+
+// Only the newest of several frames due at the same vblank is shown.
+static void test_dropped(HWCFramePacer &pacer, FakeDisplay &display) {
+  HWCFramePacer::Stats before = pacer.GetStats();
+  uint64_t target = hwcomposer::GetMonotonicTimeNs() + 4 * kPeriodNs;
+  size_t presented = display.GetPresents().size();
+  for (uint64_t i = 0; i < 3; i++) {
+    CHECK(pacer.QueueFrame(target + i * 1000000, 10 + i) ==
+          HWCFramePacer::kQueued);
+  }
+
+  CHECK(display.WaitForPresents(presented + 1, 500));
+  // Nothing else may follow.
+  usleep(5 * kPeriodNs / 1000);
+  std::vector<FakeDisplay::Present> presents = display.GetPresents();
+  CHECK(presents.size() == presented + 1);
+  CHECK(presents.back().frame == 12);
+  display.Retire();
+
+  std::vector<uint64_t> dropped = display.GetDropped();
+  std::vector<uint64_t> expected_dropped = {10, 11};
+  CHECK(dropped == expected_dropped);
+
+  HWCFramePacer::Stats after = pacer.GetStats();
+  CHECK(after.dropped == before.dropped + 2);
+  CHECK(after.presented == before.presented + 1);
+}
+
+// Scheduled frames are handed back at their start time, a newer one
+// replaces the one which was not presented yet.
+static void test_scheduled(HWCFramePacer &pacer, FakeDisplay &display) {
+  uint64_t now = hwcomposer::GetMonotonicTimeNs();
+  uint64_t start = now + 3 * kPeriodNs;
+  size_t presented = display.GetPresents().size();
+  size_t dropped = display.GetDropped().size();
+  CHECK(pacer.ScheduleFrame(start, 30) == HWCFramePacer::kQueued);
+  CHECK(pacer.ScheduleFrame(start, 31) == HWCFramePacer::kQueued);
+  CHECK(display.WaitForPresents(presented + 1, 500));
+
+  std::vector<FakeDisplay::Present> presents = display.GetPresents();
+  CHECK(presents.size() == presented + 1);
+  CHECK(presents.back().frame == 31);
+  CHECK(presents.back().time_ns >= start);
+  display.Retire();
+
+  std::vector<uint64_t> dropped_frames = display.GetDropped();
+  CHECK(dropped_frames.size() == dropped + 1);
+  CHECK(dropped_frames.back() == 30);
+  CHECK(pacer.ScheduleFrame(now, 32) == HWCFramePacer::kPresented);
+}
+
+// The retire fence of a queued frame signals once the commit showing it
+// retired, those of frames dropped in favour of it right away.
+static void test_retire_fence(HWCFramePacer &pacer, FakeDisplay &display) {
+  uint64_t target = hwcomposer::GetMonotonicTimeNs() + 4 * kPeriodNs;
+  size_t presented = display.GetPresents().size();
+  int32_t fence_fds[2] = {-1, -1};
+  CHECK(pacer.QueueFrame(target, 20, &fence_fds[0]) ==
+        HWCFramePacer::kQueued);
+  CHECK(pacer.QueueFrame(target + 1000000, 21, &fence_fds[1]) ==
+        HWCFramePacer::kQueued);
+  HWCFence dropped(fence_fds[0]);
+  HWCFence shown(fence_fds[1]);
+  CHECK(dropped.IsValid() && shown.IsValid());
+  CHECK(display.WaitForPresents(presented + 1, 500));
+
+  CHECK(dropped.Wait(500));
+  CHECK(shown.GetStatus() == HWCFence::kActive);
+  display.Retire();
+  CHECK(shown.Wait(500));
+}
+
+// Frames due at the next vblank are committed by the caller right away.
+static void test_immediate(HWCFramePacer &pacer) {
+  uint64_t now = hwcomposer::GetMonotonicTimeNs();
+  HWCFramePacer::Result result = pacer.QueueFrame(now);
+  CHECK(result == HWCFramePacer::kPresented || result == HWCFramePacer::kLate);
+  CHECK(pacer.QueueFrame(now - 10 * kPeriodNs) == HWCFramePacer::kLate);
+}
+
+// Vsync is only kept on while frames are paced.
+static void test_vsync_control(FakeDisplay &display) {
+  CHECK(display.WaitForVsync(false, 2000));
+}
+
+// Queued frames are not held when vblanks stop.
+static void test_stalled(HWCFramePacer &pacer, FakeDisplay &display,
+                         HWCVsyncSimulator &simulator) {
+  simulator.Stop();
+  size_t presented = display.GetPresents().size();
+  CHECK(pacer.QueueFrame(hwcomposer::GetMonotonicTimeNs() + 2 * kPeriodNs) ==
+        HWCFramePacer::kQueued);
+  CHECK(display.WaitForVsync(true, 500));
+  CHECK(display.WaitForPresents(presented + 1, 500));
+
+  std::vector<FakeDisplay::Present> presents = display.GetPresents();
+  CHECK(presents.size() == presented + 1);
+  if (presents.size() == presented + 1)
+    CHECK(presents.back().result == HWCFramePacer::kLate);
+}
+
+int main() {
+  FakeDisplay display;
+  bool has_sw_sync = display.Initialize();
+  HWCFramePacer pacer;
+  if (!pacer.Initialize(
+          [&display](HWCFramePacer::Result result, uint64_t frame) {
+            return display.OnPresent(result, frame);
+          },
+          [&display](bool enabled) { display.OnVsyncControl(enabled); })) {
+    fprintf(stderr, "Failed to initialize frame pacer\n");
+    return 1;
+  }
+
+  pacer.SetRefreshPeriod(kPeriodNs);
+  HWCVsyncSimulator simulator;
+  if (!simulator.Start(kPeriodNs, [&pacer](uint64_t timestamp_ns) {
+        pacer.OnVblank(timestamp_ns);
+      })) {
+    fprintf(stderr, "Failed to start vsync simulator\n");
+    return 1;
+  }
+
+  // Let the pacer see a few vblanks.
+  usleep(5 * kPeriodNs / 1000);
+
+  test_queued(pacer, display);
+  test_dropped(pacer, display);
+  test_scheduled(pacer, display);
+  if (has_sw_sync) {
+    test_retire_fence(pacer, display);
+  } else {
+    printf("No sw_sync, skipping retire fence checks.\n");
+  }
+
+  test_immediate(pacer);
+  test_vsync_control(display);
+  test_stalled(pacer, display, simulator);
+
+  HWCFramePacer::Stats stats = pacer.GetStats();
+  printf("presented %llu, late %llu, dropped %llu\n",
+         static_cast<unsigned long long>(stats.presented),
+         static_cast<unsigned long long>(stats.late),
+         static_cast<unsigned long long>(stats.dropped));
+
+  return TestResult("frame pacer");
+}
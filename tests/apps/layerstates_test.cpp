@@ -0,0 +1,161 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/* Exercises IAHWC_FUNC_DISPLAY_SET_LAYER_STATES on the first display. Only
+ * layer state is set, nothing is presented. */
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <iahwc.h>
+
+#include "testutils.h"
+
+// What a client built against a newer iahwc.h passes.
+struct layer_state_next {
+  iahwc_layer_state_t state;
+  uint64_t unknown_field;
+};
+
+struct layer_states_test {
+  iahwc_device_t *device;
+  IAHWC_PFN_CREATE_LAYER create_layer;
+  IAHWC_PFN_DESTROY_LAYER destroy_layer;
+  IAHWC_PFN_DISPLAY_SET_LAYER_STATES set_layer_states;
+};
+
+static bool is_fd_open(int fd) {
+  return fcntl(fd, F_GETFD) != -1;
+}
+
+static void fill_state(iahwc_layer_state_t *state, iahwc_layer_t layer) {
+  iahwc_rect_t rect = {0, 0, 64, 64};
+  memset(state, 0, sizeof(*state));
+  state->layer = layer;
+  state->source_crop = rect;
+  state->display_frame = rect;
+  state->index = 0;
+  state->valid = IAHWC_LAYER_STATE_SOURCE_CROP |
+                 IAHWC_LAYER_STATE_DISPLAY_FRAME | IAHWC_LAYER_STATE_INDEX;
+}
+
+static void test_versions(layer_states_test &test, iahwc_layer_t layer) {
+  iahwc_layer_state_t state;
+  fill_state(&state, layer);
+
+  CHECK(test.set_layer_states(test.device, 0, IAHWC_LAYER_STATE_VERSION,
+                              sizeof(state), 1,
+                              &state) == IAHWC_ERROR_NONE);
+  CHECK(test.set_layer_states(test.device, 0, 0, sizeof(state), 1, &state) ==
+        IAHWC_ERROR_UNSUPPORTED);
+  CHECK(test.set_layer_states(test.device, 0, IAHWC_LAYER_STATE_VERSION + 1,
+                              sizeof(state), 1,
+                              &state) == IAHWC_ERROR_UNSUPPORTED);
+  CHECK(test.set_layer_states(test.device, 0, IAHWC_LAYER_STATE_VERSION,
+                              sizeof(state) - 1, 1,
+                              &state) == IAHWC_ERROR_UNSUPPORTED);
+}
+
+// Bigger states are walked with the caller's stride.
+static void test_stride(layer_states_test &test, iahwc_layer_t first,
+                        iahwc_layer_t second) {
+  layer_state_next states[2];
+  fill_state(&states[0].state, first);
+  fill_state(&states[1].state, second);
+  states[0].unknown_field = ~0ULL;
+  states[1].unknown_field = ~0ULL;
+
+  CHECK(test.set_layer_states(test.device, 0, IAHWC_LAYER_STATE_VERSION,
+                              sizeof(states[0]), 2,
+                              &states[0].state) == IAHWC_ERROR_NONE);
+}
+
+// Fences of unknown layers are closed, the other states still apply.
+static void test_stale_layer(layer_states_test &test, iahwc_layer_t layer) {
+  iahwc_layer_t stale;
+  CHECK(test.create_layer(test.device, 0, &stale) == IAHWC_ERROR_NONE);
+  CHECK(test.destroy_layer(test.device, 0, stale) == IAHWC_ERROR_NONE);
+
+  int fds[2];
+  if (pipe(fds)) {
+    fprintf(stderr, "failed to create pipe: %m\n");
+    TestFailures()++;
+    return;
+  }
+
+  iahwc_layer_state_t states[2];
+  fill_state(&states[0], stale);
+  states[0].acquire_fence = fds[0];
+  states[0].valid |= IAHWC_LAYER_STATE_ACQUIRE_FENCE;
+  fill_state(&states[1], layer);
+
+  CHECK(test.set_layer_states(test.device, 0, IAHWC_LAYER_STATE_VERSION,
+                              sizeof(states[0]), 2,
+                              states) == IAHWC_ERROR_BAD_LAYER);
+  CHECK(!is_fd_open(fds[0]));
+  close(fds[1]);
+}
+
+int main() {
+  void *handle = dlopen("libhwcomposer.so", RTLD_NOW);
+  if (!handle) {
+    printf("Unable to open libhwcomposer.so: %s, skipping.\n", dlerror());
+    return TEST_SKIP;
+  }
+
+  iahwc_module_t *module = (iahwc_module_t *)dlsym(handle, IAHWC_MODULE_STR);
+  layer_states_test test;
+  module->open(module, &test.device);
+
+  IAHWC_PFN_GET_NUM_DISPLAYS get_num_displays =
+      (IAHWC_PFN_GET_NUM_DISPLAYS)test.device->getFunctionPtr(
+          test.device, IAHWC_FUNC_GET_NUM_DISPLAYS);
+  int num_displays = 0;
+  get_num_displays(test.device, &num_displays);
+  if (num_displays < 1) {
+    printf("No display found, skipping.\n");
+    test.device->close(test.device);
+    dlclose(handle);
+    return TEST_SKIP;
+  }
+
+  test.create_layer = (IAHWC_PFN_CREATE_LAYER)test.device->getFunctionPtr(
+      test.device, IAHWC_FUNC_CREATE_LAYER);
+  test.destroy_layer = (IAHWC_PFN_DESTROY_LAYER)test.device->getFunctionPtr(
+      test.device, IAHWC_FUNC_DESTROY_LAYER);
+  test.set_layer_states =
+      (IAHWC_PFN_DISPLAY_SET_LAYER_STATES)test.device->getFunctionPtr(
+          test.device, IAHWC_FUNC_DISPLAY_SET_LAYER_STATES);
+
+  iahwc_layer_t first, second;
+  CHECK(test.create_layer(test.device, 0, &first) == IAHWC_ERROR_NONE);
+  CHECK(test.create_layer(test.device, 0, &second) == IAHWC_ERROR_NONE);
+
+  test_versions(test, first);
+  test_stride(test, first, second);
+  test_stale_layer(test, first);
+
+  test.destroy_layer(test.device, 0, first);
+  test.destroy_layer(test.device, 0, second);
+  test.device->close(test.device);
+  dlclose(handle);
+
+  return TestResult("layer state");
+}
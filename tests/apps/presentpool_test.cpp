@@ -0,0 +1,144 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/* Runs mosaic style presents on HWCWorkerPool and PresentSequencer, with
+ * tasks standing in for the displays. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "hwcworkerpool.h"
+#include "presentsequencer.h"
+#include "testutils.h"
+
+using hwcomposer::HWCWorkerPool;
+using hwcomposer::PresentSequencer;
+
+static const uint32_t kDisplays = 4;
+
+// Blocks every task until all of them have started, which only happens
+// if they run in parallel.
+class Rendezvous {
+ public:
+  explicit Rendezvous(uint32_t total) : total_(total) {
+  }
+
+  bool Arrive() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    arrived_++;
+    cond_.notify_all();
+    return cond_.wait_for(lock, std::chrono::seconds(1),
+                          [this]() { return arrived_ >= total_; });
+  }
+
+ private:
+  uint32_t total_;
+  uint32_t arrived_ = 0;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+// Every task runs once per Run, on the workers and the calling thread.
+static void test_pool(HWCWorkerPool &pool) {
+  for (uint32_t frame = 0; frame < 3; frame++) {
+    Rendezvous rendezvous(kDisplays);
+    std::vector<uint32_t> runs(kDisplays, 0);
+    std::atomic<uint32_t> parallel(0);
+    std::vector<std::function<void()>> tasks;
+    for (uint32_t i = 0; i < kDisplays; i++) {
+      tasks.emplace_back([&rendezvous, &runs, &parallel, i]() {
+        runs.at(i)++;
+        if (rendezvous.Arrive())
+          parallel++;
+      });
+    }
+
+    pool.Run(tasks);
+    for (uint32_t i = 0; i < kDisplays; i++) {
+      CHECK(runs.at(i) == 1);
+    }
+
+    CHECK(parallel == kDisplays);
+  }
+}
+
+// Layer reads happen one display at a time and in display order, however
+// the tasks are scheduled. Displays which don't read still pass their turn.
+static void test_sequencer(HWCWorkerPool &pool) {
+  PresentSequencer sequencer;
+  std::vector<uint32_t> prologues;
+  std::vector<uint32_t> reads;
+  std::atomic<uint32_t> readers(0);
+  bool exclusive = true;
+  CHECK(sequencer.BeginFrame(kDisplays, [&prologues](uint32_t index) {
+    prologues.emplace_back(index);
+  }));
+
+  std::vector<std::function<void()>> tasks;
+  for (uint32_t i = 0; i < kDisplays; i++) {
+    tasks.emplace_back([&, i]() {
+      PresentSequencer::ScopedSlot slot(&sequencer, i);
+      // Later displays try to read first.
+      usleep((kDisplays - i) * 2000);
+      if (i == 1)
+        return;
+
+      PresentSequencer::ScopedLayerRead read;
+      if (readers++ != 0)
+        exclusive = false;
+
+      reads.emplace_back(i);
+      usleep(1000);
+      readers--;
+    });
+  }
+
+  pool.Run(tasks);
+  std::vector<uint32_t> expected_prologues = {0, 1, 2, 3};
+  std::vector<uint32_t> expected_reads = {0, 2, 3};
+  CHECK(prologues == expected_prologues);
+  CHECK(reads == expected_reads);
+  CHECK(exclusive);
+}
+
+// Threads without a slot, i.e. single display presents, never wait.
+static void test_unattached() {
+  PresentSequencer::ScopedLayerRead read;
+  PresentSequencer::ScopedLayerWrite write;
+}
+
+int main() {
+  // The calling thread takes part in the work.
+  HWCWorkerPool pool(kDisplays - 1, "PresentPoolTest");
+  if (!pool.Initialize()) {
+    fprintf(stderr, "Failed to initialize worker pool\n");
+    return 1;
+  }
+
+  test_pool(pool);
+  test_sequencer(pool);
+  test_unattached();
+
+  return TestResult("present pool");
+}
@@ -0,0 +1,201 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/* Counts context switches per frame when components, e.g. the vblank
+ * handlers of several displays, each wake a thread of their own compared
+ * to running as tasks of HWCReactor. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "hwcevent.h"
+#include "hwcreactor.h"
+#include "hwcthread.h"
+
+using hwcomposer::HWCEvent;
+using hwcomposer::HWCReactor;
+using hwcomposer::HWCThread;
+
+// Signals done once every component handled the current frame.
+class FrameCounter {
+ public:
+  bool Initialize(uint32_t components) {
+    components_ = components;
+    return done_.Initialize();
+  }
+
+  void Begin() {
+    pending_ = components_;
+  }
+
+  void Handled() {
+    if (--pending_ == 0)
+      done_.Signal();
+  }
+
+  void Wait() {
+    done_.Wait();
+  }
+
+ private:
+  HWCEvent done_;
+  std::atomic<uint32_t> pending_;
+  uint32_t components_ = 0;
+};
+
+// A component with a thread of its own, like VblankEventHandler without
+// the reactor.
+class ThreadComponent : public HWCThread {
+ public:
+  explicit ThreadComponent(FrameCounter *counter)
+      : HWCThread(-8, "BenchComponent"), counter_(counter) {
+  }
+
+  ~ThreadComponent() override {
+    Exit();
+  }
+
+  bool Initialize() {
+    return InitWorker();
+  }
+
+  void Signal() {
+    Resume();
+  }
+
+ protected:
+  void HandleRoutine() override {
+    counter_->Handled();
+  }
+
+ private:
+  FrameCounter *counter_;
+};
+
+static uint64_t get_context_switches() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+
+  return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// Returns the average number of context switches per frame, or -1 on
+// failure.
+static double run_threads(uint32_t components, uint32_t frames) {
+  FrameCounter counter;
+  if (!counter.Initialize(components))
+    return -1;
+
+  std::vector<std::unique_ptr<ThreadComponent>> threads;
+  for (uint32_t i = 0; i < components; i++) {
+    std::unique_ptr<ThreadComponent> thread(new ThreadComponent(&counter));
+    if (!thread->Initialize()) {
+      fprintf(stderr, "failed to start component thread %u\n", i);
+      return -1;
+    }
+
+    threads.emplace_back(std::move(thread));
+  }
+
+  uint64_t start = get_context_switches();
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    counter.Begin();
+    for (auto &thread : threads) {
+      thread->Signal();
+    }
+
+    counter.Wait();
+  }
+
+  return static_cast<double>(get_context_switches() - start) / frames;
+}
+
+// Same as run_threads, but every component is an event of reactor.
+static double run_reactor(uint32_t components, uint32_t frames,
+                          uint32_t workers) {
+  FrameCounter counter;
+  if (!counter.Initialize(components))
+    return -1;
+
+  HWCReactor reactor(workers, "BenchReactor");
+  if (!reactor.Initialize()) {
+    fprintf(stderr, "failed to start reactor\n");
+    return -1;
+  }
+
+  std::vector<int> events;
+  for (uint32_t i = 0; i < components; i++) {
+    int event = reactor.AddEvent([&counter]() { counter.Handled(); });
+    if (event < 0) {
+      fprintf(stderr, "failed to add reactor event %u\n", i);
+      return -1;
+    }
+
+    events.emplace_back(event);
+  }
+
+  uint64_t start = get_context_switches();
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    counter.Begin();
+    for (int event : events) {
+      reactor.SignalEvent(event);
+    }
+
+    counter.Wait();
+  }
+
+  double result =
+      static_cast<double>(get_context_switches() - start) / frames;
+  for (int event : events) {
+    reactor.RemoveTask(event);
+  }
+
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t frames = 10000;
+  if (argc > 1)
+    frames = strtoul(argv[1], NULL, 10);
+
+  if (!frames) {
+    fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+    return 1;
+  }
+
+  static const uint32_t kComponents[] = {2, 4, 8};
+  printf("%11s %16s %16s %16s\n", "components", "threads (cs/f)",
+         "1 worker (cs/f)", "2 workers (cs/f)");
+  for (uint32_t components : kComponents) {
+    double threads = run_threads(components, frames);
+    double reactor = run_reactor(components, frames, 1);
+    double reactor2 = run_reactor(components, frames, 2);
+    if (threads < 0 || reactor < 0 || reactor2 < 0)
+      return 1;
+
+    printf("%11u %16.2f %16.2f %16.2f\n", components, threads, reactor,
+           reactor2);
+  }
+
+  return 0;
+}
@@ -0,0 +1,53 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef TEST_UTILS_H_
+#define TEST_UTILS_H_
+
+#include <stdio.h>
+
+// Helpers for the tests run by make check. A test reports a failed CHECK
+// without stopping and returns TestResult() from main.
+
+// Exit code for skipped tests, as used by automake.
+#define TEST_SKIP 77
+
+inline int &TestFailures() {
+  static int failures = 0;
+  return failures;
+}
+
+#define CHECK(cond)                                                           \
+  do {                                                                        \
+    if (!(cond)) {                                                            \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,        \
+              #cond);                                                         \
+      TestFailures()++;                                                       \
+    }                                                                         \
+  } while (0)
+
+// Prints a summary for the checks of what and returns the exit code.
+inline int TestResult(const char *what) {
+  if (TestFailures()) {
+    fprintf(stderr, "%d %s checks failed\n", TestFailures(), what);
+    return 1;
+  }
+
+  printf("All %s checks passed.\n", what);
+  return 0;
+}
+
+#endif  // TEST_UTILS_H_
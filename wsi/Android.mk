@@ -58,6 +58,7 @@ LOCAL_SRC_FILES := \
         drm/drmbuffer.cpp \
         drm/drmplane.cpp \
         drm/drmdisplaymanager.cpp \
+        drm/drmcommitbatch.cpp \
 	drm/drmscopedtypes.cpp
 
 ifeq ($(strip $(ENABLE_HYPER_DMABUF_SHARING)), true)
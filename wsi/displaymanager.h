@@ -23,7 +23,9 @@
 
 namespace hwcomposer {
 
+class BufferImportCache;
 class GpuDevice;
+class HWCReactor;
 class DisplayManager {
  public:
   static DisplayManager *CreateDisplayManager();
@@ -46,6 +48,10 @@ class DisplayManager {
   // for Hotplug events.
   virtual void StartHotPlugMonitor() = 0;
 
+  // Monitors Hotplug events on reactor instead of a thread of its own
+  // from now on.
+  virtual void MoveHotPlugMonitorToReactor(HWCReactor *reactor) = 0;
+
   // Refresh all displays managed by this display manager.
   virtual void ForceRefresh() = 0;
 
@@ -91,6 +97,25 @@ class DisplayManager {
   virtual void RemoveUnreservedPlanes() = 0;
 
   virtual FrameBufferManager *GetFrameBufferManager() = 0;
+
+  virtual BufferImportCache *GetBufferImportCache() = 0;
+
+  // Defers commits of displays until FlushCommitBatch is called, so that
+  // they are applied with one atomic commit. Returns false if displays
+  // can't be committed together, in which case nothing is deferred.
+  virtual bool BeginCommitBatch(
+      const std::vector<NativeDisplay *> & /*displays*/) {
+    return false;
+  }
+
+  // Applies commits deferred since BeginCommitBatch. retire_fence is set to
+  // the merged out fences of all displays, or -1.
+  virtual bool FlushCommitBatch(
+      const std::vector<NativeDisplay *> & /*displays*/,
+      int32_t *retire_fence) {
+    *retire_fence = -1;
+    return false;
+  }
 };
 
 }  // namespace hwcomposer
@@ -87,6 +87,12 @@ class DisplayPlane {
    */
   virtual bool IsUniversal() = 0;
 
+  /**
+   * API for querying the widest source crop, in pixels,
+   * this plane can scan out.
+   */
+  virtual uint32_t GetMaxSourceWidth() const = 0;
+
   virtual void Dump() const = 0;
 };
 
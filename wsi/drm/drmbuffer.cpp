@@ -23,8 +23,10 @@
 
 #include <hwcdefs.h>
 #include <nativebufferhandler.h>
+#include "bufferimportcache.h"
 #include "framebuffermanager.h"
 #include "gpudevice.h"
+#include "hwcformats.h"
 #include "hwctrace.h"
 #include "hwcutils.h"
 #include "resourcemanager.h"
@@ -79,10 +81,9 @@ DrmBuffer::~DrmBuffer() {
 
 void DrmBuffer::Initialize(const HwcMeta& meta) {
   format_ = meta.format_;
-  if (format_ == DRM_FORMAT_NV12_Y_TILED_INTEL || format_ == DRM_FORMAT_NV21)
-    format_ = DRM_FORMAT_NV12;
-  else if (format_ == DRM_FORMAT_YVU420_ANDROID)
-    format_ = DRM_FORMAT_YUV420;
+  const HwcFormatInfo* info = GetFormatInfo(format_);
+  if (info)
+    format_ = info->native_format;
 
   if (METADATA(usage_) == hwcomposer::kLayerCursor) {
     // We support DRM_FORMAT_ARGB8888 for cursor.
@@ -99,12 +100,10 @@ void DrmBuffer::InitializeFromNativeHandle(HWCNativeHandle handle,
                                            ResourceManager* resource_manager) {
   fb_manager_ = GpuDevice::getInstance().GetFrameBufferManager();
   resource_manager_ = resource_manager;
-  const NativeBufferHandler* handler =
-      resource_manager_->GetNativeBufferHandler();
+  BufferImportCache* import_cache =
+      GpuDevice::getInstance().GetBufferImportCache();
 
-  handler->CopyHandle(handle, &image_.handle_);
-  if (!handler->ImportBuffer(image_.handle_)) {
-    ETRACE("Failed to Import buffer.");
+  if (!import_cache->AcquireImport(handle, &image_.handle_)) {
     return;
   }
 
@@ -0,0 +1,140 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "drmcommitbatch.h"
+
+#include <errno.h>
+#include <libsync.h>
+#include <unistd.h>
+
+#include <hwctrace.h>
+
+#include "drmdisplay.h"
+
+namespace hwcomposer {
+
+DrmCommitBatch::DrmCommitBatch(uint32_t gpu_fd) : gpu_fd_(gpu_fd) {
+}
+
+DrmCommitBatch::~DrmCommitBatch() {
+  // Requests which were never flushed still belong to their displays.
+  for (Request &request : requests_) {
+    request.display_->CompleteBatchedCommit(-1, false);
+  }
+}
+
+bool DrmCommitBatch::AddRequest(DrmDisplay *display, drmModeAtomicReqPtr pset,
+                                uint32_t flags, bool needs_fence) {
+  ScopedDrmAtomicReqPtr copy(drmModeAtomicDuplicate(pset));
+  if (!copy) {
+    ETRACE("Failed to duplicate property set %d", -ENOMEM);
+    return false;
+  }
+
+  // Displays of a mosaic might be presented from different threads.
+  ScopedSpinLock lock(lock_);
+  requests_.emplace_back();
+  Request &request = requests_.back();
+  request.display_ = display;
+  request.pset_ = std::move(copy);
+  request.flags_ = flags;
+  request.needs_fence_ = needs_fence;
+  request.fence_ = -1;
+  return true;
+}
+
+bool DrmCommitBatch::Flush(int32_t *retire_fence) {
+  *retire_fence = -1;
+  std::vector<Request> requests;
+  lock_.lock();
+  requests.swap(requests_);
+  lock_.unlock();
+  if (requests.empty())
+    return true;
+
+  ScopedDrmAtomicReqPtr pset(drmModeAtomicAlloc());
+  if (!pset) {
+    ETRACE("Failed to allocate property set %d", -ENOMEM);
+    return false;
+  }
+
+  // Only commit without blocking if every display would have.
+  uint32_t flags = 0;
+  bool non_block = true;
+  for (Request &request : requests) {
+    drmModeAtomicMerge(pset.get(), request.pset_.get());
+    flags |= request.flags_;
+    if (!(request.flags_ & DRM_MODE_ATOMIC_NONBLOCK))
+      non_block = false;
+  }
+
+  flags &= ~DRM_MODE_ATOMIC_NONBLOCK;
+  bool combined = drmModeAtomicCommit(gpu_fd_, pset.get(),
+                                      flags | DRM_MODE_ATOMIC_TEST_ONLY,
+                                      NULL) == 0;
+  if (combined) {
+    for (Request &request : requests) {
+      if (request.needs_fence_)
+        request.display_->GetFence(pset.get(), &request.fence_);
+    }
+
+    if (non_block)
+      flags |= DRM_MODE_ATOMIC_NONBLOCK;
+
+    if (drmModeAtomicCommit(gpu_fd_, pset.get(), flags, NULL)) {
+      ETRACE("Failed to commit batched pset ret=%s\n", PRINTERROR());
+      combined = false;
+      for (Request &request : requests) {
+        request.fence_ = -1;
+      }
+    }
+  } else {
+    IDISPLAYMANAGERTRACE("Batched Test Commit Failed. %s ", PRINTERROR());
+  }
+
+  bool success = true;
+  for (Request &request : requests) {
+    bool committed = combined;
+    if (!combined) {
+      // Fall back to committing each CRTC on its own.
+      if (request.needs_fence_)
+        request.display_->GetFence(request.pset_.get(), &request.fence_);
+
+      committed = drmModeAtomicCommit(gpu_fd_, request.pset_.get(),
+                                      request.flags_, NULL) == 0;
+      if (!committed) {
+        ETRACE("Failed to commit pset ret=%s\n", PRINTERROR());
+        request.fence_ = -1;
+        success = false;
+      }
+    }
+
+    if (request.fence_ > 0) {
+      if (*retire_fence < 0) {
+        *retire_fence = dup(request.fence_);
+      } else if (sync_accumulate("iahwc_batch_fence", retire_fence,
+                                 request.fence_)) {
+        ETRACE("Unable to merge fences");
+      }
+    }
+
+    request.display_->CompleteBatchedCommit(request.fence_, committed);
+  }
+
+  return success;
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,67 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef WSI_DRM_COMMIT_BATCH_H_
+#define WSI_DRM_COMMIT_BATCH_H_
+
+#include <stdint.h>
+#include <xf86drmMode.h>
+
+#include <vector>
+
+#include <drmscopedtypes.h>
+#include <spinlock.h>
+
+namespace hwcomposer {
+
+class DrmDisplay;
+
+// Collects the atomic requests of DrmDisplays sharing a DRM device and
+// applies them with a single atomic commit spanning all their CRTCs, so that
+// they flip on the same vblank.
+class DrmCommitBatch {
+ public:
+  DrmCommitBatch(uint32_t gpu_fd);
+  ~DrmCommitBatch();
+
+  // Takes a copy of the request display would have committed on its own
+  // with flags. If needs_fence is true, an out fence for display's CRTC is
+  // requested when the batch is flushed.
+  bool AddRequest(DrmDisplay *display, drmModeAtomicReqPtr pset,
+                  uint32_t flags, bool needs_fence);
+
+  // Commits all collected requests after checking them together with
+  // TEST_ONLY. If the combined request is rejected, requests are committed
+  // one by one as they would have been without batching. retire_fence is
+  // set to the merged out fences of all CRTCs, or -1.
+  bool Flush(int32_t *retire_fence);
+
+ private:
+  struct Request {
+    DrmDisplay *display_;
+    ScopedDrmAtomicReqPtr pset_;
+    uint32_t flags_;
+    bool needs_fence_;
+    int32_t fence_;
+  };
+
+  std::vector<Request> requests_;
+  uint32_t gpu_fd_;
+  SpinLock lock_;
+};
+
+}  // namespace hwcomposer
+#endif  // WSI_DRM_COMMIT_BATCH_H_
@@ -50,6 +50,8 @@ DrmDisplay::DrmDisplay(uint32_t gpu_fd, uint32_t pipe_id, uint32_t crtc_id,
       connector_(0),
       manager_(manager) {
   memset(&current_mode_, 0, sizeof(current_mode_));
+  memset(&boot_mode_, 0, sizeof(boot_mode_));
+  init_time_ns_ = GetMonotonicTimeNs();
 }
 
 DrmDisplay::~DrmDisplay() {
@@ -187,6 +189,13 @@ bool DrmDisplay::ConnectDisplay(const drmModeModeInfo &mode_info,
   config_ = config;
 #endif
 
+  // Only the state found at startup is worth keeping, later the CRTC
+  // holds whatever we left when the previous connector went away.
+  if (!boot_mode_read_) {
+    boot_mode_read_ = true;
+    ReadBootMode(connector);
+  }
+
   ScopedDrmObjectPropertyPtr connector_props(drmModeObjectGetProperties(
       gpu_fd_, connector_, DRM_MODE_OBJECT_CONNECTOR));
   if (!connector_props) {
@@ -556,12 +565,63 @@ bool DrmDisplay::ContainConnector(const uint32_t connector_id) {
   return (connector_ == connector_id);
 }
 
-void DrmDisplay::TraceFirstCommit() {
+static bool IsSameMode(const drmModeModeInfo &a, const drmModeModeInfo &b) {
+  return a.clock == b.clock && a.hdisplay == b.hdisplay &&
+         a.hsync_start == b.hsync_start && a.hsync_end == b.hsync_end &&
+         a.htotal == b.htotal && a.vdisplay == b.vdisplay &&
+         a.vsync_start == b.vsync_start && a.vsync_end == b.vsync_end &&
+         a.vtotal == b.vtotal && a.vscan == b.vscan && a.flags == b.flags;
+}
+
+void DrmDisplay::ReadBootMode(const drmModeConnector *connector) {
+  boot_mode_valid_ = false;
+  if (!connector->encoder_id || !active_prop_)
+    return;
+
+  ScopedDrmEncoderPtr encoder(
+      drmModeGetEncoder(gpu_fd_, connector->encoder_id));
+  if (!encoder || encoder->crtc_id != crtc_id_)
+    return;
+
+  ScopedDrmCrtcPtr crtc(drmModeGetCrtc(gpu_fd_, crtc_id_));
+  if (!crtc || !crtc->mode_valid || !crtc->buffer_id)
+    return;
+
+  // A CRTC turned off through DPMS keeps its mode, it needs a modeset.
+  ScopedDrmObjectPropertyPtr crtc_props(
+      drmModeObjectGetProperties(gpu_fd_, crtc_id_, DRM_MODE_OBJECT_CRTC));
+  if (!crtc_props)
+    return;
+
+  bool active = false;
+  uint32_t count_props = crtc_props->count_props;
+  for (uint32_t i = 0; i < count_props; i++) {
+    if (crtc_props->props[i] == active_prop_) {
+      active = crtc_props->prop_values[i] != 0;
+      break;
+    }
+  }
+
+  if (!active)
+    return;
+
+  boot_mode_ = crtc->mode;
+  boot_mode_valid_ = true;
+  IHOTPLUGEVENTTRACE("Pipe %d scans out fb %d with mode %dx%d@%d at boot.",
+                     pipe_, crtc->buffer_id, boot_mode_.hdisplay,
+                     boot_mode_.vdisplay, boot_mode_.vrefresh);
+}
+
+void DrmDisplay::TraceFirstCommit(bool kept_boot_mode) {
   struct timeval te;
   gettimeofday(&te, NULL);  // get current time
   long long milliseconds =
       te.tv_sec * 1000LL + te.tv_usec / 1000;  // calculate milliseconds
   ITRACE("First frame is Committed at %lld.", milliseconds);
+  uint64_t elapsed_ns = GetMonotonicTimeNs() - init_time_ns_;
+  ITRACE("First frame on pipe %d took %lld ms from initialization, %s.",
+         pipe_, static_cast<long long>(elapsed_ns / 1000000),
+         kept_boot_mode ? "kept boot mode" : "with modeset");
 }
 
 bool DrmDisplay::Commit(
@@ -576,6 +636,7 @@ bool DrmDisplay::Commit(
   // Do the actual commit.
   ScopedDrmAtomicReqPtr pset(drmModeAtomicAlloc());
   *previous_fence_released = false;
+  bool needs_batch_fence = false;
 
   if (!pset) {
     ETRACE("Failed to allocate property set %d", -ENOMEM);
@@ -586,21 +647,55 @@ bool DrmDisplay::Commit(
   if (first_commit_)
     display_queue_->ResetPlanes(pset.get());
 
+  bool kept_boot_mode = false;
+  if ((display_state_ & kNeedsModeset) && boot_mode_valid_ &&
+      IsSameMode(boot_mode_, current_mode_)) {
+    // CRTC already runs the mode we want, flip to our frame instead.
+    IHOTPLUGEVENTTRACE("Keeping boot mode on pipe %d, skipping modeset.",
+                       pipe_);
+    display_state_ &= ~kNeedsModeset;
+    flags_ = disable_explicit_fence ? 0 : DRM_MODE_ATOMIC_NONBLOCK;
+    kept_boot_mode = true;
+  }
+
+  boot_mode_valid_ = false;
   if (display_state_ & kNeedsModeset) {
     if (!ApplyPendingModeset(pset.get())) {
       ETRACE("Failed to Modeset.");
       return false;
     }
   } else if (!disable_explicit_fence && out_fence_ptr_prop_) {
-    GetFence(pset.get(), commit_fence);
+    // Batched commits get their out fence when the batch is flushed.
+    if (commit_batch_)
+      needs_batch_fence = true;
+    else
+      GetFence(pset.get(), commit_fence);
+  }
+
+  if (canvas_color_changed_ &&
+      drmModeAtomicAddProperty(pset.get(), crtc_id_, canvas_color_prop_,
+                               canvas_color_) < 0) {
+    ETRACE("Failed to add canvas color to the commit.");
+    return false;
   }
 
   if (!CommitFrame(composition_planes, previous_composition_planes, pset.get(),
-                   flags_, previous_fence, previous_fence_released)) {
+                   flags_, previous_fence, previous_fence_released,
+                   needs_batch_fence)) {
     ETRACE("Failed to Commit layers.");
+    if (kept_boot_mode) {
+      // Boot state didn't work out after all, do the modeset next frame.
+      display_state_ |= kNeedsModeset;
+      flags_ |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+    }
+
     return false;
   }
 
+  // Batched commits are only applied once the batch is flushed.
+  if (!commit_batch_)
+    canvas_color_changed_ = false;
+
   if (display_state_ & kNeedsModeset) {
     display_state_ &= ~kNeedsModeset;
     if (!disable_explicit_fence) {
@@ -618,17 +713,74 @@ bool DrmDisplay::Commit(
   }
 #endif
   if (first_commit_) {
-    TraceFirstCommit();
+    TraceFirstCommit(kept_boot_mode);
     first_commit_ = false;
   }
   return true;
 }
 
+bool DrmDisplay::CommitCursor(const DisplayPlaneState &cursor_plane,
+                              bool disable_explicit_fence,
+                              int32_t *commit_fence) {
+  // Modesets, batched commits and canvas color changes need to go through
+  // the regular path.
+  if (!manager_->IsDrmMaster() || (display_state_ & kNeedsModeset) ||
+      first_commit_ || commit_batch_ || canvas_color_changed_) {
+    return false;
+  }
+
+  ScopedDrmAtomicReqPtr pset(drmModeAtomicAlloc());
+  if (!pset) {
+    ETRACE("Failed to allocate property set %d", -ENOMEM);
+    return false;
+  }
+
+  if (!disable_explicit_fence && out_fence_ptr_prop_)
+    GetFence(pset.get(), commit_fence);
+
+  DrmPlane *plane = static_cast<DrmPlane *>(cursor_plane.GetDisplayPlane());
+  OverlayLayer *layer = (OverlayLayer *)cursor_plane.GetOverlayLayer();
+  int32_t fence = layer->GetAcquireFence();
+  if (fence > 0) {
+    plane->SetNativeFence(dup(fence));
+  } else {
+    plane->SetNativeFence(-1);
+  }
+
+  if (!plane->UpdateCursorProperties(pset.get(), layer))
+    return false;
+
+  // Unlike CommitFrame, don't wait for the previous frame to be done. If
+  // it's still pending the kernel rejects this commit with EBUSY and the
+  // caller falls back to a regular commit.
+  int ret = drmModeAtomicCommit(gpu_fd_, pset.get(),
+                                DRM_MODE_ATOMIC_NONBLOCK, NULL);
+  if (ret) {
+    IDISPLAYMANAGERTRACE("Cursor commit failed ret=%s\n", PRINTERROR());
+    if (*commit_fence > 0) {
+      close(*commit_fence);
+      *commit_fence = 0;
+    }
+    return false;
+  }
+
+  plane->SetBuffer(layer->GetSharedBuffer());
+
+#ifdef ENABLE_DOUBLE_BUFFERING
+  if (*commit_fence > 0) {
+    HWCPoll(*commit_fence, -1);
+    close(*commit_fence);
+    *commit_fence = 0;
+  }
+#endif
+  return true;
+}
+
 bool DrmDisplay::CommitFrame(
     const DisplayPlaneStateList &comp_planes,
     const DisplayPlaneStateList &previous_composition_planes,
     drmModeAtomicReqPtr pset, uint32_t flags, int32_t previous_fence,
-    bool *previous_fence_released) {
+    bool *previous_fence_released, bool needs_batch_fence) {
   CTRACE();
   if (!pset) {
     ETRACE("Failed to allocate property set %d", -ENOMEM);
@@ -688,6 +840,10 @@ bool DrmDisplay::CommitFrame(
   }
 #endif
 
+  if (commit_batch_) {
+    return commit_batch_->AddRequest(this, pset, flags, needs_batch_fence);
+  }
+
   int ret = drmModeAtomicCommit(gpu_fd_, pset, flags, NULL);
   if (ret) {
     ETRACE("Failed to commit pset ret=%s\n", PRINTERROR());
@@ -697,6 +853,20 @@ bool DrmDisplay::CommitFrame(
   return true;
 }
 
+void DrmDisplay::CompleteBatchedCommit(int32_t fence, bool committed) {
+  if (committed)
+    canvas_color_changed_ = false;
+
+#ifdef ENABLE_DOUBLE_BUFFERING
+  if (fence > 0) {
+    HWCPoll(fence, -1);
+    close(fence);
+    fence = 0;
+  }
+#endif
+  display_queue_->HandleBatchedCommit(fence, committed);
+}
+
 void DrmDisplay::SetDrmModeInfo(const std::vector<drmModeModeInfo> &mode_info) {
   SPIN_LOCK(display_lock_);
   uint32_t size = mode_info.size();
@@ -892,7 +1062,7 @@ uint64_t DrmDisplay::DrmRGBA(uint16_t bpc, uint16_t red, uint16_t green,
 }
 
 void DrmDisplay::SetPipeCanvasColor(uint16_t bpc, uint16_t red, uint16_t green,
-                                    uint16_t blue, uint16_t alpha) const {
+                                    uint16_t blue, uint16_t alpha) {
   if (canvas_color_prop_ == 0)
     return;
 
@@ -902,8 +1072,10 @@ void DrmDisplay::SetPipeCanvasColor(uint16_t bpc, uint16_t red, uint16_t green,
   else if (bpc == 16)
     canvas_color = DRM_RGBA16161616(red, green, blue, alpha);
 
-  drmModeObjectSetProperty(gpu_fd_, crtc_id_, DRM_MODE_OBJECT_CRTC,
-                           canvas_color_prop_, canvas_color);
+  // Setting the property on its own would show the new color a frame
+  // before or after the planes it belongs to.
+  canvas_color_ = canvas_color;
+  canvas_color_changed_ = true;
 }
 
 bool DrmDisplay::SetPipeMaxBpc(uint16_t max_bpc) const {
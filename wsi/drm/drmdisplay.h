@@ -23,6 +23,7 @@
 
 #include <drmscopedtypes.h>
 
+#include "drmcommitbatch.h"
 #include "drmplane.h"
 #include "physicaldisplay.h"
 
@@ -75,7 +76,10 @@ class DrmDisplay : public PhysicalDisplay {
   void SetColorCorrection(struct gamma_colors gamma, uint32_t contrast,
                           uint32_t brightness) const override;
   void SetPipeCanvasColor(uint16_t bpc, uint16_t red, uint16_t green,
-                          uint16_t blue, uint16_t alpha) const override;
+                          uint16_t blue, uint16_t alpha) override;
+  bool SupportsPipeCanvasColor() const override {
+    return canvas_color_prop_ != 0;
+  }
   bool SetPipeMaxBpc(uint16_t max_bpc) const override;
   void SetColorTransformMatrix(
       const float *color_transform_matrix,
@@ -85,6 +89,12 @@ class DrmDisplay : public PhysicalDisplay {
               const DisplayPlaneStateList &previous_composition_planes,
               bool disable_explicit_fence, int32_t previous_fence,
               int32_t *commit_fence, bool *previous_fence_released) override;
+  bool CommitCursor(const DisplayPlaneState &cursor_plane,
+                    bool disable_explicit_fence,
+                    int32_t *commit_fence) override;
+  bool IsCommitBatched() const override {
+    return commit_batch_ != NULL;
+  }
 
   uint32_t CrtcId() const {
     return crtc_id_;
@@ -133,6 +143,21 @@ class DrmDisplay : public PhysicalDisplay {
     first_commit_ = true;
   }
 
+  // While a batch is set, commits are handed over to it instead of being
+  // applied immediately. The batch calls CompleteBatchedCommit once the
+  // request has been flushed.
+  void SetCommitBatch(DrmCommitBatch *batch) {
+    commit_batch_ = batch;
+  }
+
+  DrmCommitBatch *GetCommitBatch() const {
+    return commit_batch_;
+  }
+
+  void CompleteBatchedCommit(int32_t fence, bool committed);
+
+  bool GetFence(drmModeAtomicReqPtr property_set, int32_t *out_fence);
+
  private:
   void ShutDownPipe();
   void GetDrmObjectPropertyValue(const char *name,
@@ -153,11 +178,11 @@ class DrmDisplay : public PhysicalDisplay {
                        struct drm_color_ctm_post_offset *ctm_post_offset) const;
   void ApplyPendingLUT(struct drm_color_lut *lut) const;
   bool ApplyPendingModeset(drmModeAtomicReqPtr property_set);
-  bool GetFence(drmModeAtomicReqPtr property_set, int32_t *out_fence);
   bool CommitFrame(const DisplayPlaneStateList &comp_planes,
                    const DisplayPlaneStateList &previous_composition_planes,
                    drmModeAtomicReqPtr pset, uint32_t flags,
-                   int32_t previous_fence, bool *previous_fence_released);
+                   int32_t previous_fence, bool *previous_fence_released,
+                   bool needs_batch_fence);
   uint64_t DrmRGBA(uint16_t, uint16_t red, uint16_t green, uint16_t blue,
                    uint16_t alpha) const;
   std::unique_ptr<DrmPlane> CreatePlane(uint32_t plane_id,
@@ -166,7 +191,12 @@ class DrmDisplay : public PhysicalDisplay {
                                                   uint8_t block_tag);
   void DrmConnectorGetDCIP3Support(const ScopedDrmObjectPropertyPtr &props);
 
-  void TraceFirstCommit();
+  // Reads back the mode the CRTC is scanning out with, i.e. the boot
+  // framebuffer left by firmware or a previous compositor, if it drives
+  // connector.
+  void ReadBootMode(const drmModeConnector *connector);
+
+  void TraceFirstCommit(bool kept_boot_mode);
 
   uint32_t FindPreferedDisplayMode(size_t modes_size);
   uint32_t FindPerformaceDisplayMode(size_t modes_size);
@@ -189,6 +219,9 @@ class DrmDisplay : public PhysicalDisplay {
   uint32_t hdcp_srm_id_prop_ = 0;
   uint32_t edid_prop_ = 0;
   uint32_t canvas_color_prop_ = 0;
+  // Canvas color to add to the next commit.
+  uint64_t canvas_color_ = 0;
+  bool canvas_color_changed_ = false;
   uint32_t connector_ = 0;
   bool dcip3_ = false;
   uint32_t max_bpc_prop_ = 0;
@@ -206,10 +239,18 @@ class DrmDisplay : public PhysicalDisplay {
   HWCContentProtection desired_protection_support_ =
       HWCContentProtection::kUnSupported;
   drmModeModeInfo current_mode_;
+  // Mode read back by ReadBootMode. If the first modeset would set the
+  // same mode, it is skipped and the first commit just flips to our
+  // frame, so that the boot framebuffer stays on screen until then.
+  drmModeModeInfo boot_mode_;
+  bool boot_mode_valid_ = false;
+  bool boot_mode_read_ = false;
+  uint64_t init_time_ns_ = 0;
   HWCContentType content_type_ = kCONTENT_TYPE0;
   std::vector<drmModeModeInfo> modes_;
   SpinLock display_lock_;
   DrmDisplayManager *manager_;
+  DrmCommitBatch *commit_batch_ = NULL;
 };
 
 }  // namespace hwcomposer
@@ -33,17 +33,31 @@
 
 #include <gpudevice.h>
 #include <hwctrace.h>
+#include <hwcreactor.h>
+#include <hwcutils.h>
 
 #include <nativebufferhandler.h>
 
 namespace hwcomposer {
 
+// Hotplug events are handled once no new event arrived for
+// kHotPlugSettleNs, or at the latest kHotPlugMaxDelayNs after the first
+// one. Docks and KVM switches send bursts of them.
+static const uint64_t kHotPlugSettleNs = 100 * 1000 * 1000;
+static const uint64_t kHotPlugMaxDelayNs = 500 * 1000 * 1000;
+
 DrmDisplayManager::DrmDisplayManager() : HWCThread(-8, "DisplayManager") {
   CTRACE();
 }
 
 DrmDisplayManager::~DrmDisplayManager() {
   CTRACE();
+  HWCThread::Exit();
+  if (reactor_) {
+    reactor_->RemoveTask(hotplug_task_);
+    reactor_->RemoveTask(hotplug_timer_);
+  }
+
   std::vector<std::unique_ptr<DrmDisplay>>().swap(displays_);
 
 #ifndef DISABLE_HOTPLUG_NOTIFICATION
@@ -133,7 +147,6 @@ bool DrmDisplayManager::Initialize() {
 
 void DrmDisplayManager::HotPlugEventHandler() {
   CTRACE();
-  int fd = hotplug_fd_;
   char buffer[DRM_HOTPLUG_EVENT_SIZE];
   int ret;
 
@@ -141,9 +154,10 @@ void DrmDisplayManager::HotPlugEventHandler() {
   while (true) {
     bool drm_event = false, hotplug_event = false;
     size_t srclen = DRM_HOTPLUG_EVENT_SIZE - 1;
-    ret = read(fd, &buffer, srclen);
+    ret = recv(hotplug_fd_, &buffer, srclen, MSG_DONTWAIT);
     if (ret <= 0) {
-      if (ret < 0)
+      if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+          errno != EINTR)
         ETRACE("Failed to read uevent. %s", PRINTERROR());
 
       return;
@@ -168,16 +182,46 @@ void DrmDisplayManager::HotPlugEventHandler() {
     }
 
     if (drm_event && hotplug_event) {
-      IHOTPLUGEVENTTRACE(
-          "Recieved Hot Plug event related to display calling "
-          "UpdateDisplayState.");
-      UpdateDisplayState();
+      IHOTPLUGEVENTTRACE("Recieved Hot Plug event related to display.");
+      hotplug_lock_.lock();
+      last_event_ns_ = GetMonotonicTimeNs();
+      if (!first_event_ns_)
+        first_event_ns_ = last_event_ns_;
+      hotplug_lock_.unlock();
     }
   }
 }
 
+uint64_t DrmDisplayManager::GetHotPlugSettleNs() const {
+  if (!first_event_ns_)
+    return 0;
+
+  uint64_t now = GetMonotonicTimeNs();
+  uint64_t deadline = std::min(last_event_ns_ + kHotPlugSettleNs,
+                               first_event_ns_ + kHotPlugMaxDelayNs);
+  return now < deadline ? deadline - now : 1;
+}
+
+void DrmDisplayManager::HandleSettledHotPlug() {
+  hotplug_lock_.lock();
+  if (!first_event_ns_ || GetHotPlugSettleNs() > 1) {
+    hotplug_lock_.unlock();
+    return;
+  }
+
+  first_event_ns_ = 0;
+  hotplug_lock_.unlock();
+
+  IHOTPLUGEVENTTRACE("Hot Plug events settled, calling UpdateDisplayState.");
+  UpdateDisplayState();
+}
+
 void DrmDisplayManager::HandleWait() {
-  if (fd_handler_.Poll(-1) <= 0) {
+  int timeout = -1;
+  if (settle_ns_)
+    timeout = static_cast<int>((settle_ns_ + 999999) / 1000000);
+
+  if (fd_handler_.Poll(timeout) < 0) {
     ETRACE("Poll Failed in DisplayManager %s", PRINTERROR());
   }
 }
@@ -190,6 +234,8 @@ void DrmDisplayManager::InitializeDisplayResources() {
     return;
   }
 
+  buffer_import_cache_.reset(new BufferImportCache(buffer_handler_.get()));
+
   int size = displays_.size();
   for (int i = 0; i < size; ++i) {
     if (!displays_.at(i)->Initialize(buffer_handler_.get())) {
@@ -209,6 +255,54 @@ void DrmDisplayManager::StartHotPlugMonitor() {
   }
 }
 
+void DrmDisplayManager::MoveHotPlugMonitorToReactor(HWCReactor *reactor) {
+#ifndef DISABLE_HOTPLUG_NOTIFICATION
+  if (!reactor || reactor_ || hotplug_fd_ < 0)
+    return;
+
+  int timer = reactor->AddTimer([this]() {
+    HandleSettledHotPlug();
+    ArmHotPlugTimer();
+  });
+  if (timer < 0)
+    return;
+
+  // Stop the thread first, so that it doesn't read the events the
+  // reactor is waiting for.
+  Exit();
+  reactor_ = reactor;
+  hotplug_timer_ = timer;
+  hotplug_task_ = reactor_->AddFd(hotplug_fd_, [this]() {
+    HotPlugEventHandler();
+    ArmHotPlugTimer();
+  });
+
+  if (hotplug_task_ < 0) {
+    ETRACE("Failed to move Hot Plug monitor to reactor.");
+    reactor_->RemoveTask(hotplug_timer_);
+    reactor_ = NULL;
+    hotplug_timer_ = -1;
+    if (!InitWorker()) {
+      ETRACE("Failed to initalizer thread to monitor Hot Plug events. %s",
+             PRINTERROR());
+    }
+
+    return;
+  }
+
+  // Handle events which the thread received but didn't settle yet.
+  ArmHotPlugTimer();
+#endif
+}
+
+void DrmDisplayManager::ArmHotPlugTimer() {
+  // Display state is only updated from the timer, so that it is never
+  // updated from two workers at once.
+  hotplug_lock_.lock();
+  reactor_->ArmTimer(hotplug_timer_, GetHotPlugSettleNs(), 0);
+  hotplug_lock_.unlock();
+}
+
 void DrmDisplayManager::HandleRoutine() {
   CTRACE();
   IHOTPLUGEVENTTRACE("DisplayManager::Routine.");
@@ -216,6 +310,120 @@ void DrmDisplayManager::HandleRoutine() {
     IHOTPLUGEVENTTRACE("Recieved Hot plug notification.");
     HotPlugEventHandler();
   }
+
+  HandleSettledHotPlug();
+  hotplug_lock_.lock();
+  settle_ns_ = GetHotPlugSettleNs();
+  hotplug_lock_.unlock();
+}
+
+size_t DrmDisplayManager::GetMonitorHash(
+    const drmModeConnector *connector) const {
+  size_t hash = 0;
+  ScopedDrmObjectPropertyPtr props(drmModeObjectGetProperties(
+      fd_, connector->connector_id, DRM_MODE_OBJECT_CONNECTOR));
+  if (props) {
+    uint32_t count_props = props->count_props;
+    for (uint32_t i = 0; i < count_props; i++) {
+      ScopedDrmPropertyPtr property(drmModeGetProperty(fd_, props->props[i]));
+      if (!property || strcmp(property->name, "EDID"))
+        continue;
+
+      drmModePropertyBlobPtr blob =
+          drmModeGetPropertyBlob(fd_, props->prop_values[i]);
+      if (blob) {
+        const uint8_t *edid = static_cast<const uint8_t *>(blob->data);
+        for (uint32_t j = 0; j < blob->length; j++)
+          hash_combine_hwc(hash, edid[j]);
+
+        drmModeFreePropertyBlob(blob);
+      }
+
+      break;
+    }
+  }
+
+  if (hash)
+    return hash;
+
+  int32_t count_modes = connector->count_modes;
+  for (int32_t i = 0; i < count_modes; i++) {
+    const drmModeModeInfo &mode = connector->modes[i];
+    hash_combine_hwc(hash, mode.clock);
+    hash_combine_hwc(hash, mode.hdisplay);
+    hash_combine_hwc(hash, mode.vdisplay);
+    hash_combine_hwc(hash, mode.vrefresh);
+    hash_combine_hwc(hash, mode.flags);
+  }
+
+  return hash;
+}
+
+bool DrmDisplayManager::ProbeConnectors(
+    const drmModeRes *res, std::vector<ScopedDrmConnectorPtr> &connectors) {
+  bool changed = false;
+  int32_t total_connectors = res->count_connectors;
+  for (int32_t i = 0; i < total_connectors; ++i) {
+    uint32_t connector_id = res->connectors[i];
+    // Unlike drmModeGetConnector, this returns what the kernel found when
+    // it sent the hotplug event without probing the connector again.
+    ScopedDrmConnectorPtr connector(
+        drmModeGetConnectorCurrent(fd_, connector_id));
+    if (!connector) {
+      ETRACE("Failed to get connector %d", connector_id);
+      changed = true;
+      break;
+    }
+
+    size_t monitor_hash = 0;
+    if (connector->connection == DRM_MODE_CONNECTED)
+      monitor_hash = GetMonitorHash(connector.get());
+
+    auto state = connector_states_.find(connector_id);
+    if (state != connector_states_.end() &&
+        state->second.connection == connector->connection &&
+        state->second.monitor_hash == monitor_hash) {
+      connectors.emplace_back(std::move(connector));
+      continue;
+    }
+
+    connector.reset(drmModeGetConnector(fd_, connector_id));
+    if (!connector) {
+      ETRACE("Failed to probe connector %d", connector_id);
+      changed = true;
+      break;
+    }
+
+    ConnectorState probed;
+    probed.connection = connector->connection;
+    if (connector->connection == DRM_MODE_CONNECTED) {
+      probed.monitor_hash = GetMonitorHash(connector.get());
+      uint32_t size = connector->count_modes;
+      probed.modes.resize(size);
+      for (uint32_t j = 0; j < size; ++j) {
+        probed.modes[j] = connector->modes[j];
+        // There is only one preferred mode per connector.
+        if (probed.modes[j].type & DRM_MODE_TYPE_PREFERRED) {
+          probed.preferred_mode = j;
+        }
+      }
+    }
+
+    // A monitor which went away and came back within the debounce window
+    // or a KVM switching between identical monitors is no change.
+    if (state == connector_states_.end() ||
+        state->second.connection != probed.connection ||
+        state->second.monitor_hash != probed.monitor_hash) {
+      IHOTPLUGEVENTTRACE("Connector %d changed, connection: %d \n",
+                         connector_id, probed.connection);
+      changed = true;
+    }
+
+    connector_states_[connector_id] = std::move(probed);
+    connectors.emplace_back(std::move(connector));
+  }
+
+  return changed;
 }
 
 bool DrmDisplayManager::UpdateDisplayState() {
@@ -226,6 +434,13 @@ bool DrmDisplayManager::UpdateDisplayState() {
     return false;
   }
 
+  // Probe before taking spin_lock_, so that presenting isn't blocked.
+  std::vector<ScopedDrmConnectorPtr> connectors;
+  if (!ProbeConnectors(res.get(), connectors)) {
+    IHOTPLUGEVENTTRACE("No connector changed, ignoring Hot Plug event.");
+    return true;
+  }
+
   spin_lock_.lock();
   // Start of assuming no displays are connected
   for (auto &display : displays_) {
@@ -237,59 +452,34 @@ bool DrmDisplayManager::UpdateDisplayState() {
   connected_display_count_ = 0;
   std::vector<NativeDisplay *> connected_displays;
   std::vector<uint32_t> no_encoder;
-  uint32_t total_connectors = res->count_connectors;
+  uint32_t total_connectors = connectors.size();
   for (uint32_t i = 0; i < total_connectors; ++i) {
-    ScopedDrmConnectorPtr connector(
-        drmModeGetConnector(fd_, res->connectors[i]));
-    if (!connector) {
-      ETRACE("Failed to get connector %d", res->connectors[i]);
-      break;
-    }
     // check if a monitor is connected.
-    if (connector->connection != DRM_MODE_CONNECTED) {
-      connector.reset();
-      continue;
-    }
-    connected_display_count_++;
-    connector.reset();
+    if (connectors.at(i)->connection == DRM_MODE_CONNECTED)
+      connected_display_count_++;
   }
 
   for (uint32_t i = 0; i < total_connectors; ++i) {
-    ScopedDrmConnectorPtr connector(
-        drmModeGetConnector(fd_, res->connectors[i]));
-    if (!connector) {
-      ETRACE("Failed to get connector %d", res->connectors[i]);
-      break;
-    }
+    const drmModeConnector *connector = connectors.at(i).get();
     // check if a monitor is connected.
     if (connector->connection != DRM_MODE_CONNECTED) {
-      connector.reset();
       continue;
     }
 
     // Ensure we have atleast one valid mode.
-    if (connector->count_modes == 0) {
-      connector.reset();
+    const ConnectorState &state =
+        connector_states_.at(connector->connector_id);
+    if (state.modes.empty()) {
       continue;
     }
 
     if (connector->encoder_id == 0) {
       no_encoder.emplace_back(i);
-      connector.reset();
       continue;
     }
 
-    std::vector<drmModeModeInfo> mode;
-    uint32_t preferred_mode = 0;
-    uint32_t size = connector->count_modes;
-    mode.resize(size);
-    for (uint32_t i = 0; i < size; ++i) {
-      mode[i] = connector->modes[i];
-      // There is only one preferred mode per connector.
-      if (mode[i].type & DRM_MODE_TYPE_PREFERRED) {
-        preferred_mode = i;
-      }
-    }
+    const std::vector<drmModeModeInfo> &mode = state.modes;
+    uint32_t preferred_mode = state.preferred_mode;
 
     // Lets try to find crts for any connected encoder.
     ScopedDrmEncoderPtr encoder(drmModeGetEncoder(fd_, connector->encoder_id));
@@ -300,7 +490,7 @@ bool DrmDisplayManager::UpdateDisplayState() {
             encoder->crtc_id, display->CrtcId(), display->IsConnected());
         // At initilaization  preferred mode is set!
         if (!display->IsConnected() && encoder->crtc_id == display->CrtcId() &&
-            display->ConnectDisplay(mode.at(preferred_mode), connector.get(),
+            display->ConnectDisplay(mode.at(preferred_mode), connector,
                                     preferred_mode)) {
           IHOTPLUGEVENTTRACE("Connected %d with crtc: %d pipe:%d \n",
                              encoder->crtc_id, display->CrtcId(),
@@ -313,34 +503,20 @@ bool DrmDisplayManager::UpdateDisplayState() {
     }
 
     encoder.reset();
-    connector.reset();
   }
 
   // Deal with connectors with encoder_id == 0.
   uint32_t size = no_encoder.size();
   for (uint32_t i = 0; i < size; ++i) {
-    ScopedDrmConnectorPtr connector(
-        drmModeGetConnector(fd_, res->connectors[no_encoder.at(i)]));
-    if (!connector) {
-      ETRACE("Failed to get connector %d", res->connectors[i]);
-      break;
-    }
-
-    std::vector<drmModeModeInfo> mode;
-    uint32_t preferred_mode = 0;
-    uint32_t size = connector->count_modes;
-    mode.resize(size);
-    for (uint32_t i = 0; i < size; ++i) {
-      mode[i] = connector->modes[i];
-      // There is only one preferred mode per connector.
-      if (mode[i].type & DRM_MODE_TYPE_PREFERRED) {
-        preferred_mode = i;
-      }
-    }
+    const drmModeConnector *connector = connectors.at(no_encoder.at(i)).get();
+    const ConnectorState &state =
+        connector_states_.at(connector->connector_id);
+    const std::vector<drmModeModeInfo> &mode = state.modes;
+    uint32_t preferred_mode = state.preferred_mode;
 
     // Try to find an encoder for the connector.
-    size = connector->count_encoders;
-    for (uint32_t j = 0; j < size; ++j) {
+    uint32_t count_encoders = connector->count_encoders;
+    for (uint32_t j = 0; j < count_encoders; ++j) {
       ScopedDrmEncoderPtr encoder(
           drmModeGetEncoder(fd_, connector->encoders[j]));
       if (!encoder)
@@ -349,7 +525,7 @@ bool DrmDisplayManager::UpdateDisplayState() {
       for (auto &display : displays_) {
         if (!display->IsConnected() &&
             (encoder->possible_crtcs & (1 << display->GetDisplayPipe())) &&
-            display->ConnectDisplay(mode.at(preferred_mode), connector.get(),
+            display->ConnectDisplay(mode.at(preferred_mode), connector,
                                     preferred_mode)) {
           IHOTPLUGEVENTTRACE("Connected with crtc: %d pipe:%d \n",
                              display->CrtcId(), display->GetDisplayPipe());
@@ -361,8 +537,6 @@ bool DrmDisplayManager::UpdateDisplayState() {
 
       encoder.reset();
     }
-
-    connector.reset();
   }
 
   for (auto &display : displays_) {
@@ -630,6 +804,65 @@ FrameBufferManager *DrmDisplayManager::GetFrameBufferManager() {
   return frame_buffer_manager_.get();
 }
 
+BufferImportCache *DrmDisplayManager::GetBufferImportCache() {
+  return buffer_import_cache_.get();
+}
+
+DrmDisplay *DrmDisplayManager::GetDrmDisplay(NativeDisplay *display) {
+  size_t size = displays_.size();
+  for (size_t i = 0; i < size; ++i) {
+    DrmDisplay *drm_display = displays_.at(i).get();
+    if (static_cast<NativeDisplay *>(drm_display) == display)
+      return drm_display;
+  }
+
+  return NULL;
+}
+
+bool DrmDisplayManager::BeginCommitBatch(
+    const std::vector<NativeDisplay *> &displays) {
+  if (displays.size() < 2)
+    return false;
+
+  // All displays need to be driven by this device and not be part of
+  // another batch.
+  std::vector<DrmDisplay *> drm_displays;
+  for (NativeDisplay *display : displays) {
+    DrmDisplay *drm_display = GetDrmDisplay(display);
+    if (!drm_display || drm_display->GetCommitBatch())
+      return false;
+
+    drm_displays.emplace_back(drm_display);
+  }
+
+  DrmCommitBatch *batch = new DrmCommitBatch(fd_);
+  for (DrmDisplay *drm_display : drm_displays) {
+    drm_display->SetCommitBatch(batch);
+  }
+
+  return true;
+}
+
+bool DrmDisplayManager::FlushCommitBatch(
+    const std::vector<NativeDisplay *> &displays, int32_t *retire_fence) {
+  *retire_fence = -1;
+  if (displays.empty())
+    return false;
+
+  DrmDisplay *drm_display = GetDrmDisplay(displays.at(0));
+  if (!drm_display || !drm_display->GetCommitBatch())
+    return false;
+
+  std::unique_ptr<DrmCommitBatch> batch(drm_display->GetCommitBatch());
+  for (NativeDisplay *display : displays) {
+    drm_display = GetDrmDisplay(display);
+    if (drm_display)
+      drm_display->SetCommitBatch(NULL);
+  }
+
+  return batch->Flush(retire_fence);
+}
+
 #ifdef ENABLE_PANORAMA
 NativeDisplay *DrmDisplayManager::CreateVirtualPanoramaDisplay(
     uint32_t display_index) {
@@ -19,12 +19,14 @@
 
 #include <stdint.h>
 
+#include <map>
 #include <memory>
 #include <utility>
 #include <vector>
 
 #include "spinlock.h"
 
+#include "bufferimportcache.h"
 #include "displaymanager.h"
 #include "displayplanemanager.h"
 #include "drmdisplay.h"
@@ -55,6 +57,8 @@ class DrmDisplayManager : public HWCThread, public DisplayManager {
 
   void StartHotPlugMonitor() override;
 
+  void MoveHotPlugMonitorToReactor(HWCReactor *reactor) override;
+
   NativeDisplay *CreateVirtualDisplay(uint32_t display_index) override;
   void DestroyVirtualDisplay(uint32_t display_index) override;
 
@@ -103,22 +107,66 @@ class DrmDisplayManager : public HWCThread, public DisplayManager {
 
   FrameBufferManager *GetFrameBufferManager() override;
 
+  BufferImportCache *GetBufferImportCache() override;
+
+  bool BeginCommitBatch(const std::vector<NativeDisplay *> &displays) override;
+  bool FlushCommitBatch(const std::vector<NativeDisplay *> &displays,
+                        int32_t *retire_fence) override;
+
  protected:
   void HandleWait() override;
   void HandleRoutine() override;
 
  private:
+  // Last probed state of a connector.
+  struct ConnectorState {
+    uint32_t connection = 0;
+    // Identifies the connected monitor, computed from its EDID or, if it
+    // has none, from its modes.
+    size_t monitor_hash = 0;
+    std::vector<drmModeModeInfo> modes;
+    uint32_t preferred_mode = 0;
+  };
+
+  // Reads all pending uevents and notes when Hot Plug events arrived.
   void HotPlugEventHandler();
+  // Returns the time in ns until pending Hot Plug events settle, 1 if
+  // they already did or 0 if none are pending. Must be called with
+  // hotplug_lock_ held.
+  uint64_t GetHotPlugSettleNs() const;
+  // Updates the display state if pending Hot Plug events settled.
+  void HandleSettledHotPlug();
+  void ArmHotPlugTimer();
   bool UpdateDisplayState();
+  // Reads all connectors of res into connectors. Only connectors whose
+  // current state differs from connector_states_ are probed, as a probe
+  // reads the EDID and stalls commits meanwhile. Returns true if a
+  // monitor was connected, disconnected or replaced since the last call.
+  bool ProbeConnectors(const drmModeRes *res,
+                       std::vector<ScopedDrmConnectorPtr> &connectors);
+  size_t GetMonitorHash(const drmModeConnector *connector) const;
+  DrmDisplay *GetDrmDisplay(NativeDisplay *display);
   std::map<uint32_t, std::unique_ptr<NativeDisplay>> virtual_displays_;
   std::unique_ptr<FrameBufferManager> frame_buffer_manager_;
+  std::unique_ptr<BufferImportCache> buffer_import_cache_;
   std::vector<std::unique_ptr<DrmDisplay>> displays_;
+  // Keyed by connector id, only accessed from UpdateDisplayState.
+  std::map<uint32_t, ConnectorState> connector_states_;
   std::shared_ptr<DisplayHotPlugEventCallback> callback_ = NULL;
   std::unique_ptr<NativeBufferHandler> buffer_handler_;
   GpuDevice &device_ = GpuDevice::getInstance();
   bool ignore_updates_ = false;
   int fd_ = -1;
   int hotplug_fd_ = -1;
+  // Arrival of the first and last Hot Plug event not handled yet.
+  uint64_t first_event_ns_ = 0;
+  uint64_t last_event_ns_ = 0;
+  // Only accessed from the thread of the display manager.
+  uint64_t settle_ns_ = 0;
+  SpinLock hotplug_lock_;
+  HWCReactor *reactor_ = NULL;
+  int hotplug_task_ = -1;
+  int hotplug_timer_ = -1;
   bool notify_client_ = false;
   bool release_lock_ = false;
   SpinLock spin_lock_;
@@ -28,13 +28,20 @@
 
 namespace hwcomposer {
 
+// Used when the kernel doesn't bound SRC_W, which is the case for i915.
+// This is what planes and plane scalers accept for all formats on gen9,
+// newer platforms can raise it at build time.
+#ifndef MAX_PLANE_SOURCE_WIDTH
+#define MAX_PLANE_SOURCE_WIDTH 4096
+#endif
+
 DrmPlane::Property::Property() {
 }
 
 bool DrmPlane::Property::Initialize(
     uint32_t fd, const char* name,
     const ScopedDrmObjectPropertyPtr& plane_props, uint32_t* rotation,
-    uint64_t* in_formats_prop_value) {
+    uint64_t* in_formats_prop_value, uint64_t* range_max) {
   uint32_t count_props = plane_props->count_props;
   for (uint32_t i = 0; i < count_props; i++) {
     ScopedDrmPropertyPtr property(
@@ -64,6 +71,10 @@ bool DrmPlane::Property::Initialize(
           *in_formats_prop_value = plane_props->prop_values[i];
         }
       }
+      if (range_max && (property->flags & DRM_MODE_PROP_RANGE) &&
+          property->count_values > 1) {
+        *range_max = property->values[1];
+      }
       break;
     }
   }
@@ -174,10 +185,17 @@ bool DrmPlane::Initialize(uint32_t gpu_fd, const std::vector<uint32_t>& formats,
   if (!ret)
     return false;
 
-  ret = src_w_prop_.Initialize(gpu_fd, "SRC_W", plane_props);
+  uint64_t src_w_max = 0;
+  ret = src_w_prop_.Initialize(gpu_fd, "SRC_W", plane_props, NULL, NULL,
+                               &src_w_max);
   if (!ret)
     return false;
 
+  // SRC_W is in 16.16 fixed point.
+  max_source_width_ = MAX_PLANE_SOURCE_WIDTH;
+  if ((src_w_max >> 16) && (src_w_max >> 16) < UINT16_MAX)
+    max_source_width_ = src_w_max >> 16;
+
   ret = src_h_prop_.Initialize(gpu_fd, "SRC_H", plane_props);
   if (!ret)
     return false;
@@ -300,19 +318,7 @@ bool DrmPlane::UpdateProperties(drmModeAtomicReqPtr property_set,
                                       display_frame.top) < 0;
 
   if (layer->IsCursorLayer()) {
-    success |= drmModeAtomicAddProperty(property_set, id_, crtc_w_prop_.id,
-                                        buffer->GetWidth()) < 0;
-    success |= drmModeAtomicAddProperty(property_set, id_, crtc_h_prop_.id,
-                                        buffer->GetHeight()) < 0;
-    success |=
-        drmModeAtomicAddProperty(property_set, id_, src_x_prop_.id, 0) < 0;
-    success |=
-        drmModeAtomicAddProperty(property_set, id_, src_y_prop_.id, 0) < 0;
-
-    success |= drmModeAtomicAddProperty(property_set, id_, src_w_prop_.id,
-                                        buffer->GetWidth() << 16) < 0;
-    success |= drmModeAtomicAddProperty(property_set, id_, src_h_prop_.id,
-                                        buffer->GetHeight() << 16) < 0;
+    success |= !AddCursorSize(property_set, buffer);
   } else {
     success |= drmModeAtomicAddProperty(property_set, id_, crtc_w_prop_.id,
                                         layer->GetDisplayFrameWidth()) < 0;
@@ -379,6 +385,52 @@ bool DrmPlane::UpdateProperties(drmModeAtomicReqPtr property_set,
   return true;
 }
 
+bool DrmPlane::UpdateCursorProperties(drmModeAtomicReqPtr property_set,
+                                      const OverlayLayer* layer) const {
+  OverlayBuffer* buffer = layer->GetBuffer();
+  if (!buffer) {
+    ETRACE("No buffer to update cursor plane with id: %d", id_);
+    return false;
+  }
+
+  const HwcRect<int>& display_frame = layer->GetDisplayFrame();
+  int success = drmModeAtomicAddProperty(property_set, id_, fb_prop_.id,
+                                         buffer->GetFb()) < 0;
+  success |= drmModeAtomicAddProperty(property_set, id_, crtc_x_prop_.id,
+                                      display_frame.left) < 0;
+  success |= drmModeAtomicAddProperty(property_set, id_, crtc_y_prop_.id,
+                                      display_frame.top) < 0;
+  // Same size as a regular commit would set, so nothing is left stale.
+  success |= !AddCursorSize(property_set, buffer);
+
+  if (kms_fence_ > 0 && in_fence_fd_prop_.id) {
+    success |= drmModeAtomicAddProperty(property_set, id_,
+                                        in_fence_fd_prop_.id, kms_fence_) < 0;
+  }
+
+  if (success) {
+    ETRACE("Could not update cursor properties for plane with id: %d", id_);
+    return false;
+  }
+
+  return true;
+}
+
+bool DrmPlane::AddCursorSize(drmModeAtomicReqPtr property_set,
+                             const OverlayBuffer* buffer) const {
+  int success = drmModeAtomicAddProperty(property_set, id_, crtc_w_prop_.id,
+                                         buffer->GetWidth()) < 0;
+  success |= drmModeAtomicAddProperty(property_set, id_, crtc_h_prop_.id,
+                                      buffer->GetHeight()) < 0;
+  success |= drmModeAtomicAddProperty(property_set, id_, src_x_prop_.id, 0) < 0;
+  success |= drmModeAtomicAddProperty(property_set, id_, src_y_prop_.id, 0) < 0;
+  success |= drmModeAtomicAddProperty(property_set, id_, src_w_prop_.id,
+                                      buffer->GetWidth() << 16) < 0;
+  success |= drmModeAtomicAddProperty(property_set, id_, src_h_prop_.id,
+                                      buffer->GetHeight() << 16) < 0;
+  return !success;
+}
+
 void DrmPlane::SetNativeFence(int32_t fd) {
   // Release any existing fence.
   if (kms_fence_ > 0) {
@@ -553,6 +605,33 @@ bool DrmPlane::IsSupportedModifier(uint64_t modifier, uint32_t format) {
   return false;
 }
 
+bool DrmPlane::CanRotate(uint32_t transform, uint32_t format,
+                         uint64_t modifier) {
+  if (!IsSupportedTransform(transform))
+    return false;
+
+  if (!(transform & (kTransform90 | kTransform270)))
+    return true;
+
+  // Rotation by 90/270 works only with Y or Yf tiled framebuffers.
+  switch (modifier) {
+    case I915_FORMAT_MOD_Y_TILED:
+    case I915_FORMAT_MOD_Yf_TILED:
+    case I915_FORMAT_MOD_Y_TILED_CCS:
+    case I915_FORMAT_MOD_Yf_TILED_CCS:
+      break;
+    default:
+      return false;
+  }
+
+  // Without IN_FORMATS we don't know the modifiers, leave it to the
+  // test commit.
+  if (formats_modifiers_.empty())
+    return true;
+
+  return IsSupportedModifier(modifier, format);
+}
+
 void DrmPlane::Dump() const {
   DUMPTRACE("Plane Information Starts. -------------");
   DUMPTRACE("Plane ID: %d", id_);
@@ -46,6 +46,11 @@ class DrmPlane : public DisplayPlane {
                         const OverlayLayer* layer,
                         bool test_commit = false) const;
 
+  // Updates only framebuffer and geometry of the plane, all other
+  // properties are left as set by the last UpdateProperties call.
+  bool UpdateCursorProperties(drmModeAtomicReqPtr property_set,
+                              const OverlayLayer* layer) const;
+
   void SetNativeFence(int32_t fd);
 
   void SetBuffer(std::shared_ptr<OverlayBuffer>& buffer);
@@ -84,16 +89,29 @@ class DrmPlane : public DisplayPlane {
     return !(type_ == DRM_PLANE_TYPE_CURSOR);
   }
 
+  uint32_t GetMaxSourceWidth() const override {
+    return max_source_width_;
+  }
+
   // check if modifier is supported for given format
   bool IsSupportedModifier(uint64_t modifier, uint32_t format);
 
+  // Returns true if a framebuffer of format and modifier can be scanned
+  // out by this plane with transform applied.
+  bool CanRotate(uint32_t transform, uint32_t format, uint64_t modifier);
+
  private:
+  // Adds the size of a cursor plane scanning out all of buffer.
+  bool AddCursorSize(drmModeAtomicReqPtr property_set,
+                     const OverlayBuffer* buffer) const;
+
   struct Property {
     Property();
     bool Initialize(uint32_t fd, const char* name,
                     const ScopedDrmObjectPropertyPtr& plane_properties,
                     uint32_t* rotation = NULL,
-                    uint64_t* in_formats_prop_value = NULL);
+                    uint64_t* in_formats_prop_value = NULL,
+                    uint64_t* range_max = NULL);
     uint32_t id = 0;
   };
 
@@ -129,6 +147,7 @@ class DrmPlane : public DisplayPlane {
   uint32_t prefered_format_ = 0;
   uint64_t prefered_modifier_ = 0;
   uint32_t rotation_ = 0;
+  uint32_t max_source_width_ = 0;
 
   // keep supported modifiers for each supported format
   typedef struct format_mods {
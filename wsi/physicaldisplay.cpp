@@ -29,6 +29,7 @@
 #include "displayplanemanager.h"
 #include "displayqueue.h"
 #include "hwcutils.h"
+#include "presentsequencer.h"
 #include "wsi_utils.h"
 
 namespace hwcomposer {
@@ -338,6 +339,7 @@ bool PhysicalDisplay::Present(std::vector<HwcLayer *> &source_layers,
     HandleClonedDisplays(this);
   }
 
+  PresentSequencer::ScopedLayerWrite layer_write;
   size_t size = source_layers.size();
   for (size_t layer_index = 0; layer_index < size; layer_index++) {
     HwcLayer *layer = source_layers.at(layer_index);
@@ -442,6 +444,14 @@ void PhysicalDisplay::SetDisableExplicitSync(bool disable_explicit_sync) {
   display_queue_->SetDisableExplicitSync(disable_explicit_sync);
 }
 
+void PhysicalDisplay::SetLateComposition(bool enable) {
+  display_queue_->SetLateComposition(enable);
+}
+
+uint64_t PhysicalDisplay::GetCompositionDeadline() {
+  return display_queue_->GetCompositionDeadline();
+}
+
 void PhysicalDisplay::SetVideoScalingMode(uint32_t mode) {
   display_queue_->SetVideoScalingMode(mode);
 }
@@ -91,6 +91,8 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
   void SetColorTransform(const float *matrix, HWCColorTransform hint) override;
   void SetBrightness(uint32_t red, uint32_t green, uint32_t blue) override;
   void SetDisableExplicitSync(bool disable_explicit_sync) override;
+  void SetLateComposition(bool enable) override;
+  uint64_t GetCompositionDeadline() override;
   void SetVideoScalingMode(uint32_t mode) override;
   void SetVideoColor(HWCColorControl color, float value) override;
   void GetVideoColor(HWCColorControl color, float *value, float *start,
@@ -192,6 +194,28 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
                       bool disable_explicit_fence, int32_t previous_fence,
                       int32_t *commit_fence, bool *previous_fence_released) = 0;
 
+  /**
+   * API for moving the cursor or changing its buffer, without touching
+   * any other plane enabled by the last Commit.
+   * @param cursor_plane plane, as committed last frame, which scans out
+   *        the cursor layer.
+   * @param disable_explicit_fence is set to true if we want a hardware fence
+   *        associated with this commit request set to commit_fence.
+   * @param commit_fence hardware fence associated with this commit request.
+   * @return false if the update couldn't be applied right away, i.e. a
+   *         previous commit is still pending.
+   */
+  virtual bool CommitCursor(const DisplayPlaneState &cursor_plane,
+                            bool disable_explicit_fence,
+                            int32_t *commit_fence) = 0;
+
+  /**
+   * API to check if Commit only queues the frame, to be committed together
+   * with other displays. The result is reported through
+   * DisplayQueue::HandleBatchedCommit once the batch is flushed.
+   */
+  virtual bool IsCommitBatched() const = 0;
+
   /**
    * API is called if current active display configuration has changed.
    * Implementations need to reset any state in this case.
@@ -212,10 +236,16 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
   virtual void NotifyClientsOfDisplayChangeStatus() = 0;
 
   /**
-   * API for setting the color of the pipe canvas.
+   * API for setting the color of the pipe canvas. The color is applied
+   * by the next Commit, together with the planes.
    */
   virtual void SetPipeCanvasColor(uint16_t bpc, uint16_t red, uint16_t green,
-                                  uint16_t blue, uint16_t alpha) const = 0;
+                                  uint16_t blue, uint16_t alpha) = 0;
+
+  /**
+   * API to check if the color of the pipe canvas can be set.
+   */
+  virtual bool SupportsPipeCanvasColor() const = 0;
 
   /**
    * API for setting the colordepth of the pipe.
@@ -257,6 +287,10 @@ class PhysicalDisplay : public NativeDisplay, public DisplayPlaneHandler {
     return connection_state_ & kFakeConnected;
   }
 
+  bool HasClones() const {
+    return !clones_.empty();
+  }
+
   int GetTotalOverlays() const override;
 
  private:
@@ -39,13 +39,20 @@ LOCAL_SRC_FILES := os/alios/hwf_alioshal.cpp \
     common/core/logicaldisplaymanager.cpp \
     common/core/logicaldisplay.cpp \
     common/core/mosaicdisplay.cpp \
+    common/core/presentsequencer.cpp \
     common/core/hwclayer.cpp \
     common/core/overlaylayer.cpp \
     common/core/resourcemanager.cpp \
     common/core/framebuffermanager.cpp \
+    common/core/bufferimportcache.cpp \
     common/utils/hwcutils.cpp \
     common/utils/hwcthread.cpp \
+    common/utils/hwcthreadscheduler.cpp \
+    common/utils/hwcreactor.cpp \
+    common/utils/hwcworkerpool.cpp \
     common/utils/hwcevent.cpp \
+    common/utils/hwcfence.cpp \
+    common/utils/hwcframepacer.cpp \
     common/utils/fdhandler.cpp \
     common/utils/disjoint_layers.cpp \
     common/display/virtualdisplay.cpp \
@@ -67,6 +74,7 @@ LOCAL_SRC_FILES := os/alios/hwf_alioshal.cpp \
     common/compositor/va/varenderer.cpp \
     common/compositor/va/vautils.cpp \
     wsi/drm/drmdisplaymanager.cpp \
+    wsi/drm/drmcommitbatch.cpp \
     wsi/drm/drmscopedtypes.cpp \
     wsi/drm/drmdisplay.cpp \
     wsi/drm/drmplane.cpp \